@@ -41,7 +41,28 @@ Commands:
                 This operation has constant memory usage.
 
   write-xml     Convert a BER file into XML.
-                This operation has constant memory usage.
+                This operation has constant memory usage
+                (except with --threads).
+
+  write-json    Convert a BER file into newline delimited JSON, i.e.
+                one JSON object per CDR, plus header and trailer objects.
+                Each CDR is read into memory before it is written, i.e.
+                the memory usage is bounded by the largest CDR. Without
+                a known CDR path (e.g. for an unknown grammar) the
+                whole file is read into memory.
+
+  export-csv    Export selected fields of each CDR as CSV (or TSV), i.e.
+                one line per CDR. The columns are specified in a file.
+                For that, the BER file is memory-mapped.
+
+                Example:
+
+                    export-csv --columns spec.txt input.ber out.csv
+
+  columnize     Store selected fields of each CDR column-wise in a
+                compact archive (cf. xfsx/columnar.hh for the reader API).
+                The columns are specified like for export-csv.
+                For that, the BER file is memory-mapped.
 
   write-ber     Convert a XML file into BER.
                 The memory usage of this operation is linear to the length
@@ -88,8 +109,9 @@ Commands:
 
 Files:
 
-  The OUTPUT argument is mandatory for most commands. For the xml command
-  it is optional and when it is omitted, the XML is written to stdout.
+  The OUTPUT argument is mandatory for most commands. For the xml, json
+  and csv commands it is optional and when it is omitted, the output is written
+  to stdout.
 
 Arguments:
 
@@ -104,21 +126,29 @@ Arguments:
     --mmap          Memory-map input file
     --mmap-out      Memory-map output file
     --no-fsync      skip fsync/msync call after the last write
+    --stats         print I/O statistics to stderr when done
 
   write-def:
 
     --mmap          Memory-map input file
     --no-fsync      skip fsync/msync call after the last write
+    --stats         print I/O statistics to stderr when done
 
   write-indef:
 
     --mmap          Memory-map input file
     --no-fsync      skip fsync/msync call after the last write
+    --stats         print I/O statistics to stderr when done
 
   write-xml:
 
     --mmap          Memory-map input file
+    --mmap-out      Memory-map output file, which is preallocated
+                    with the exact size of the XML, i.e. threads
+                    write directly into it
+                    (not supported with --pp, --search, --count etc.)
     --no-fsync      skip fsync/msync call after the last write
+    --stats         print I/O statistics to stderr when done
     --indent N      Indentation step size (default: 4)
     -a,--asn FILE   Use ASN.1 grammar for pretty printing (can be specified
                     multiple times)
@@ -160,8 +190,65 @@ Arguments:
     --first         Stop reading at the end of the first element
                     (i.e. trailing garbage is ignored)
     --count N       Write only first N tags
-    --pp            Pretty print content using Lua module
+    --pp            Pretty print content using the built-in printers
+                    and the Lua module (for all other tags)
     --pp-file FILE  Lua filename (default: autodetect)
+    --pp-plugin SO  Load pretty printers from a shared object,
+                    implies --pp
+    --threads N     Format the CDRs of a definite CallEventDetailList
+                    (or ReturnDetailList etc.) with N threads,
+                    i.e. the list is read into memory first
+                    (unless the input is memory-mapped)
+    --checkpoint FILE Periodically save the conversion state to FILE.
+                    If FILE exists, the output is truncated and
+                    the conversion is resumed from it, unless it
+                    was saved for another input or other options.
+                    FILE is removed when done.
+    --select PATH   Only write the subtrees identified by PATH (and
+                    the start/end tags of their ancestors), everything
+                    else is skipped without formatting it.
+                    Can be specified multiple times, alternatively
+                    the paths can be separated with |, e.g.
+                    /TransferBatch/BatchControlInfo|LocalTimeStamp
+                    Paths are like with --search, without predicates.
+
+  write-json:
+
+    -a,--asn FILE   Use ASN.1 grammar for names and value types
+    --asn-path DIR  see above
+    --asn-cfg FILE  see above
+    --no-detect     Disable autodetect
+    --mmap          Memory-map input file
+    --no-fsync      skip fsync/msync call after the last write
+    --stats         print I/O statistics to stderr when done
+    --skip BYTES    Skip BYTES of input file
+
+  export-csv:
+
+    --columns FILE  Column specification, one column per line:
+                    NAME PATH
+                    where PATH is relative to the CDR, e.g.
+                    start /BasicCallInformation/CallEventStartTimeStamp/LocalTimeStamp
+                    Omitting first / means: match everywhere inside the CDR
+                    A wildcard * matches any tag.
+                    Lines starting with # are ignored.
+    --tsv           Write tab separated values
+    -a,--asn FILE   Use ASN.1 grammar for names and value types
+    --asn-path DIR  see above
+    --asn-cfg FILE  see above
+    --no-detect     Disable autodetect
+    --no-fsync      skip fsync/msync call after the last write
+    --skip BYTES    Skip BYTES of input file
+
+  columnize:
+
+    --columns FILE  Column specification, see export-csv
+    -a,--asn FILE   Use ASN.1 grammar for names and value types
+    --asn-path DIR  see above
+    --asn-cfg FILE  see above
+    --no-detect     Disable autodetect
+    --no-fsync      skip fsync/msync call after the last write
+    --skip BYTES    Skip BYTES of input file
 
   write-ber:
 
@@ -171,6 +258,11 @@ Arguments:
     --no-detect     Disable autodetect
     --mmap          Memory-map input file
     --no-fsync      skip fsync/msync call after the last write
+    --stats         print I/O statistics to stderr when done
+    --threads N     Encode the CDRs of a definite CallEventDetailList
+                    (or ReturnDetailList etc.) with N threads,
+                    i.e. the list is read into memory first
+                    (unless the input is memory-mapped)
 
   search:
 
@@ -235,6 +327,13 @@ Arguments:
                                               2 -> after node,  -2 -> before node
           write-aci                  Compute and rewrite Audit Control Info
                                      (ACI)
+
+        If all commands are remove/replace commands with simple paths
+        (e.g. /TransferBatch/AuditControlInfo or //LocalTimeStamp),
+        the file is edited in a streaming fashion, i.e. without
+        building a DOM, where untouched bytes are copied verbatim
+        (unless the input is stdin). When the input is also the
+        output, it's replaced by a temporary file when done.
     --skip BYTES    Skip BYTES of input file
     --first         Stop reading at the end of the first element
                     (i.e. trailing garbage is ignored)
@@ -280,6 +379,7 @@ the encoding format) grammar.
 #include <string.h>
 #include <fcntl.h>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/multi_array.hpp>
@@ -348,6 +448,9 @@ namespace bed {
     { "edit"       , Command::EDIT             },
     { "compute-aci", Command::COMPUTE_ACI      },
     { "write-aci",   Command::WRITE_ACI        },
+    { "write-json",  Command::WRITE_JSON       },
+    { "export-csv",  Command::EXPORT_CSV       },
+    { "columnize",   Command::COLUMNIZE        },
     { "mk-bash-comp",Command::MK_BASH_COMP     },
     { "mk-zsh-comp", Command::MK_ZSH_COMP     }
   };
@@ -363,6 +466,9 @@ namespace bed {
     { Command::EDIT            , "Edit BER file in memory"},
     { Command::COMPUTE_ACI     , "Compute Audit Control Info"},
     { Command::WRITE_ACI       , "Rewrite Audit Control Info"},
+    { Command::WRITE_JSON      , "Convert BER to NDJSON"},
+    { Command::EXPORT_CSV      , "Export CDR fields as CSV"},
+    { Command::COLUMNIZE       , "Store CDR fields column-wise"},
     { Command::MK_BASH_COMP    , "Print Bash completion file"},
     { Command::MK_ZSH_COMP     , "Print Zsh completion file"}
   };
@@ -427,9 +533,16 @@ namespace bed {
     { "--output"    , Option::OUTPUT       },
     { "--pp"        , Option::PRETTY_PRINT },
     { "--pp-file"   , Option::PP_FILE      },
+    { "--pp-plugin" , Option::PP_PLUGIN    },
     { "--mmap"      , Option::MMAP         },
     { "--mmap-out"  , Option::MMAP_OUT     },
-    { "--no-fsync"  , Option::NO_FSYNC     }
+    { "--no-fsync"  , Option::NO_FSYNC     },
+    { "--stats"     , Option::STATS        },
+    { "--threads"   , Option::THREADS      },
+    { "--columns"   , Option::COLUMNS      },
+    { "--tsv"       , Option::TSV          },
+    { "--checkpoint", Option::CHECKPOINT   },
+    { "--select"    , Option::SELECT       }
   };
 
   static map<Option, pair<unsigned, unsigned> > option_to_argc_map = {
@@ -463,9 +576,16 @@ namespace bed {
      { Option::OUTPUT       , { 1, 1 }  },
      { Option::PRETTY_PRINT , { 0, 0 }  },
      { Option::PP_FILE      , { 1, 1 }  },
+     { Option::PP_PLUGIN    , { 1, 1 }  },
      { Option::MMAP         , { 0, 0 }  },
      { Option::MMAP_OUT     , { 0, 0 }  },
-     { Option::NO_FSYNC     , { 0, 0 }  }
+     { Option::NO_FSYNC     , { 0, 0 }  },
+     { Option::STATS        , { 0, 0 }  },
+     { Option::THREADS      , { 1, 1 }  },
+     { Option::COLUMNS      , { 1, 1 }  },
+     { Option::TSV          , { 0, 0 }  },
+     { Option::CHECKPOINT   , { 1, 1 }  },
+     { Option::SELECT       , { 1, 1 }  }
   };
 
   static map<Option, string> option_desc_map = {
@@ -499,9 +619,16 @@ namespace bed {
      { Option::OUTPUT       , "output file" },
      { Option::PRETTY_PRINT , "pretty print content" },
      { Option::PP_FILE      , "pretty print Lua file" },
+     { Option::PP_PLUGIN    , "pretty print plugin" },
      { Option::MMAP         , "memory-map input" },
      { Option::MMAP_OUT     , "memory-map output" },
-     { Option::NO_FSYNC     , "skip fsync/msync after the last write" }
+     { Option::NO_FSYNC     , "skip fsync/msync after the last write" },
+     { Option::STATS        , "print I/O statistics" },
+     { Option::THREADS      , "format CDRs with N threads" },
+     { Option::COLUMNS      , "CSV column specification" },
+     { Option::TSV          , "tab separated output" },
+     { Option::CHECKPOINT   , "resumable checkpoint file" },
+     { Option::SELECT       , "only write subtrees that match PATH" }
   };
 
   static map<Option, set<Command> > option_comp_map = {
@@ -529,7 +656,8 @@ namespace bed {
     { Option::LENGTH    ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML }  },
     { Option::OFFSET    ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML }  },
     { Option::SKIP      ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML,
-                             Command::SEARCH_XPATH,
+                             Command::WRITE_JSON, Command::EXPORT_CSV,
+                             Command::COLUMNIZE, Command::SEARCH_XPATH,
                              Command::VALIDATE_XSD, Command::EDIT }  },
     { Option::SKIP_ZERO ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML }  },
     { Option::BLOCK     ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML }  },
@@ -548,13 +676,25 @@ namespace bed {
     { Option::OUTPUT    ,  { Command::MK_BASH_COMP, Command::MK_ZSH_COMP } },
     { Option::PRETTY_PRINT,{ Command::WRITE_XML, Command::PRETTY_WRITE_XML } },
     { Option::PP_FILE   ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML } },
+    { Option::PP_PLUGIN ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML } },
     { Option::MMAP      ,  { Command::WRITE_IDENTITY, Command::WRITE_INDEFINITE,
                              Command::WRITE_DEFINITE, Command::WRITE_BER,
-                             Command::WRITE_XML } },
-    { Option::MMAP_OUT  ,  { Command::WRITE_IDENTITY } },
+                             Command::WRITE_XML, Command::WRITE_JSON } },
+    { Option::MMAP_OUT  ,  { Command::WRITE_IDENTITY, Command::WRITE_XML,
+                             Command::PRETTY_WRITE_XML } },
     { Option::NO_FSYNC  ,  { Command::WRITE_IDENTITY, Command::WRITE_INDEFINITE,
                              Command::WRITE_DEFINITE, Command::WRITE_BER,
-                             Command::WRITE_XML } }
+                             Command::WRITE_XML, Command::WRITE_JSON,
+                             Command::EXPORT_CSV, Command::COLUMNIZE } },
+    { Option::STATS     ,  { Command::WRITE_IDENTITY, Command::WRITE_INDEFINITE,
+                             Command::WRITE_DEFINITE, Command::WRITE_BER,
+                             Command::WRITE_XML, Command::WRITE_JSON } },
+    { Option::THREADS   ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML,
+                             Command::WRITE_BER } },
+    { Option::COLUMNS   ,  { Command::EXPORT_CSV, Command::COLUMNIZE } },
+    { Option::TSV       ,  { Command::EXPORT_CSV } },
+    { Option::CHECKPOINT,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML } },
+    { Option::SELECT    ,  { Command::WRITE_XML, Command::PRETTY_WRITE_XML } }
   };
 
   static void print_help(const std::string &argv0);
@@ -743,12 +883,8 @@ namespace bed {
   static void apply_pretty_print(Arguments &a, unsigned, unsigned&,
       unsigned, char ** /*argv*/)
   {
-#ifdef XFSX_USE_LUA
+    // without Lua support, only the built-in printers are used
     a.pretty_print = true;
-#else
-    (void)a;
-    throw logic_error("not compiled with Lua support");
-#endif
   }
 
   static void apply_pp_file(Arguments &a, unsigned i, unsigned&,
@@ -756,6 +892,12 @@ namespace bed {
   {
     a.pp_filename = argv[i];
   }
+  static void apply_pp_plugin(Arguments &a, unsigned i, unsigned&,
+      unsigned, char **argv)
+  {
+    a.pp_plugins.push_back(argv[i]);
+    a.pretty_print = true;
+  }
   static void apply_mmap(Arguments &a, unsigned , unsigned&,
       unsigned, char **)
   {
@@ -771,6 +913,40 @@ namespace bed {
   {
       a.fsync = false;
   }
+  static void apply_stats(Arguments &a, unsigned , unsigned&,
+      unsigned, char **)
+  {
+      a.stats = true;
+  }
+  static void apply_threads(Arguments &a, unsigned i, unsigned&,
+      unsigned, char **argv)
+  {
+      a.threads = boost::lexical_cast<unsigned>(argv[i]);
+  }
+  static void apply_columns(Arguments &a, unsigned i, unsigned&,
+      unsigned, char **argv)
+  {
+      a.columns_filename = argv[i];
+  }
+  static void apply_tsv(Arguments &a, unsigned , unsigned&,
+      unsigned, char **)
+  {
+      a.tsv = true;
+  }
+  static void apply_checkpoint(Arguments &a, unsigned i, unsigned&,
+      unsigned, char **argv)
+  {
+      a.checkpoint_filename = argv[i];
+  }
+  static void apply_select(Arguments &a, unsigned i, unsigned&,
+      unsigned, char **argv)
+  {
+      vector<string> v;
+      boost::algorithm::split(v, argv[i], boost::algorithm::is_any_of("|"));
+      for (auto &x : v)
+          if (!x.empty())
+              a.select_paths.push_back(std::move(x));
+  }
 
   static map<Option,void (*)(Arguments &a, unsigned i, unsigned &j,
       unsigned argc, char **argv)> option_to_apply_map = {
@@ -804,9 +980,16 @@ namespace bed {
     { Option::OUTPUT       ,  apply_output       },
     { Option::PRETTY_PRINT ,  apply_pretty_print },
     { Option::PP_FILE      ,  apply_pp_file      },
+    { Option::PP_PLUGIN    ,  apply_pp_plugin    },
     { Option::MMAP         ,  apply_mmap         },
     { Option::MMAP_OUT     ,  apply_mmap_out     },
-    { Option::NO_FSYNC     ,  apply_no_fsync     }
+    { Option::NO_FSYNC     ,  apply_no_fsync     },
+    { Option::STATS        ,  apply_stats        },
+    { Option::THREADS      ,  apply_threads      },
+    { Option::COLUMNS      ,  apply_columns      },
+    { Option::TSV          ,  apply_tsv          },
+    { Option::CHECKPOINT   ,  apply_checkpoint   },
+    { Option::SELECT       ,  apply_select       }
   };
 
 
@@ -1102,9 +1285,25 @@ complete -F _)" << name << ' ' << name << '\n';
            || command == Command::WRITE_BER
            || command == Command::EDIT
            || command == Command::WRITE_ACI
+           || command == Command::COLUMNIZE
          )
          && out_filename.empty())
       throw Argument_Error("no output file given");
+    if (command == Command::EXPORT_CSV || command == Command::COLUMNIZE) {
+      if (columns_filename.empty())
+        throw Argument_Error("no columns file given (cf. --columns)");
+      if (in_filename == "-")
+        throw Argument_Error(command_str + " can't read from stdin");
+    }
+    if (!checkpoint_filename.empty() && (in_filename == "-"
+          || out_filename.empty() || out_filename == "-"))
+      throw Argument_Error("--checkpoint requires input and output files");
+    if (!checkpoint_filename.empty() && mmap_out)
+      throw Argument_Error("--checkpoint can't be combined with --mmap-out");
+    if (!select_paths.empty() && (!search_path.empty() || skip_to_aci
+          || !kth_cdr.empty()))
+      throw Argument_Error("--select can't be combined with --search,"
+          " --aci or --cdr");
   }
 
     void Arguments::canonicalize()
@@ -1116,8 +1315,13 @@ complete -F _)" << name << ' ' << name << '\n';
         if (fsync && out_filename == "-")
             fsync = false;
         if ((command == Command::PRETTY_WRITE_XML 
-                    || command == Command::WRITE_XML) && out_filename.empty())
+                    || command == Command::WRITE_XML
+                    || command == Command::WRITE_JSON
+                    || command == Command::EXPORT_CSV) && out_filename.empty())
             out_filename = "-";
+        // i.e. write-xml maps the input for sizing the output
+        if (mmap_out && (in_filename == "-" || out_filename == "-"))
+            mmap_out = false;
     }
 
 
@@ -1132,7 +1336,8 @@ complete -F _)" << name << ' ' << name << '\n';
         if (command == Command::WRITE_XML) {
             command = Command::PRETTY_WRITE_XML;
             asn_filenames.push_back("-");
-        } else if (command == Command::WRITE_BER) {
+        } else if (command == Command::WRITE_BER
+                || command == Command::WRITE_JSON) {
             asn_filenames.push_back("-");
         }
         return;
@@ -1140,6 +1345,9 @@ complete -F _)" << name << ' ' << name << '\n';
 
     try {
       if (    command == Command::WRITE_XML
+           || command == Command::WRITE_JSON
+           || command == Command::EXPORT_CSV
+           || command == Command::COLUMNIZE
            || command == Command::EDIT
            || command == Command::SEARCH_XPATH
            || command == Command::VALIDATE_XSD
@@ -1180,6 +1388,9 @@ complete -F _)" << name << ' ' << name << '\n';
                   command::Edit,
                   command::Compute_ACI,
                   command::Write_ACI,
+                  command::Write_JSON,
+                  command::Export_CSV,
+                  command::Columnize,
                   command::Mk_Bash_Comp,
                   command::Mk_Zsh_Comp
         >().make(n, *this);
@@ -43,6 +43,9 @@ namespace bed {
     EDIT,
     COMPUTE_ACI,
     WRITE_ACI,
+    WRITE_JSON,
+    EXPORT_CSV,
+    COLUMNIZE,
     MK_BASH_COMP,
     MK_ZSH_COMP
   };
@@ -70,20 +73,29 @@ namespace bed {
     struct Edit : Base { using Base::Base; void execute() override; };
     struct Compute_ACI : Base { using Base::Base; void execute() override; };
     struct Write_ACI : Base { using Base::Base; void execute() override; };
+    struct Write_JSON : Base { using Base::Base; void execute() override; };
+    struct Export_CSV : Base { using Base::Base; void execute() override; };
+    struct Columnize : Base { using Base::Base; void execute() override; };
     struct Mk_Bash_Comp : Base { using Base::Base; void execute() override; };
     struct Mk_Zsh_Comp : Base { using Base::Base; void execute() override; };
 
     namespace edit_op {
 
       struct Detail;
+      struct Stream_Detail;
 
       struct Base {
         virtual ~Base();
         std::vector<std::string> argv;
         virtual void execute(Detail &d) = 0;
+        // returns false if the op can't be applied without a DOM,
+        // cf. xfsx/ber_edit.hh
+        virtual bool stream(Stream_Detail &d) const;
       };
-      struct Remove    : public Base { void execute(Detail &d) override; };
-      struct Replace   : public Base { void execute(Detail &d) override; };
+      struct Remove    : public Base { void execute(Detail &d) override;
+                                       bool stream(Stream_Detail &d) const override; };
+      struct Replace   : public Base { void execute(Detail &d) override;
+                                       bool stream(Stream_Detail &d) const override; };
       struct Add       : public Base { void execute(Detail &d) override; };
       struct Set_Att   : public Base { void execute(Detail &d) override; };
       struct Insert    : public Base { void execute(Detail &d) override; };
@@ -135,10 +147,12 @@ namespace bed {
       size_t count {0};
       bool pretty_print {false};
       std::string pp_filename;
+      std::deque<std::string> pp_plugins;
 
       std::string search_path;
       bool skip_to_aci {false};
       std::string kth_cdr;
+      std::deque<std::string> select_paths;
 
       std::deque<std::string> xpaths;
       std::deque<std::shared_ptr<command::edit_op::Base> > edit_ops;
@@ -150,6 +164,11 @@ namespace bed {
       bool mmap{false};
       bool mmap_out{false};
       bool fsync{true};
+      bool stats{false};
+      unsigned threads{0};
+      std::string columns_filename;
+      bool tsv{false};
+      std::string checkpoint_filename;
   };
 }
 
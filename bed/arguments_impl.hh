@@ -65,9 +65,16 @@ namespace bed {
     OUTPUT,
     PRETTY_PRINT,
     PP_FILE,
+    PP_PLUGIN,
     MMAP,
     MMAP_OUT,
-    NO_FSYNC
+    NO_FSYNC,
+    STATS,
+    THREADS,
+    COLUMNS,
+    TSV,
+    CHECKPOINT,
+    SELECT
   };
 
 } // bed
@@ -26,6 +26,13 @@
 #include <xfsx/tap.hh>
 #include <xfsx/path.hh>
 
+#include <ixxx/ixxx.hh>
+
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
 namespace bed {
 
   namespace command {
@@ -51,6 +58,62 @@ namespace bed {
       }
     }
 
+    static void apply_select_args(const Arguments &a,
+        xfsx::xml::Writer_Arguments &b,
+        const xfsx::Name_Translator &name_translator)
+    {
+      if (!b.select_paths.empty())
+        return;
+      for (auto &s : a.select_paths) {
+        auto x = xfsx::path::parse(s, name_translator);
+        if (x.first.empty())
+          throw std::range_error("invalid select path: " + s);
+        b.select_paths.push_back(std::move(x));
+      }
+    }
+
+    static void apply_split_args(const Arguments &a,
+        xfsx::xml::Writer_Arguments &b,
+        const xfsx::Tag_Translator &translator)
+    {
+      if (a.threads < 2 || !b.split_path.empty())
+        return;
+      // i.e. without the trailing * that matches each CDR
+      b.split_path = xfsx::tap::kth_cdr_path(translator);
+      if (!b.split_path.empty())
+        b.split_path.pop_back();
+    }
+
+    // i.e. the identity of the input file (size, mtime, inode) and
+    // a FNV-1a hash of the options that change the XML output
+    static std::string checkpoint_key(const Arguments &a)
+    {
+      struct stat st;
+      ixxx::posix::stat(a.in_filename, &st);
+      std::ostringstream o;
+      for (auto &s : a.asn_filenames)
+        o << "asn " << s << '\n';
+      o << a.indent_size << ' ' << a.hex_dump << a.dump_tag << a.dump_class
+        << a.dump_tl << a.dump_t << a.dump_length << a.dump_offset << ' '
+        << a.skip << ' ' << a.skip_zero << ' ' << a.block_size << ' '
+        << a.stop_after_first << ' ' << a.count << ' '
+        << a.pretty_print << ' ' << a.pp_filename << '\n';
+      for (auto &s : a.pp_plugins)
+        o << "plugin " << s << '\n';
+      for (auto &s : a.select_paths)
+        o << "select " << s << '\n';
+      auto s = o.str();
+      uint64_t h = 0xcbf29ce484222325llu;
+      for (char c : s) {
+        h ^= uint8_t(c);
+        h *= 0x100000001b3llu;
+      }
+      std::ostringstream k;
+      k << st.st_size << ' ' << st.st_mtime << ' ' << st.st_ino << ' '
+        << std::hex << std::setw(16) << std::setfill('0') << h;
+      return k.str();
+    }
+
     void apply_arguments(const Arguments &a,
         xfsx::xml::Writer_Arguments &b)
     {
@@ -67,17 +130,30 @@ namespace bed {
       b.block_size       = a.block_size;
       b.stop_after_first = a.stop_after_first;
       b.count            = a.count;
+      b.threads          = a.threads;
+      b.checkpoint_filename = a.checkpoint_filename;
+      if (!a.checkpoint_filename.empty())
+        b.checkpoint_key = checkpoint_key(a);
 
       apply_search_args(a, b, xfsx::tap::mini_tap_translator(),
           xfsx::Name_Translator());
+      apply_select_args(a, b, xfsx::Name_Translator());
+      apply_split_args(a, b, xfsx::tap::mini_tap_translator());
     }
 
     void apply_arguments(const Arguments &a,
         xfsx::xml::Pretty_Writer_Arguments &b)
     {
       apply_search_args(a, b, b.translator, b.name_translator);
+      apply_select_args(a, b, b.name_translator);
+      apply_split_args(a, b, b.translator);
       b.pretty_print     = a.pretty_print;
       b.pp_filename      = a.pp_filename;
+      if (b.pretty_print) {
+        xfsx::pp::register_tap(b.printers, b.name_translator);
+        for (auto &f : a.pp_plugins)
+          b.printers.load(f, b.name_translator);
+      }
 
       apply_arguments(a, *static_cast<xfsx::xml::Writer_Arguments*>(&b));
     }
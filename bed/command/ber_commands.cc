@@ -22,8 +22,15 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <system_error>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <boost/lexical_cast.hpp>
 
@@ -31,6 +38,9 @@
 #include "arguments.hh"
 #include <xfsx/ber2ber.hh>
 #include <xfsx/ber2xml.hh>
+#include <xfsx/ber2json.hh>
+#include <xfsx/ber2csv.hh>
+#include <xfsx/columnar.hh>
 #include <xfsx/ber2lxml.hh>
 #include <xfsx/lxml2ber.hh>
 #include <xfsx/xml2ber.hh>
@@ -107,51 +117,222 @@ namespace bed {
           return w;
       }
 
+      // i.e. for resuming an interrupted conversion at off
+      static xfsx::scratchpad::Simple_Reader<u8> mk_resumed_reader(
+              const bed::Arguments &args, size_t off)
+      {
+          using namespace xfsx;
+          // the mapped reader skips to off without copying
+          if (args.mmap)
+              return scratchpad::mk_simple_reader_mapped<u8>(args.in_filename);
+          ixxx::util::FD fd(args.in_filename, O_RDONLY);
+          if (::lseek(fd, off, SEEK_SET) == -1)
+              throw std::system_error(errno, std::generic_category(),
+                      "lseek " + args.in_filename);
+          auto r = scratchpad::mk_simple_reader<u8>(std::move(fd));
+          r.set_pos(off);
+          return r;
+      }
+      static xfsx::scratchpad::Simple_Writer<char> mk_resumed_writer(
+              const bed::Arguments &args, size_t off)
+      {
+          using namespace xfsx;
+          ixxx::util::FD fd(args.out_filename, O_WRONLY);
+          struct stat st;
+          ixxx::posix::stat(args.out_filename, &st);
+          if (size_t(st.st_size) < off)
+              throw std::runtime_error("output file is shorter than the"
+                      " checkpoint: " + args.out_filename);
+          ixxx::posix::ftruncate(fd, off);
+          if (::lseek(fd, off, SEEK_SET) == -1)
+              throw std::system_error(errno, std::generic_category(),
+                      "lseek " + args.out_filename);
+          auto w = scratchpad::mk_simple_writer<char>(std::move(fd));
+          if (args.fsync)
+              w.set_sync(true);
+          return w;
+      }
+
+      static double to_seconds(std::chrono::nanoseconds d)
+      {
+          return std::chrono::duration<double>(d).count();
+      }
+
+      // Print the I/O counters of reader and writer backends such that one
+      // can tell whether a conversion is I/O-bound or parse-bound.
+      // Memory-mapped backends don't do explicit I/O and thus
+      // don't report anything.
+      template <typename In, typename Out>
+      void print_stats(const bed::Arguments &args,
+              xfsx::scratchpad::Simple_Reader<In> &r,
+              xfsx::scratchpad::Simple_Writer<Out> &w,
+              std::chrono::steady_clock::time_point start)
+      {
+          if (!args.stats)
+              return;
+          auto total = std::chrono::steady_clock::now() - start;
+          xfsx::scratchpad::IO_Stats s;
+          if (r.backend() && r.backend()->stats()) {
+              auto &t = *r.backend()->stats();
+              cerr << "read:  " << t.read_calls << " calls, "
+                  << t.read_bytes << " bytes, "
+                  << to_seconds(t.read_time) << " s, "
+                  << t.moved_bytes << " bytes moved, "
+                  << t.grow_calls << " buffer growths\n";
+              s += t;
+          }
+          if (w.backend() && w.backend()->stats()) {
+              auto &t = *w.backend()->stats();
+              cerr << "write: " << t.write_calls << " calls, "
+                  << t.write_bytes << " bytes, "
+                  << to_seconds(t.write_time) << " s, "
+                  << t.moved_bytes << " bytes moved, "
+                  << t.grow_calls << " buffer growths\n"
+                  << "sync:  " << t.sync_calls << " calls, "
+                  << to_seconds(t.sync_time) << " s\n";
+              s += t;
+          }
+          auto io = s.read_time + s.write_time + s.sync_time;
+          cerr << "total: " << to_seconds(total) << " s, "
+              << to_seconds(io) << " s blocked in I/O\n";
+      }
+
 
     void Write_Identity::execute()
     {
+        auto start = std::chrono::steady_clock::now();
         auto r = mk_simple_reader<xfsx::u8>(args_);
         auto w = mk_simple_writer<xfsx::u8>(args_);
         xfsx::ber::write_identity(r, w);
         w.flush();
         w.sync();
+        print_stats(args_, r, w, start);
     }
 
     void Write_Definite::execute()
     {
         // XXX support mmap output
+        auto start = std::chrono::steady_clock::now();
         auto r = mk_simple_reader<u8>(args_);
         auto w = mk_simple_writer<u8>(args_);
         xfsx::ber::write_definite(r, w);
         // already flushed
         w.sync();
+        print_stats(args_, r, w, start);
     }
 
     void Write_Indefinite::execute()
     {
         // XXX support mmap output
+        auto start = std::chrono::steady_clock::now();
         auto r = mk_simple_reader<xfsx::u8>(args_);
         auto w = mk_simple_writer<xfsx::u8>(args_);
         xfsx::ber::write_indefinite(r, w);
         w.flush();
         w.sync();
+        print_stats(args_, r, w, start);
+    }
+
+
+    // Resumes from the checkpoint file if it exists, i.e. when a
+    // previous run was interrupted. The file is removed when done.
+    static void write_xml_checkpointed(const bed::Arguments &as,
+            const xfsx::xml::Pretty_Writer_Arguments &args,
+            std::chrono::steady_clock::time_point start)
+    {
+        struct stat st;
+        if (::stat(as.checkpoint_filename.c_str(), &st) == 0) {
+            xfsx::xml::Checkpoint c;
+            c.load(as.checkpoint_filename);
+            // i.e. before the output is truncated
+            if (c.key != args.checkpoint_key)
+                throw std::runtime_error("checkpoint belongs to a different"
+                        " input or different options: "
+                        + as.checkpoint_filename);
+            auto r = mk_resumed_reader(as, c.in_off);
+            auto w = mk_resumed_writer(as, c.out_off);
+            xfsx::xml::pretty_write(r, w, args, c);
+            w.flush();
+            w.sync();
+            print_stats(as, r, w, start);
+        } else {
+            if (errno != ENOENT)
+                throw std::system_error(errno, std::generic_category(),
+                        "stat " + as.checkpoint_filename);
+            auto r = mk_simple_reader<xfsx::u8>(as);
+            auto w = mk_simple_writer<char>(as);
+            xfsx::xml::pretty_write(r, w, args);
+            w.flush();
+            w.sync();
+            print_stats(as, r, w, start);
+        }
+        if (::unlink(as.checkpoint_filename.c_str()) == -1 && errno != ENOENT)
+            throw std::system_error(errno, std::generic_category(),
+                    "unlink " + as.checkpoint_filename);
     }
 
+    // The output file is preallocated with its exact size (cf.
+    // xfsx::xml::pretty_size()) and mapped, i.e. with --threads each
+    // thread writes its CDRs directly into its region of the file.
+    // The CDR list is measured once, in parallel, and the write pass
+    // reuses those regions (cf. xfsx::xml::Layout). Both passes read
+    // the input through a sliding window.
+    static void write_xml_mapped(const bed::Arguments &as,
+            const xfsx::xml::Pretty_Writer_Arguments &args,
+            std::chrono::steady_clock::time_point start)
+    {
+        using namespace xfsx;
+        size_t reserve = 0;
+        xml::Layout layout;
+        size_t n = 0;
+        {
+            auto r = scratchpad::mk_simple_reader_mapped<u8>(as.in_filename);
+            n = xml::pretty_size(r, args, &reserve, &layout);
+        }
+        {
+            auto r = scratchpad::mk_simple_reader_mapped<u8>(as.in_filename);
+            auto w = scratchpad::mk_simple_writer_mapped<char>(
+                    as.out_filename, n + reserve);
+            if (as.fsync)
+                w.set_sync(true);
+            xml::pretty_write(r, w, args, layout);
+            if (w.pos() != n)
+                throw std::logic_error("measured XML size doesn't match"
+                        " output");
+            w.sync();
+            print_stats(as, r, w, start);
+        }
+        // i.e. after the output is unmapped
+        ixxx::util::FD fd(as.out_filename, O_WRONLY);
+        ixxx::posix::ftruncate(fd, n);
+    }
 
     // XXX eliminate in favour of just Pretty_Write?
     void Write_XML::execute()
     {
+      auto start = std::chrono::steady_clock::now();
       xfsx::xml::Pretty_Writer_Arguments args;
       apply_arguments(args_, args);
+      if (!args_.checkpoint_filename.empty()) {
+          write_xml_checkpointed(args_, args, start);
+          return;
+      }
+      if (args_.mmap_out) {
+          write_xml_mapped(args_, args, start);
+          return;
+      }
 
       auto r = mk_simple_reader<xfsx::u8>(args_);
       auto w = mk_simple_writer<char>(args_);
       xfsx::xml::pretty_write(r, w, args);
       w.flush();
+      w.sync();
+      print_stats(args_, r, w, start);
     }
 
     void Pretty_Write_XML::execute()
     {
+        auto start = std::chrono::steady_clock::now();
         auto r = mk_simple_reader<xfsx::u8>(args_);
         auto as = args_;
 
@@ -168,15 +349,100 @@ namespace bed {
 
       xfsx::xml::Pretty_Writer_Arguments args(as.asn_filenames);
       apply_arguments(as, args);
+      if (!as.checkpoint_filename.empty()) {
+          write_xml_checkpointed(as, args, start);
+          return;
+      }
+      if (as.mmap_out) {
+          write_xml_mapped(as, args, start);
+          return;
+      }
 
       auto w = mk_simple_writer<char>(as);
       xfsx::xml::pretty_write(r, w, args);
       w.flush();
+      w.sync();
+      print_stats(as, r, w, start);
+    }
+
+    void Write_JSON::execute()
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto r = mk_simple_reader<xfsx::u8>(args_);
+        auto as = args_;
+
+        if (as.asn_filenames.size() == 1 && as.asn_filenames[0] == "-") {
+            r.next(256);
+            string filename("(stdin)");
+            auto dt = xfsx::detector::detect_ber(r.window().first,
+                    r.window().second, filename, as.asn_config_filename,
+                    as.asn_search_path);
+            as.asn_filenames = dt.asn_filenames;
+        }
+
+        unique_ptr<xfsx::xml::Pretty_Writer_Arguments> args(
+                as.asn_filenames.empty()
+                ? new xfsx::xml::Pretty_Writer_Arguments()
+                : new xfsx::xml::Pretty_Writer_Arguments(as.asn_filenames));
+        args->skip = as.skip;
+        // i.e. one line per CDR
+        args->split_path = xfsx::tap::kth_cdr_path(args->translator);
+        if (!args->split_path.empty())
+            args->split_path.pop_back();
+
+        auto w = mk_simple_writer<char>(as);
+        xfsx::json::write(r, w, *args);
+        w.flush();
+        w.sync();
+        print_stats(as, r, w, start);
+    }
+
+    // i.e. one record per CDR
+    static unique_ptr<xfsx::xml::Pretty_Writer_Arguments> mk_cdr_args(
+            const bed::Arguments &a)
+    {
+        unique_ptr<xfsx::xml::Pretty_Writer_Arguments> args(
+                new xfsx::xml::Pretty_Writer_Arguments(a.asn_filenames));
+        args->skip = a.skip;
+        args->split_path = xfsx::tap::kth_cdr_path(args->translator);
+        if (!args->split_path.empty())
+            args->split_path.pop_back();
+        return args;
+    }
+
+    void Export_CSV::execute()
+    {
+        auto r = xfsx::scratchpad::mk_simple_reader_mapped<u8>(
+                args_.in_filename);
+        auto args = mk_cdr_args(args_);
+        auto columns = xfsx::csv::read_columns(args_.columns_filename,
+                args->name_translator);
+
+        auto w = mk_simple_writer<char>(args_);
+        xfsx::csv::write(r, w, *args, columns,
+                args_.tsv ? '\t' : ',');
+        w.flush();
+        w.sync();
+    }
+
+    void Columnize::execute()
+    {
+        auto r = xfsx::scratchpad::mk_simple_reader_mapped<u8>(
+                args_.in_filename);
+        auto args = mk_cdr_args(args_);
+        auto columns = xfsx::csv::read_columns(args_.columns_filename,
+                args->name_translator);
+
+        auto w = mk_simple_writer<char>(args_);
+        xfsx::columnar::write(r, w, *args, columns);
+        w.flush();
+        w.sync();
     }
 
     void Search_XPath::execute()
     {
-      auto in = ixxx::util::mmap_file(args_.in_filename);
+      auto r = xfsx::scratchpad::mk_simple_reader_mapped<u8>(
+          args_.in_filename);
 
       FILE *out = nullptr;
       ixxx::util::File out_file;
@@ -189,8 +455,7 @@ namespace bed {
 
       xfsx::xml::Pretty_Writer_Arguments args(args_.asn_filenames);
       apply_arguments(args_, args);
-      xxxml::doc::Ptr doc = xfsx::xml::l2::generate_tree(in.begin(), in.end(),
-          args);
+      xxxml::doc::Ptr doc = xfsx::xml::l2::generate_tree(r, args);
       for (auto &xpath : args_.xpaths) {
         xxxml::xpath::Context_Ptr c = xxxml::xpath::new_context(doc);
         xxxml::xpath::Object_Ptr o = xxxml::xpath::eval(xpath, c);
@@ -261,13 +526,11 @@ namespace bed {
           }
           auto i = path.begin();
           if (i != path.end()) {
-            auto rank = xxxml::get_prop(*i, "rank");
-            o << (*i)->name << '(' << rank.get() << ')';
+            o << (*i)->name << '(' << xfsx::xml::l2::rank(*i) << ')';
             ++i;
           }
           for (; i != path.end(); ++i) {
-            auto rank = xxxml::get_prop(*i, "rank");
-            o << '/' << (*i)->name << '(' << rank.get() << ')';
+            o << '/' << (*i)->name << '(' << xfsx::xml::l2::rank(*i) << ')';
           }
           o << " : " << e->message;
           size_t message_size = strlen(e->message);
@@ -287,7 +550,8 @@ namespace bed {
 
     void Validate_XSD::execute()
     {
-      auto in = ixxx::util::mmap_file(args_.in_filename);
+      auto r = xfsx::scratchpad::mk_simple_reader_mapped<u8>(
+          args_.in_filename);
 
       if (args_.xsd_filename.empty())
         throw runtime_error("No XSD filename given");
@@ -300,10 +564,11 @@ namespace bed {
           handle_xsd_validation_error, &h);
 
       xfsx::xml::Pretty_Writer_Arguments args(args_.asn_filenames);
-      args.dump_rank = true;
+      // i.e. the validator doesn't consume the definite attributes and
+      // the ranks of erroneous elements are derived from the tree
+      args.dump_indefinite = false;
       apply_arguments(args_, args);
-      xxxml::doc::Ptr doc = xfsx::xml::l2::generate_tree(in.begin(), in.end(),
-          args);
+      xxxml::doc::Ptr doc = xfsx::xml::l2::generate_tree(r, args);
 
       xxxml::schema::validate_doc(v, doc);
 
@@ -320,6 +585,7 @@ namespace bed {
 
     void Write_BER::execute()
     {
+      auto start = std::chrono::steady_clock::now();
       auto r = mk_simple_reader<char>(args_);
       xfsx::BER_Writer_Arguments args;
       deque<string> asn_filenames(args_.asn_filenames);
@@ -332,12 +598,23 @@ namespace bed {
             asn_filenames = dt.asn_filenames;
       }
       xfsx::tap::apply_grammar(asn_filenames, args);
+      args.threads = args_.threads;
+      if (args.threads > 1)
+        args.split_path = args.translator.empty()
+          ? xfsx::tap::kth_cdr_path()
+          : xfsx::tap::kth_cdr_path(args.translator);
+      // i.e. without the trailing * that matches each CDR
+      if (!args.split_path.empty())
+        args.split_path.pop_back();
 
       // XXX support mmap output -> the output file needs to be truncated then
       // note that for windows, the output must be unmapped before the final
       // truncate
       auto w = mk_simple_writer<xfsx::u8>(args_);
       xfsx::xml::write_ber(r, w, args);
+      w.flush();
+      w.sync();
+      print_stats(args_, r, w, start);
     }
 
 
@@ -41,10 +41,12 @@ namespace bed {
     {
       using namespace xfsx::tap::traverser;
 
-      auto m = ixxx::util::mmap_file(args_.in_filename);
+      // i.e. a single pass, thus the input is mapped in windows
+      auto r = xfsx::scratchpad::mk_simple_reader_mapped<xfsx::u8>(
+          args_.in_filename);
       xfsx::Vertical_TLC tlc;
 
-      Vertical_TLC_Proxy p(m.begin(), m.end(), tlc);
+      Vertical_TLC_Reader_Proxy p(r, tlc);
       Audit_Control_Info aci;
       aci(p, tlc);
 
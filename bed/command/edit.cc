@@ -23,6 +23,9 @@
 
 #include <xfsx/ber2lxml.hh>
 #include <xfsx/lxml2ber.hh>
+#include <xfsx/ber_edit.hh>
+#include <xfsx/ber_writer_arguments.hh>
+#include <xfsx/scratchpad.hh>
 #include <ixxx/util.hh>
 #include <xxxml/util.hh>
 #include <bed/arguments.hh>
@@ -37,6 +40,12 @@
 #include <boost/lexical_cast.hpp>
 
 #include <stdexcept>
+#include <system_error>
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -55,40 +64,139 @@ namespace bed {
             doc(doc)
         {}
       };
+      struct Stream_Detail {
+        const xfsx::BER_Writer_Arguments &ber_args;
+        std::vector<xfsx::ber::edit::Op> ops;
+        Stream_Detail(const xfsx::BER_Writer_Arguments &ber_args)
+          :
+            ber_args(ber_args)
+        {}
+      };
     }
 
-    void Edit::execute()
+    static bool same_file(const string &a, const string &b)
     {
-      auto in = ixxx::util::mmap_file(args_.in_filename);
+      struct stat x, y;
+      if (::stat(a.c_str(), &x) || ::stat(b.c_str(), &y))
+        return false;
+      return x.st_dev == y.st_dev && x.st_ino == y.st_ino;
+    }
 
+    // i.e. if all ops are path-addressed removes/replaces, the input is
+    // edited in two streaming passes instead of via a DOM
+    static bool stream_edit(const Arguments &a,
+        const xfsx::xml::Pretty_Writer_Arguments &pretty_args,
+        const xfsx::BER_Writer_Arguments &ber_args)
+    {
+      // i.e. these are only interpreted by the DOM generator
+      if (pretty_args.skip || pretty_args.count || pretty_args.stop_after_first)
+        return false;
+      // i.e. the input is read twice
+      if (a.in_filename == "-")
+        return false;
+      edit_op::Stream_Detail d(ber_args);
+      for (auto &edit_op : a.edit_ops)
+        if (!edit_op->stream(d))
+          return false;
+
+      using namespace xfsx;
+      ber::edit::Editor e(d.ops, pretty_args, ber_args);
+      {
+        auto r = a.mmap ? scratchpad::mk_simple_reader_mapped<u8>(a.in_filename)
+                        : scratchpad::mk_simple_reader<u8>(a.in_filename);
+        e.scan(r);
+      }
+      // i.e. the write pass still reads the input while the output is
+      // written, thus an in-place edit writes a temporary file that
+      // replaces the input when done
+      bool in_place = same_file(a.in_filename, a.out_filename);
+      string out(in_place ? a.out_filename + ".tmp" : a.out_filename);
+      try {
+        auto r = a.mmap ? scratchpad::mk_simple_reader_mapped<u8>(a.in_filename)
+                        : scratchpad::mk_simple_reader<u8>(a.in_filename);
+        auto w = scratchpad::mk_simple_writer<u8>(out);
+        e.write(r, w);
+        w.flush();
+      } catch (...) {
+        if (in_place)
+          ::unlink(out.c_str());
+        throw;
+      }
+      if (in_place && ::rename(out.c_str(), a.out_filename.c_str()) == -1)
+        throw std::system_error(errno, std::generic_category(),
+            "rename " + out);
+      return true;
+    }
+
+    void Edit::execute()
+    {
       xfsx::xml::Pretty_Writer_Arguments pretty_args(args_.asn_filenames);
       apply_arguments(args_, pretty_args);
 
-      xxxml::doc::Ptr doc = xfsx::xml::l2::generate_tree(in.begin(), in.end(),
-          pretty_args);
+      xfsx::BER_Writer_Arguments args;
+      xfsx::tap::apply_grammar(args_.asn_filenames, args);
+
+      if (stream_edit(args_, pretty_args, args))
+        return;
+
+      auto r = xfsx::scratchpad::mk_simple_reader_mapped<xfsx::u8>(
+          args_.in_filename);
+
+      xxxml::doc::Ptr doc = xfsx::xml::l2::generate_tree(r, pretty_args);
 
       edit_op::Detail detail(pretty_args, doc);
 
       for (auto &edit_op : args_.edit_ops)
         edit_op->execute(detail);
 
-      xfsx::BER_Writer_Arguments args;
-      xfsx::tap::apply_grammar(args_.asn_filenames, args);
-
       xfsx::xml::l2::write_ber(doc, args_.out_filename, args);
     }
 
 
     namespace edit_op {
 
+      bool Base::stream(Stream_Detail &) const
+      {
+        return false;
+      }
+
       void Remove::execute(Detail &d)
       {
         xxxml::util::remove(d.doc, argv.at(0));
       }
+      bool Remove::stream(Stream_Detail &d) const
+      {
+        xfsx::ber::edit::Op op;
+        if (!xfsx::ber::edit::parse_path(argv.at(0), op.path))
+          return false;
+        d.ops.push_back(std::move(op));
+        return true;
+      }
       void Replace::execute(Detail &d)
       {
         xxxml::util::replace(d.doc, argv.at(0), argv.at(1), argv.at(2));
       }
+      bool Replace::stream(Stream_Detail &d) const
+      {
+        xfsx::ber::edit::Op op;
+        op.kind = xfsx::ber::edit::Kind::REPLACE;
+        if (!xfsx::ber::edit::parse_path(argv.at(0), op.path))
+          return false;
+        // i.e. only the content of primitive elements is replaced
+        const string &name = op.path.steps.back();
+        try {
+          auto t = d.ber_args.translator.translate(
+              make_pair(name.data(), name.data() + name.size()));
+          if (std::get<0>(t) != xfsx::Shape::PRIMITIVE)
+            return false;
+        } catch (const std::out_of_range &) {
+          return false;
+        }
+        op.regex = argv.at(1);
+        op.subst = argv.at(2);
+        d.ops.push_back(std::move(op));
+        return true;
+      }
       void Add::execute(Detail &d)
       {
         xxxml::util::add(d.doc, argv.at(0), argv.at(1), argv.at(2));
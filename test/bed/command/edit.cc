@@ -45,6 +45,41 @@ BOOST_AUTO_TEST_SUITE(bed_)
            );
       }
 
+      // i.e. the output is the input file
+      BOOST_AUTO_TEST_CASE(edit_remove_in_place)
+      {
+        bf::path in_path(test::path::in());
+        bf::path asn(in_path);
+        asn /= "../../libgrammar/test/in/asn1/tap_3_12_strip.asn1";
+        bf::path input(in_path);
+        input /= "tap_3_12_valid.ber";
+        bf::path ref(in_path);
+        ref /= "tap_3_12_valid_removed.ber";
+        bf::path out(test::path::out());
+        out /= "bed/command";
+        bf::create_directories(out);
+        out /= "edit_remove_in_place.ber";
+        bf::remove(out);
+        bf::copy_file(input, out);
+
+        bed::Arguments args;
+        args.in_filename = out.generic_string();
+        args.asn_filenames.push_back(asn.generic_string());
+        args.out_filename = out.generic_string();
+        args.edit_ops.push_back(unique_ptr<bed::command::edit_op::Base>(
+              new bed::command::edit_op::Remove));
+        args.edit_ops.back()->argv = { "//MobileOriginatedCall" };
+        bed::command::Edit c(args);
+        c.execute();
+        {
+          auto f = ixxx::util::mmap_file(out.generic_string());
+          auto g = ixxx::util::mmap_file(ref.generic_string());
+          BOOST_CHECK(std::equal(f.begin(), f.end(), g.begin(), g.end()));
+        }
+        // i.e. the temporary output was renamed
+        BOOST_CHECK(!bf::exists(out.generic_string() + ".tmp"));
+      }
+
       BOOST_AUTO_TEST_CASE(edit_replace)
       {
         compare_bed_output("tap_3_12_strip.asn1", "tap_3_12_valid.ber",
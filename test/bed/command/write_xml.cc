@@ -357,6 +357,28 @@ BOOST_AUTO_TEST_SUITE(bed_)
           ixxx::posix::setenv("ASN1_PATH", old_asn1_path, true);
       }
 
+      BOOST_AUTO_TEST_CASE(autodetect_threads)
+      {
+        string old_asn1_path;
+        try { old_asn1_path = ixxx::ansi::getenv("ASN1_PATH"); }
+        catch (const ixxx::getenv_error &e) {}
+        string a {test::path::in() + "/../../libgrammar/test/in/asn1"};
+        string b {test::path::in() + "/../../config"};
+        string c {test::path::in() + "/../../libgrammar/grammar/xml"};
+        string d {test::path::in() + "/../../telephone-code"};
+        ixxx::posix::setenv("ASN1_PATH", a + ":" + b + ":" + c + ":" + d, true);
+
+        for (auto n : { "2", "3", "16" }) {
+          compare_bed_output("", "tap_3_12_valid.ber",
+              "write_xml_threads.xml", "write_xml_auto.xml",
+              { "write-xml", "--threads", n, "--hex", "--off", "--tag",
+              "--class", "--tl", "--t_size", "--length" });
+        }
+
+        if (!old_asn1_path.empty())
+          ixxx::posix::setenv("ASN1_PATH", old_asn1_path, true);
+      }
+
 
       BOOST_AUTO_TEST_CASE(autodetect_no_detect_raw)
       {
@@ -0,0 +1,146 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <boost/test/unit_test.hpp>
+
+#include <xfsx/ber2csv.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tap_fixture.hh"
+
+using namespace std;
+using namespace xfsx;
+
+static string write_csv(const string &ber,
+        const xml::Pretty_Writer_Arguments &args,
+        const vector<csv::Column> &columns, char delimiter = ',')
+{
+    auto w = scratchpad::mk_simple_writer<char>();
+    const u8 *b = reinterpret_cast<const u8*>(ber.data());
+    csv::write(b, b + ber.size(), w, args, columns, delimiter);
+    return test::tap::contents(w);
+}
+
+// TransferBatch with a header, a CallEventDetailList of three
+// CDRs (the 2nd one is indefinite) and a trailer
+static const char tap_ber[] =
+    "\x61\x2f"
+      "\x64\x04" "\x50\x02" "hd"
+      "\x63\x22"
+        "\x69\x13" "\x50\x03" "a,b" "\x54\x01\x07"
+                   "\x6a\x06" "\x50\x01" "x" "\x56\x01" "p"
+                   "\x56\x01" "q"
+        "\x69\x80" "\x54\x01\xff" "\x50\x02" "\"\n" "\x00\x00"
+        "\x69\x00"
+      "\x6f\x03" "\x54\x01\x05";
+
+static xml::Pretty_Writer_Arguments tap_args()
+{
+    auto args = test::tap::pretty_args();
+    args.split_path = { 1, 3 };
+    return args;
+}
+
+BOOST_AUTO_TEST_SUITE(xfsx_)
+
+  BOOST_AUTO_TEST_SUITE(csv_)
+
+    BOOST_AUTO_TEST_CASE(read_columns)
+    {
+        istringstream in(
+                "# comment\n"
+                "\n"
+                "ts   /LocalTimeStamp\n"
+                "  note\t/BasicCallInformation/Sender\n"
+                "TotalCallEventDuration\n"
+                "any  */22\n");
+        auto v = csv::read_columns(in, test::tap::names());
+        BOOST_REQUIRE_EQUAL(v.size(), 4u);
+        BOOST_CHECK_EQUAL(v[0].name, "ts");
+        BOOST_CHECK(v[0].path == vector<Tag_Int>({16}));
+        BOOST_CHECK(!v[0].anywhere);
+        BOOST_CHECK_EQUAL(v[1].name, "note");
+        BOOST_CHECK(v[1].path == vector<Tag_Int>({10, 22}));
+        BOOST_CHECK_EQUAL(v[2].name, "TotalCallEventDuration");
+        BOOST_CHECK(v[2].path == vector<Tag_Int>({20}));
+        BOOST_CHECK(v[2].anywhere);
+        BOOST_CHECK(v[3].path == vector<Tag_Int>({0, 22}));
+        BOOST_CHECK(v[3].anywhere);
+
+        istringstream a("ts /LocalTimeStamp extra\n");
+        BOOST_CHECK_THROW(csv::read_columns(a, test::tap::names()),
+                std::runtime_error);
+        istringstream b("ts /NoSuchTag\n");
+        BOOST_CHECK_THROW(csv::read_columns(b, test::tap::names()),
+                std::runtime_error);
+        istringstream c("# nothing\n");
+        BOOST_CHECK_THROW(csv::read_columns(c, test::tap::names()),
+                std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(records)
+    {
+        istringstream in(
+                "ts     /LocalTimeStamp\n"
+                "dur    /TotalCallEventDuration\n"
+                "bnote  /BasicCallInformation/Sender\n"
+                "note   Sender\n");
+        auto columns = csv::read_columns(in, test::tap::names());
+        string ber(tap_ber, sizeof tap_ber - 1);
+        BOOST_CHECK_EQUAL(write_csv(ber, tap_args(), columns),
+                "ts,dur,bnote,note\n"
+                "\"a,b\",7,p,p\n"
+                "\"\"\"\\x0a\",-1,,\n"
+                ",,,\n");
+        BOOST_CHECK_EQUAL(write_csv(ber, tap_args(), columns, '\t'),
+                "ts\tdur\tbnote\tnote\n"
+                "a,b\t7\tp\tp\n"
+                "\"\\x0a\t-1\t\t\n"
+                "\t\t\t\n");
+    }
+
+    BOOST_AUTO_TEST_CASE(segmented)
+    {
+        istringstream in(
+                "ts     /LocalTimeStamp\n"
+                "dur    /TotalCallEventDuration\n"
+                "note   Sender\n");
+        auto columns = csv::read_columns(in, test::tap::names());
+        string ber(tap_ber, sizeof tap_ber - 1);
+        string ref(write_csv(ber, tap_args(), columns));
+        const u8 *b = reinterpret_cast<const u8*>(ber.data());
+        const u8 *e = b + ber.size();
+        // i.e. the earlier fields of a record aren't available anymore
+        // when it's complete, as with a windowed mapping
+        for (size_t k : { size_t(1), size_t(3), size_t(7) }) {
+            vector<pair<const u8*, const u8*>> segs;
+            for (const u8 *p = b; p < e; p += std::min(k, size_t(e - p)))
+                segs.emplace_back(p, std::min(p + k, e));
+            auto r = scratchpad::mk_simple_reader<u8>(std::move(segs));
+            auto w = scratchpad::mk_simple_writer<char>();
+            csv::write(r, w, tap_args(), columns);
+            BOOST_CHECK_EQUAL(test::tap::contents(w), ref);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(without_grammar)
+    {
+        xml::Pretty_Writer_Arguments args;
+        istringstream in("t /15/20\n");
+        auto columns = csv::read_columns(in, args.name_translator);
+        string ber(tap_ber, sizeof tap_ber - 1);
+        // i.e. the top-level tag is the only record
+        BOOST_CHECK_EQUAL(write_csv(ber, args, columns),
+                "t\n"
+                "\\x05\n");
+    }
+
+  BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
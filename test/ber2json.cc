@@ -0,0 +1,78 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <boost/test/unit_test.hpp>
+
+#include <xfsx/ber2json.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <string>
+
+#include "tap_fixture.hh"
+
+using namespace std;
+using namespace xfsx;
+
+static string write_json(const string &ber,
+        const xml::Pretty_Writer_Arguments &args)
+{
+    auto w = scratchpad::mk_simple_writer<char>();
+    const u8 *b = reinterpret_cast<const u8*>(ber.data());
+    json::write(b, b + ber.size(), w, args);
+    return test::tap::contents(w);
+}
+
+// TransferBatch with a header, a CallEventDetailList of two
+// CDRs (the 2nd one is indefinite) and a trailer
+static const char tap_ber[] =
+    "\x61\x22"
+      "\x64\x04" "\x50\x02" "a\""
+      "\x63\x15"
+        "\x69\x0c" "\x50\x01" "x" "\x54\x01\x07" "\x56\x01" "p" "\x56\x01" "q"
+        "\x69\x80" "\x54\x01\xff" "\x00\x00"
+      "\x6f\x03" "\x54\x01\x05";
+
+BOOST_AUTO_TEST_SUITE(xfsx_)
+
+  BOOST_AUTO_TEST_SUITE(json_)
+
+    BOOST_AUTO_TEST_CASE(records)
+    {
+        auto args = test::tap::pretty_args();
+        args.split_path = { 1, 3 };
+
+        string ber(tap_ber, sizeof tap_ber - 1);
+        BOOST_CHECK_EQUAL(write_json(ber, args),
+R"({"TransferBatch":{"BatchControlInfo":{"LocalTimeStamp":"a\u0022"}}}
+{"MobileOriginatedCall":{"LocalTimeStamp":"x","TotalCallEventDuration":7,"Sender":["p","q"]}}
+{"MobileOriginatedCall":{"TotalCallEventDuration":-1}}
+{"TransferBatch":{"AuditControlInfo":{"TotalCallEventDuration":5}}}
+)");
+    }
+
+    BOOST_AUTO_TEST_CASE(without_grammar)
+    {
+        xml::Pretty_Writer_Arguments args;
+        string ber(tap_ber, sizeof tap_ber - 1);
+        // i.e. each top-level tag is one line
+        BOOST_CHECK_EQUAL(write_json(ber, args),
+R"({"APPLICATION_1":{"APPLICATION_4":{"APPLICATION_16":"a\u0022"},)"
+R"("APPLICATION_3":{"APPLICATION_9":[{"APPLICATION_16":"x",)"
+R"("APPLICATION_20":"\u0007","APPLICATION_22":["p","q"]},)"
+R"({"APPLICATION_20":"\u00ff"}]},"APPLICATION_15":{"APPLICATION_20":"\u0005"}}}
+)");
+    }
+
+    BOOST_AUTO_TEST_CASE(empty_record_list)
+    {
+        xml::Pretty_Writer_Arguments args;
+        args.split_path = { 1, 3 };
+        BOOST_CHECK_EQUAL(write_json(string("\x61\x02\x63\x00", 4), args),
+                "{\"APPLICATION_1\":{\"APPLICATION_3\":{}}}\n");
+        BOOST_CHECK_THROW(write_json(string("\x61\x03\x63\x00", 4), args),
+                std::exception);
+    }
+
+  BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,8 @@
 
 #include "ber2xml.hh"
 
+#include <xfsx_config.hh>
+
 #include <boost/test/unit_test.hpp>
 #include <boost/test/parameterized_test.hpp>
 #include <boost/filesystem.hpp>
@@ -34,6 +36,7 @@
 #include <array>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <functional>
 
 #include <xfsx/ber2xml.hh>
@@ -42,9 +45,12 @@
 #include <xfsx/byte.hh>
 
 #include "test.hh"
+#include "tap_fixture.hh"
 
 using namespace std;
 using u8 = xfsx::u8;
+using test::tap::tlv;
+using test::tap::indef;
 
 namespace bf = boost::filesystem;
 
@@ -360,6 +366,346 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
             std::range_error);
       }
 
+      static string pretty_string(xfsx::scratchpad::Simple_Reader<u8> &r,
+          const xfsx::xml::Pretty_Writer_Arguments &args,
+          const xfsx::xml::Checkpoint *c = nullptr)
+      {
+        using namespace xfsx;
+        auto w = scratchpad::mk_simple_writer<char>();
+        if (c)
+          xml::pretty_write(r, w, args, *c);
+        else
+          xml::pretty_write(r, w, args);
+        return test::tap::contents(w);
+      }
+
+      BOOST_AUTO_TEST_CASE(checkpoint)
+      {
+        using namespace xfsx;
+        bf::path out(test::path::out());
+        out /= "ber_xml";
+        bf::create_directories(out);
+        out /= "checkpoint";
+        bf::remove(out);
+
+        auto f = ixxx::util::mmap_file(test::path::in()
+            + "/asn1c/examples/sample.source.TAP3/sample-DataInterChange-1.ber");
+        xml::Pretty_Writer_Arguments args;
+        auto r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        string ref(pretty_string(r, args));
+
+        args.checkpoint_filename = out.generic_string();
+        args.checkpoint_key = "sample 42";
+        // i.e. exactly one checkpoint in the second half
+        args.checkpoint_interval = f.size() / 2 + 1;
+        r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        BOOST_CHECK_EQUAL(pretty_string(r, args), ref);
+
+        xml::Checkpoint c;
+        c.load(out.generic_string());
+        BOOST_CHECK(c.in_off > f.size() / 2);
+        BOOST_CHECK(c.in_off < f.size());
+        BOOST_CHECK(c.out_off < ref.size());
+        BOOST_CHECK(!c.tags.empty());
+        BOOST_CHECK_EQUAL(c.key, "sample 42");
+
+        args.checkpoint_filename.clear();
+        r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        string rest(pretty_string(r, args, &c));
+        BOOST_CHECK_EQUAL(ref.substr(0, c.out_off) + rest, ref);
+
+        // i.e. a reader that is already positioned at the checkpoint
+        r = scratchpad::mk_simple_reader(f.begin() + c.in_off, f.end());
+        r.set_pos(c.in_off);
+        BOOST_CHECK_EQUAL(pretty_string(r, args, &c), rest);
+
+        // i.e. a checkpoint of another input or other options
+        args.checkpoint_key = "other 42";
+        r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        BOOST_CHECK_THROW(pretty_string(r, args, &c), std::runtime_error);
+      }
+
+      BOOST_AUTO_TEST_CASE(pretty_size)
+      {
+        using namespace xfsx;
+        auto f = ixxx::util::mmap_file(test::path::in()
+            + "/asn1c/examples/sample.source.TAP3/sample-DataInterChange-1.ber");
+        xml::Pretty_Writer_Arguments args;
+        auto r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        string ref(pretty_string(r, args));
+        BOOST_CHECK_EQUAL(xml::pretty_size(f.begin(), f.end(), args),
+            ref.size());
+
+        args.translator.push(Klasse::APPLICATION, {
+            { 1, "TransferBatch" },
+            { 3, "CallEventDetailList" },
+            { 9, "MobileOriginatedCall" },
+            { 16, "LocalTimeStamp" },
+            { 20, "TotalCallEventDuration" },
+            { 115, "ImsiSimple" } });
+        args.typifier.push(Klasse::APPLICATION, 20, Type::INT_64);
+        args.typifier.push(Klasse::APPLICATION, 115, Type::BCD);
+        args.dump_tl = args.dump_t = args.dump_length = args.dump_offset
+          = args.hex_dump = true;
+        r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        ref = pretty_string(r, args);
+        BOOST_CHECK_EQUAL(xml::pretty_size(f.begin(), f.end(), args),
+            ref.size());
+
+        // i.e. the CDRs are written directly into the measured regions
+        args.threads = 3;
+        args.split_path = { 1, 3 };
+        r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        BOOST_CHECK_EQUAL(pretty_string(r, args), ref);
+
+        // i.e. into a preallocated buffer, like a mapped output file
+        size_t reserve = 0;
+        size_t n = xml::pretty_size(f.begin(), f.end(), args, &reserve);
+        vector<char> v(n + reserve);
+        auto w = scratchpad::mk_simple_writer<char>(v.data(),
+            v.data() + v.size());
+        xml::pretty_write(f.begin(), f.end(), w, args);
+        BOOST_CHECK_EQUAL(w.pos(), n);
+        BOOST_CHECK_EQUAL(string(v.data(), n), ref);
+
+        // i.e. the write pass reuses the regions of the size pass
+        xml::Layout layout;
+        r = scratchpad::mk_simple_reader(f.begin(), f.end());
+        BOOST_CHECK_EQUAL(xml::pretty_size(r, args, &reserve, &layout), n);
+        BOOST_REQUIRE_EQUAL(layout.splits.size(), 1u);
+        BOOST_CHECK_EQUAL(layout.splits[0].sizes.size(), 3u);
+        {
+          std::fill(v.begin(), v.end(), 0);
+          r = scratchpad::mk_simple_reader(f.begin(), f.end());
+          auto w = scratchpad::mk_simple_writer<char>(v.data(),
+              v.data() + v.size());
+          xml::pretty_write(r, w, args, layout);
+          BOOST_CHECK_EQUAL(w.pos(), n);
+          BOOST_CHECK_EQUAL(string(v.data(), n), ref);
+        }
+        {
+          layout.splits[0].sizes[0] += 1;
+          r = scratchpad::mk_simple_reader(f.begin(), f.end());
+          auto w = scratchpad::mk_simple_writer<char>(v.data(),
+              v.data() + v.size());
+          BOOST_CHECK_THROW(xml::pretty_write(r, w, args, layout),
+              std::logic_error);
+        }
+
+        args.count = 10;
+        BOOST_CHECK_THROW(xml::pretty_size(f.begin(), f.end(), args),
+            std::range_error);
+      }
+
+      BOOST_AUTO_TEST_CASE(select)
+      {
+        using namespace xfsx;
+        string ber(tlv('\x61',
+              tlv('\x64', tlv('\x50', "2014"))
+            + tlv('\x63',
+                  tlv('\x69', tlv('\x50', "20140301") + tlv('\x54', "\x05"))
+                + tlv('\x69', tlv('\x54', "\x06")))
+            // i.e. an indefinite AuditControlInfo
+            + indef('\x6f', tlv('\x54', "\x0b"))));
+        auto args = test::tap::pretty_args();
+        args.select_paths = { { { 1, 4 }, false }, { { 16 }, true } };
+        auto b = reinterpret_cast<const u8*>(ber.data());
+        auto r = scratchpad::mk_simple_reader(b, b + ber.size());
+        BOOST_CHECK_EQUAL(pretty_string(r, args),
+            "<TransferBatch>\n"
+            "    <BatchControlInfo>\n"
+            "        <LocalTimeStamp>2014</LocalTimeStamp>\n"
+            "    </BatchControlInfo>\n"
+            "    <CallEventDetailList>\n"
+            "        <MobileOriginatedCall>\n"
+            "            <LocalTimeStamp>20140301</LocalTimeStamp>\n"
+            "        </MobileOriginatedCall>\n"
+            "    </CallEventDetailList>\n"
+            "</TransferBatch>\n");
+
+        args.select_paths = { { { 1, 3, 0, 20 }, false } };
+        r = scratchpad::mk_simple_reader(b, b + ber.size());
+        BOOST_CHECK_EQUAL(pretty_string(r, args),
+            "<TransferBatch>\n"
+            "    <CallEventDetailList>\n"
+            "        <MobileOriginatedCall>\n"
+            "            <TotalCallEventDuration>5</TotalCallEventDuration>\n"
+            "        </MobileOriginatedCall>\n"
+            "        <MobileOriginatedCall>\n"
+            "            <TotalCallEventDuration>6</TotalCallEventDuration>\n"
+            "        </MobileOriginatedCall>\n"
+            "    </CallEventDetailList>\n"
+            "</TransferBatch>\n");
+
+        args.select_paths = { { { 1, 16 }, false } };
+        r = scratchpad::mk_simple_reader(b, b + ber.size());
+        BOOST_CHECK_EQUAL(pretty_string(r, args), "");
+      }
+
+
+#ifdef XFSX_USE_LUA
+      // i.e. the same callbacks, once called per value and once
+      // per CDR (pp_batch) and per match (xpath_callback batch)
+      static const char pp_common_lua[] = R"(
+rates = {}
+local code = nil
+function acc_push(tag, v)
+  if tag == 23 then code = v elseif tag == 24 then rates[code] = v end
+end
+cdr_values = 0
+function cdr_push(tag, v) cdr_values = cdr_values + 1 end
+
+tag_callback = {
+  [16] = function(s)
+           return s:sub(1, 4) .. '-' .. s:sub(5, 6) .. '-' .. s:sub(7, 8) end,
+  [20] = function(v) return string.format('%ds', v) end,
+  [25] = function(v)
+           return string.format('%d (rate %d)', v, rates[code] or -1) end,
+  [26] = function(v)
+           return string.format('%d after %d values', v, cdr_values) end
+}
+)";
+      static const char pp_value_lua[] = R"(
+xpath_callback = {
+  { path = 'TransferBatch/AccountingInfo', push = acc_push },
+  { path = 'TransferBatch/CallEventDetailList/*', push = cdr_push }
+}
+)";
+      static const char pp_batch_lua[] = R"(
+local function value(tags, offs, lens, buf, i)
+  local x = buf:sub(offs[i], offs[i] + lens[i] - 1)
+  if tags[i] == 16 then return x end
+  return math.tointeger(tonumber(x))
+end
+xpath_callback = {
+  { path = 'TransferBatch/AccountingInfo',
+    batch = function(n, tags, offs, lens, buf)
+      for i = 1, n do
+        acc_push(tags[i], value(tags, offs, lens, buf, i))
+      end
+    end },
+  { path = 'TransferBatch/CallEventDetailList/*',
+    batch = function(n, tags, offs, lens, buf)
+      cdr_values = cdr_values + n
+      groups = (groups and groups .. ',' or '') .. n
+    end }
+}
+pp_batch = {
+  path = 'TransferBatch/CallEventDetailList/*',
+  fn = function(n, tags, offs, lens, buf)
+    local r = {}
+    for i = 1, n do
+      r[i] = tag_callback[tags[i]](value(tags, offs, lens, buf, i))
+    end
+    return r
+  end
+}
+)";
+
+      BOOST_AUTO_TEST_CASE(pp_batch)
+      {
+        using namespace xfsx;
+        bf::path out(test::path::out());
+        out /= "ber_xml";
+        bf::create_directories(out);
+        string value_fn((out / "pp_value.lua").generic_string());
+        string batch_fn((out / "pp_batch.lua").generic_string());
+        ofstream(value_fn) << pp_common_lua << pp_value_lua;
+        ofstream(batch_fn) << pp_common_lua << pp_batch_lua;
+
+        string ber(tlv('\x61',
+              tlv('\x65', tlv('\x57', "\x01") + tlv('\x58', "\x03")
+                + tlv('\x57', string(1, '\0')) + tlv('\x58', "\x02"))
+            + tlv('\x63',
+                  tlv('\x69', tlv('\x50', "20140301") + tlv('\x54', "\x0a")
+                    + tlv('\x6a', tlv('\x59', "\x03\xe8"))
+                    + tlv('\x56', "DEUD1"))
+                // i.e. an indefinite CDR isn't batched
+                + indef('\x69', tlv('\x50', "20140302"))
+                + tlv('\x69', tlv('\x54', "\x14") + tlv('\x59', "\x07")))
+            + tlv('\x6f', tlv('\x5a', "\x05"))));
+        xml::Pretty_Writer_Arguments args;
+        args.translator.push(Klasse::APPLICATION, {
+            { 1, "TransferBatch" },
+            { 3, "CallEventDetailList" },
+            { 5, "AccountingInfo" },
+            { 9, "MobileOriginatedCall" },
+            { 10, "BasicServiceUsed" },
+            { 15, "AuditControlInfo" },
+            { 16, "LocalTimeStamp" },
+            { 20, "TotalCallEventDuration" },
+            { 22, "Sender" },
+            { 23, "ExchangeRateCode" },
+            { 24, "ExchangeRate" },
+            { 25, "Charge" },
+            { 26, "TotalCharge" } });
+        unordered_map<string, tuple<bool, uint32_t, uint32_t>> m;
+        m["TransferBatch"] = make_tuple(false, 1u, 1u);
+        m["CallEventDetailList"] = make_tuple(false, 1u, 3u);
+        m["AccountingInfo"] = make_tuple(false, 1u, 5u);
+        args.name_translator = Name_Translator(std::move(m));
+        for (Tag_Int t : { 20, 23, 24, 25, 26 })
+          args.typifier.push(Klasse::APPLICATION, t, Type::INT_64);
+        args.pretty_print = true;
+        args.pp_filename = value_fn;
+        auto b = reinterpret_cast<const u8*>(ber.data());
+        auto r = scratchpad::mk_simple_reader(b, b + ber.size());
+        string ref(pretty_string(r, args));
+        BOOST_CHECK_EQUAL(ref,
+            "<TransferBatch>\n"
+            "    <AccountingInfo>\n"
+            "        <ExchangeRateCode>1</ExchangeRateCode>\n"
+            "        <ExchangeRate>3</ExchangeRate>\n"
+            "        <ExchangeRateCode>0</ExchangeRateCode>\n"
+            "        <ExchangeRate>2</ExchangeRate>\n"
+            "    </AccountingInfo>\n"
+            "    <CallEventDetailList>\n"
+            "        <MobileOriginatedCall>\n"
+            "            <LocalTimeStamp pp='2014-03-01'>20140301</LocalTimeStamp>\n"
+            "            <TotalCallEventDuration pp='10s'>10</TotalCallEventDuration>\n"
+            "            <BasicServiceUsed>\n"
+            "                <Charge pp='1000 (rate 2)'>1000</Charge>\n"
+            "            </BasicServiceUsed>\n"
+            "            <Sender>DEUD1</Sender>\n"
+            "        </MobileOriginatedCall>\n"
+            "        <MobileOriginatedCall definite='false'>\n"
+            "            <LocalTimeStamp pp='2014-03-02'>20140302</LocalTimeStamp>\n"
+            "        </MobileOriginatedCall> <!-- indefinite -->\n"
+            "        <MobileOriginatedCall>\n"
+            "            <TotalCallEventDuration pp='20s'>20</TotalCallEventDuration>\n"
+            "            <Charge pp='7 (rate 2)'>7</Charge>\n"
+            "        </MobileOriginatedCall>\n"
+            "    </CallEventDetailList>\n"
+            "    <AuditControlInfo>\n"
+            "        <TotalCharge pp='5 after 7 values'>5</TotalCharge>\n"
+            "    </AuditControlInfo>\n"
+            "</TransferBatch>\n");
+
+        args.pp_filename = batch_fn;
+        r = scratchpad::mk_simple_reader(b, b + ber.size());
+        BOOST_CHECK_EQUAL(pretty_string(r, args), ref);
+
+        // i.e. only the values of the definite CDRs are batched and
+        // the xpath batch is called at the end of each match
+        ofstream(batch_fn, ios::app) << "local fn = pp_batch.fn\n"
+          "pp_batch.fn = function(...)\n"
+          "  local r = fn(...)\n"
+          "  for i = 1, #r do r[i] = '#' .. r[i] end\n"
+          "  return r\n"
+          "end\n"
+          "tag_callback[26] = function(v) return groups end\n";
+        string batched(ref);
+        batched.replace(batched.find("5 after 7 values"), 16, "4,1,2");
+        for (auto x : { "2014-03-01", "10s", "1000 ", "20s", "7 " }) {
+          auto i = batched.find(string("pp='") + x);
+          BOOST_REQUIRE(i != string::npos);
+          batched.insert(i + 4, "#");
+        }
+        r = scratchpad::mk_simple_reader(b, b + ber.size());
+        BOOST_CHECK_EQUAL(pretty_string(r, args), batched);
+      }
+#endif // XFSX_USE_LUA
+
   BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE_END()
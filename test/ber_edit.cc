@@ -0,0 +1,207 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <boost/test/unit_test.hpp>
+
+#include <xfsx/ber_edit.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <string>
+
+#include "tap_fixture.hh"
+
+using namespace std;
+using namespace xfsx;
+using test::tap::tlv;
+using test::tap::indef;
+using test::tap::cdr;
+using test::tap::pretty_args;
+using test::tap::ber_args;
+
+static ber::edit::Op remove_op(const string &path)
+{
+    ber::edit::Op op;
+    BOOST_REQUIRE(ber::edit::parse_path(path, op.path));
+    return op;
+}
+
+static ber::edit::Op replace_op(const string &path, const string &regex,
+        const string &subst)
+{
+    ber::edit::Op op;
+    op.kind = ber::edit::Kind::REPLACE;
+    BOOST_REQUIRE(ber::edit::parse_path(path, op.path));
+    op.regex = regex;
+    op.subst = subst;
+    return op;
+}
+
+static string edit(const string &ber, const vector<ber::edit::Op> &ops)
+{
+    auto w = scratchpad::mk_simple_writer<u8>();
+    const u8 *b = reinterpret_cast<const u8*>(ber.data());
+    auto pargs = pretty_args();
+    auto bargs = ber_args();
+    ber::edit::apply(b, b + ber.size(), w, ops, pargs, bargs);
+    return test::tap::contents(w);
+}
+
+BOOST_AUTO_TEST_SUITE(xfsx_)
+
+  BOOST_AUTO_TEST_SUITE(ber_edit)
+
+    BOOST_AUTO_TEST_CASE(parse_path)
+    {
+        ber::edit::Path p;
+        BOOST_CHECK(ber::edit::parse_path("/TransferBatch/*/Sender", p));
+        BOOST_CHECK(!p.anywhere);
+        BOOST_CHECK(p.steps == vector<string>({ "TransferBatch", "*",
+                    "Sender" }));
+        BOOST_CHECK(ber::edit::parse_path("//Sender", p));
+        BOOST_CHECK(p.anywhere);
+        BOOST_CHECK(p.steps == vector<string>({ "Sender" }));
+
+        BOOST_CHECK(!ber::edit::parse_path("(/*/CallEventDetailList/*)[3]",
+                    p));
+        BOOST_CHECK(!ber::edit::parse_path("/TransferBatch[1]", p));
+        BOOST_CHECK(!ber::edit::parse_path("/TransferBatch//Sender", p));
+        BOOST_CHECK(!ber::edit::parse_path("/TransferBatch/", p));
+        BOOST_CHECK(!ber::edit::parse_path("Sender", p));
+        BOOST_CHECK(!ber::edit::parse_path("//", p));
+        BOOST_CHECK(!ber::edit::parse_path("/../Sender", p));
+    }
+
+    BOOST_AUTO_TEST_CASE(identity)
+    {
+        // i.e. untouched lengths aren't normalized
+        string a = cdr("20140301", 1, "AB");
+        string s = tlv('\x61', tlv('\x64', tlv('\x56', "DEUD1"))
+                + "\x63\x81" + char(a.size()) + a);
+        BOOST_CHECK(edit(s, { remove_op("/foobar") }) == s);
+        BOOST_CHECK(edit(s, {}) == s);
+    }
+
+    BOOST_AUTO_TEST_CASE(remove)
+    {
+        string a = cdr("20140301140342", 10, "DEUD1");
+        string b = cdr("20140301140350", 20, "FRAF1");
+        string s = tlv('\x61', tlv('\x64', tlv('\x56', "DEUD1"))
+                + tlv('\x63', a + b + a));
+        BOOST_CHECK(edit(s, { remove_op("//MobileOriginatedCall") })
+                == tlv('\x61', tlv('\x64', tlv('\x56', "DEUD1"))
+                    + tlv('\x63', "")));
+        BOOST_CHECK(edit(s, { remove_op("/TransferBatch/*/*/Sender") })
+                == tlv('\x61', tlv('\x64', tlv('\x56', "DEUD1"))
+                    + tlv('\x63',
+                          tlv('\x69', tlv('\x50', "20140301140342")
+                              + tlv('\x54', "\x0a"))
+                        + tlv('\x69', tlv('\x50', "20140301140350")
+                              + tlv('\x54', "\x14"))
+                        + tlv('\x69', tlv('\x50', "20140301140342")
+                              + tlv('\x54', "\x0a")))));
+        BOOST_CHECK(edit(s, { remove_op("/TransferBatch") }).empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(remove_shrinks_length)
+    {
+        // i.e. the CallEventDetailList length shrinks below 128 bytes,
+        // thus the length of the TransferBatch shrinks twice
+        string a = cdr("20140301140342", 10, "DEUD1");
+        string b = cdr(string(100, '1'), 20, "FRAF1");
+        string s = tlv('\x61', tlv('\x63', a + b));
+        BOOST_CHECK(s.size() > 0x80);
+        string t = edit(s, { remove_op("/TransferBatch/CallEventDetailList/"
+                    "MobileOriginatedCall/LocalTimeStamp") });
+        BOOST_CHECK(t == tlv('\x61', tlv('\x63',
+                        tlv('\x69', tlv('\x54', "\x0a") + tlv('\x56', "DEUD1"))
+                      + tlv('\x69', tlv('\x54', "\x14") + tlv('\x56', "FRAF1"))
+                      )));
+        BOOST_CHECK(t.size() < 0x80);
+
+        // i.e. a non-minimal length encoding is kept
+        s = "\x61\x82" + string(1, '\0') + char(a.size()) + a;
+        BOOST_CHECK(edit(s, { remove_op("//Sender") })
+                == "\x61\x82" + string(1, '\0') + char(a.size() - 7)
+                + tlv('\x69', tlv('\x50', "20140301140342")
+                    + tlv('\x54', "\x0a")));
+    }
+
+    BOOST_AUTO_TEST_CASE(indefinite)
+    {
+        string a = cdr("20140301140342", 10, "DEUD1");
+        string b = indef('\x69', tlv('\x50', "20140301140350")
+                + indef('\x6a', tlv('\x56', "FRAF1")));
+        string s = tlv('\x61', indef('\x63', a + b + a));
+        BOOST_CHECK(edit(s, { remove_op("//MobileOriginatedCall") })
+                == tlv('\x61', indef('\x63', "")));
+        BOOST_CHECK(edit(s, { remove_op("//Sender") })
+                == tlv('\x61', indef('\x63',
+                        tlv('\x69', tlv('\x50', "20140301140342")
+                            + tlv('\x54', "\x0a"))
+                        + indef('\x69', tlv('\x50', "20140301140350")
+                            + indef('\x6a', ""))
+                        + tlv('\x69', tlv('\x50', "20140301140342")
+                            + tlv('\x54', "\x0a")))));
+    }
+
+    BOOST_AUTO_TEST_CASE(replace)
+    {
+        string a = cdr("20140301140342", 10, "DEUD1");
+        string s = tlv('\x61', tlv('\x63', a + a));
+        auto r = cdr("20160301140342", 10, "DEUD1");
+        BOOST_CHECK(edit(s, { replace_op("//LocalTimeStamp",
+                        "^[0-9]{4}(.*)$", "2016\\1") })
+                == tlv('\x61', tlv('\x63', r + r)));
+
+        // i.e. the content is edited as text and encoded by type
+        r = tlv('\x69', tlv('\x50', "20140301140342")
+                + tlv('\x54', string("\x01\x00", 2)) + tlv('\x56', "DEUD1"));
+        BOOST_CHECK(edit(s, { replace_op(
+                        "/*/*/MobileOriginatedCall/TotalCallEventDuration",
+                        "^10$", "256") })
+                == tlv('\x61', tlv('\x63', r + r)));
+
+        // i.e. ops are applied in order
+        r = tlv('\x69', tlv('\x50', "20140301140342")
+                + tlv('\x54', "\x0a") + tlv('\x56', "FRAF2"));
+        BOOST_CHECK(edit(s, {
+                    replace_op("//Sender", "DEUD", "FRAF"),
+                    replace_op("//Sender", "1$", "2") })
+                == tlv('\x61', tlv('\x63', r + r)));
+
+        BOOST_CHECK_THROW(edit(s, { replace_op("//CallEventDetailList",
+                        "a", "b") }), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(patches)
+    {
+        string a = cdr("20140301140342", 10, "DEUD1");
+        string s = indef('\x61', tlv('\x64', tlv('\x56', "DEUD1"))
+                + tlv('\x63', a + a + a));
+        auto pargs = pretty_args();
+        auto bargs = ber_args();
+        vector<ber::edit::Op> ops = { remove_op("/*/BatchControlInfo/Sender") };
+        ber::edit::Editor e(ops, pargs, bargs);
+        const u8 *b = reinterpret_cast<const u8*>(s.data());
+        auto r = scratchpad::mk_simple_reader(b, b + s.size());
+        e.scan(r);
+        // i.e. the removal and the BatchControlInfo header - but not the
+        // indefinite TransferBatch header
+        BOOST_CHECK_EQUAL(e.patches(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(invalid)
+    {
+        string s = tlv('\x61', tlv('\x63', cdr("2014", 10, "DEUD1")));
+        string t = s;
+        t[1] = char(t[1] - 1);
+        BOOST_CHECK_THROW(edit(t, { remove_op("//Sender") }), std::range_error);
+        t = s.substr(0, s.size() - 1);
+        BOOST_CHECK_THROW(edit(t, { remove_op("//Sender") }), std::exception);
+        t = s + string(2, '\0');
+        BOOST_CHECK_THROW(edit(t, { remove_op("//Sender") }), Unexpected_EOC);
+    }
+
+  BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
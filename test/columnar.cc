@@ -0,0 +1,162 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <boost/test/unit_test.hpp>
+
+#include <xfsx/columnar.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <sstream>
+#include <string>
+
+#include "tap_fixture.hh"
+
+using namespace std;
+using namespace xfsx;
+using test::tap::tlv;
+using test::tap::cdr;
+
+static string tap_ber()
+{
+    return tlv('\x61', tlv('\x64', tlv('\x50', "hd"))
+            + tlv('\x63',
+                  cdr("20140301140342",  10, "DEUD1")
+                + cdr("20140301140350",  20, "DEUD1")
+                + cdr("20140301150000",  30, "FRAF1")
+                + cdr("20140302000000", 100, "DEUD1")
+                + cdr("20140302000001", 120, "DEUD1")
+                + cdr("20140302000002",  -1, "DEUD1"))
+            + tlv('\x6f', tlv('\x54', "\x05")));
+}
+
+static xml::Pretty_Writer_Arguments tap_args()
+{
+    auto args = test::tap::pretty_args();
+    args.split_path = { 1, 3 };
+    return args;
+}
+
+static string columnize(const string &ber, size_t block_rows)
+{
+    istringstream in(
+            "ts      /LocalTimeStamp\n"
+            "dur     /TotalCallEventDuration\n"
+            "sender  /Sender\n");
+    auto columns = csv::read_columns(in, test::tap::names());
+
+    auto w = scratchpad::mk_simple_writer<char>();
+    const u8 *b = reinterpret_cast<const u8*>(ber.data());
+    columnar::write(b, b + ber.size(), w, tap_args(), columns, block_rows);
+    return test::tap::contents(w);
+}
+
+static string to_string(const vector<columnar::Value> &row)
+{
+    string r;
+    for (auto &v : row) {
+        if (!r.empty())
+            r += ',';
+        switch (v.kind) {
+            case columnar::Kind::NONE:   r += "-"; break;
+            case columnar::Kind::INT:    r += std::to_string(v.i); break;
+            case columnar::Kind::STRING: r += v.s; break;
+        }
+    }
+    return r;
+}
+
+static vector<string> scan(columnar::Reader &r, const vector<string> &columns,
+        const vector<columnar::Predicate> &predicates)
+{
+    vector<string> rows;
+    r.scan(columns, predicates, [&rows](const vector<columnar::Value> &row) {
+            rows.push_back(to_string(row)); });
+    return rows;
+}
+
+BOOST_AUTO_TEST_SUITE(xfsx_)
+
+  BOOST_AUTO_TEST_SUITE(columnar_)
+
+    BOOST_AUTO_TEST_CASE(round_trip)
+    {
+        auto s = columnize(tap_ber(), 4);
+        auto b = reinterpret_cast<const u8*>(s.data());
+        columnar::Reader r(b, b + s.size());
+        BOOST_CHECK(r.columns() == vector<string>({"ts", "dur", "sender"}));
+
+        auto rows = scan(r, { "sender", "ts", "dur" }, {});
+        BOOST_CHECK(rows == vector<string>({
+                    "DEUD1,20140301140342,10",
+                    "DEUD1,20140301140350,20",
+                    "FRAF1,20140301150000,30",
+                    "DEUD1,20140302000000,100",
+                    "DEUD1,20140302000001,120",
+                    "DEUD1,20140302000002,-" }));
+        BOOST_CHECK_EQUAL(r.decoded_blocks(), 2u);
+        BOOST_CHECK_EQUAL(r.skipped_blocks(), 0u);
+
+        BOOST_CHECK_THROW(scan(r, { "imsi" }, {}), std::range_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(predicates)
+    {
+        using columnar::Op;
+        auto s = columnize(tap_ber(), 3);
+        auto b = reinterpret_cast<const u8*>(s.data());
+        columnar::Reader r(b, b + s.size());
+
+        auto rows = scan(r, { "ts" }, { { "dur", Op::GE, "100" } });
+        BOOST_CHECK(rows == vector<string>({ "20140302000000",
+                    "20140302000001" }));
+        BOOST_CHECK_EQUAL(r.decoded_blocks(), 1u);
+        BOOST_CHECK_EQUAL(r.skipped_blocks(), 1u);
+
+        rows = scan(r, { "ts", "dur" }, { { "sender", Op::EQ, "FRAF1" } });
+        BOOST_CHECK(rows == vector<string>({ "20140301150000,30" }));
+        BOOST_CHECK_EQUAL(r.skipped_blocks(), 1u);
+
+        rows = scan(r, { "dur" }, { { "ts", Op::LT, "20140301150000" },
+                    { "dur", Op::NE, "10" } });
+        BOOST_CHECK(rows == vector<string>({ "20" }));
+        BOOST_CHECK_EQUAL(r.skipped_blocks(), 1u);
+
+        // i.e. missing values don't match
+        rows = scan(r, { "ts" }, { { "dur", Op::LT, "1000" } });
+        BOOST_CHECK_EQUAL(rows.size(), 5u);
+
+        rows = scan(r, { "ts" }, { { "sender", Op::GT, "X" } });
+        BOOST_CHECK(rows.empty());
+        BOOST_CHECK_EQUAL(r.decoded_blocks(), 0u);
+        BOOST_CHECK_EQUAL(r.skipped_blocks(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(mixed_types)
+    {
+        // i.e. a context-specific [20] string also matches the
+        // TotalCallEventDuration column
+        string ber = tlv('\x61', tlv('\x63',
+                  cdr("20140301140342", 150, "DEUD1")
+                + tlv('\x69', tlv('\x50', "20140301140350")
+                    + tlv('\x94', "99"))));
+        BOOST_CHECK_THROW(columnize(ber, 4), std::runtime_error);
+        BOOST_CHECK_THROW(columnize(ber, 1), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(invalid)
+    {
+        string s("xfsxcol");
+        auto b = reinterpret_cast<const u8*>(s.data());
+        BOOST_CHECK_THROW(columnar::Reader(b, b + s.size()),
+                std::runtime_error);
+
+        s = columnize(tap_ber(), 4);
+        s.resize(s.size() - 3);
+        b = reinterpret_cast<const u8*>(s.data());
+        columnar::Reader r(b, b + s.size());
+        BOOST_CHECK_THROW(scan(r, { "ts" }, {}), std::range_error);
+    }
+
+  BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
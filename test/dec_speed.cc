@@ -0,0 +1,140 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Benchmark of integer to decimal conversions, cf. bcd_speed.cc,
+// e.g.
+//
+//     $ ./dec_speed -d 16 -s 5
+
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string.h>
+#include <stdio.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <xfsx_config.hh>
+#if XFSX_HAVE_FROM_CHARS
+    #include <charconv>
+#endif
+
+#include <xfsx/integer.hh>
+
+using namespace std;
+
+static void Assert(bool b, const string &msg)
+{
+  if (!b)
+    throw std::runtime_error(msg);
+}
+
+struct Arguments {
+  size_t values       {1000}; // values per iteration
+  size_t digits       {0   }; // digits per value, 0 -> random
+  size_t seconds      {10  }; // run iterations for x seconds
+  size_t skip_seconds {2   }; // warmup
+
+  Arguments() {}
+  Arguments(int argc, char **argv)
+  {
+    for (int i = 1; i < argc; ++i) {
+      if (!strcmp(argv[i], "-n") || !strcmp(argv[i], "--values")) {
+        ++i;
+        Assert(i<argc, "-n argument is missing");
+        values = boost::lexical_cast<size_t>(argv[i]);
+      } else if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--digits")) {
+        ++i;
+        Assert(i<argc, "-d argument is missing");
+        digits = boost::lexical_cast<size_t>(argv[i]);
+        Assert(digits <= 19, "at most 19 digits are supported");
+      } else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--seconds")) {
+        ++i;
+        Assert(i<argc, "-s argument is missing");
+        seconds = boost::lexical_cast<size_t>(argv[i]);
+      } else if (!strcmp(argv[i], "-k") || !strcmp(argv[i], "--skip")) {
+        ++i;
+        Assert(i<argc, "-k argument is missing");
+        skip_seconds = boost::lexical_cast<size_t>(argv[i]);
+      }
+    }
+  }
+};
+
+static void random_init(const Arguments &args, vector<int64_t> &v)
+{
+  mt19937_64 g(23);
+  for (auto &x : v) {
+    size_t d = args.digits ? args.digits : 1 + g() % 19;
+    int64_t lo = 1;
+    for (size_t i = 1; i < d; ++i)
+      lo *= 10;
+    uniform_int_distribution<int64_t> dist(d == 1 ? 0 : lo, lo * 10 - 1);
+    x = dist(g);
+  }
+}
+
+template <typename F>
+static void bench(const string &name, const Arguments &args, F some_fn)
+{
+  vector<int64_t> v(args.values);
+  random_init(args, v);
+  vector<char> w(args.values * xfsx::integer::max_dec_size + 1);
+
+  chrono::high_resolution_clock::duration da = chrono::seconds(0);
+  size_t bytes = 0;
+  size_t values = 0;
+  for (unsigned k = 0; k<2; ++k) {
+    size_t seconds = 0;
+    if (!k)
+      seconds = args.skip_seconds;
+    else
+      seconds = args.seconds;
+    da = chrono::seconds(0);
+    bytes = 0;
+    values = 0;
+    while (size_t(chrono::duration_cast<chrono::seconds>(da).count())
+            < seconds) {
+      char *o = w.data();
+      auto start = chrono::high_resolution_clock::now();
+      for (auto x : v)
+        o = some_fn(x, o);
+      auto stop = chrono::high_resolution_clock::now();
+      da += stop - start;
+      bytes += o - w.data();
+      values += v.size();
+    }
+  }
+  double seconds = chrono::duration_cast<chrono::milliseconds>(da).count()
+    / 1000.0;
+  double mibs = double(bytes)/1024.0/1024.0;
+  cerr << name << ": formatted " << values << " values (" << mibs
+    << " MiB) in " << seconds << " s at "
+    << double(values)/seconds/1e6 << " M values/s using " << args.values
+    << " values of " << (args.digits ? to_string(args.digits) : "random")
+    << " digits per iteration\n";
+}
+
+int main(int argc, char **argv)
+{
+  Arguments args(argc, argv);
+
+  bench("snprintf", args, [](int64_t v, char *o) {
+        return o + snprintf(o, xfsx::integer::max_dec_size + 1, "%lld",
+            (long long)v); });
+#if XFSX_HAVE_FROM_CHARS
+  bench("to_chars", args, [](int64_t v, char *o) {
+        return std::to_chars(o, o + xfsx::integer::max_dec_size, v).ptr; });
+  // i.e. what byte::writer used to do
+  bench("dec_digits + to_chars", args, [](int64_t v, char *o) {
+        size_t n = v < 0 ? 1 + xfsx::integer::dec_digits(uint64_t(-v))
+                         : xfsx::integer::dec_digits(uint64_t(v));
+        return std::to_chars(o, o + n, v).ptr; });
+#endif
+  bench("format_dec", args, [](int64_t v, char *o) {
+        return xfsx::integer::format_dec(v, o); });
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <catch.hpp>
+
+#include <xfsx/gather_writer.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <ixxx/util.hh>
+
+#include <boost/filesystem.hpp>
+#include <string>
+
+#include "test.hh"
+
+using namespace std;
+using namespace xfsx;
+namespace bf = boost::filesystem;
+
+// writes: 'A' len "ab" ('B' len "cd" ('C' len) "ef") "g" ('D' len "h")
+static void write_nested(Gather_Writer &g)
+{
+    auto header = [&g](char c) {
+        u8 h[2] = { u8(c), u8(g.length()) };
+        g.begin_pop().write(h, h+2);
+        g.end_pop();
+    };
+    auto text = [&g](const char *s) {
+        string t(s);
+        g.top().write(reinterpret_cast<const u8*>(t.data()),
+                reinterpret_cast<const u8*>(t.data() + t.size()));
+    };
+    g.push();
+      text("ab");
+      g.push();
+        text("cd");
+        g.push();
+        header('C');
+        text("ef");
+      header('B');
+      text("g");
+    header('A');
+    g.push();
+      text("h");
+    header('D');
+    g.flush();
+}
+
+static const char expected[] = "A\x0b" "ab" "B\x06" "cd" "C\x00" "ef" "g"
+                               "D\x01" "h";
+
+TEST_CASE( "gather writer " "memory", "[gather]" )
+{
+    auto w = scratchpad::mk_simple_writer<u8>();
+    Gather_Writer g(w);
+    write_nested(g);
+    CHECK(g.depth() == 0);
+    CHECK(w.pos() == sizeof expected - 1);
+    auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
+            w.backend())->pad();
+    string t(pad.prelude(), pad.cbegin());
+    CHECK(t == string(expected, sizeof expected - 1));
+}
+
+TEST_CASE( "gather writer " "writev", "[gather]" )
+{
+    string out_dir(test::path::out() + "/gather_writer");
+    bf::create_directories(out_dir);
+    auto filename = out_dir + "/nested";
+    bf::remove(filename);
+    {
+        auto w = scratchpad::mk_simple_writer<u8>(filename);
+        auto &sink = dynamic_cast<scratchpad::File_Writer<u8>*>(
+                w.backend())->sink();
+        // i.e. large enough to not be buffered
+        sink.set_increment(4);
+        Gather_Writer g(w);
+        write_nested(g);
+        CHECK(w.pos() == sizeof expected - 1);
+        CHECK(sink.stats().write_bytes == sizeof expected - 1);
+    }
+    auto m = ixxx::util::mmap_file(filename);
+    CHECK(string(m.s_begin(), m.s_end())
+            == string(expected, sizeof expected - 1));
+}
@@ -177,6 +177,31 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
               BOOST_REQUIRE(r == begin+5);
             }
 
+            BOOST_AUTO_TEST_CASE(not_a_reference)
+            {
+              const char inp[] = "a & b &#x2 &#y20; &";
+              const char *begin = inp;
+              const char *end = inp + sizeof(inp)-1;
+              auto r = Next_Quoted::Base<Style::XML>()(begin, end);
+              BOOST_REQUIRE(r == end);
+            }
+
+            BOOST_AUTO_TEST_CASE(long_runs)
+            {
+              for (size_t i = 0; i < 100; ++i) {
+                string inp(i, 'x');
+                inp += "&amp;&#x";
+                inp += string(i % 37, 'y');
+                inp += "&#x20;";
+                const char *begin = inp.data();
+                const char *end = inp.data() + inp.size();
+                auto r = Next_Quoted::Base<Style::XML>()(begin, end);
+                BOOST_REQUIRE(r == end - 6);
+                r = Next_Quoted::Base<Style::XML>()(begin, end - 1);
+                BOOST_REQUIRE(r == end - 1);
+              }
+            }
+
           BOOST_AUTO_TEST_SUITE_END()
 
         BOOST_AUTO_TEST_SUITE_END()
@@ -358,6 +383,43 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
           BOOST_CHECK_EQUAL(s, ref);
         }
 
+        BOOST_AUTO_TEST_CASE(long_runs)
+        {
+          // i.e. special bytes at all positions of 16/32 byte vectors
+          const u8 specials[] = { '&', '<', '>', 0, 31, 127, 128, 255 };
+          for (size_t len : { 1u, 15u, 16u, 17u, 31u, 32u, 33u, 100u }) {
+            for (size_t pos = 0; pos < len; ++pos) {
+              for (u8 c : specials) {
+                vector<u8> inp(len);
+                for (size_t i = 0; i < len; ++i)
+                  inp[i] = u8('A' + i % 26);
+                inp[pos] = c;
+                string ref;
+                for (u8 b : inp) {
+                  if (b < 32 || b > 126 || b == '&' || b == '<' || b == '>') {
+                    const char digits[] = "0123456789abcdef";
+                    ref += "&#x";
+                    ref += digits[b >> 4];
+                    ref += digits[b & 0xf];
+                    ref += ';';
+                  } else {
+                    ref += char(b);
+                  }
+                }
+                const u8 *begin = inp.data();
+                const u8 *end = begin + inp.size();
+                size_t n = decoded_size<Style::XML>(begin, end);
+                BOOST_REQUIRE_EQUAL(n, ref.size());
+                BOOST_CHECK(n <= max_decoded_size<Style::XML>(len));
+                vector<char> a(n);
+                auto r = decode<Style::XML>(begin, end, a.data());
+                BOOST_REQUIRE_EQUAL(size_t(r-a.data()), n);
+                BOOST_CHECK_EQUAL(string(a.begin(), a.end()), ref);
+              }
+            }
+          }
+        }
+
         BOOST_AUTO_TEST_CASE(raw)
         {
           const char inp[] = "Hello";
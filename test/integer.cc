@@ -22,6 +22,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <limits>
+#include <random>
+#include <string>
 
 #include <xfsx/integer.hh>
 
@@ -47,6 +49,80 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
       BOOST_CHECK_EQUAL(int64_t(4294967294), i);
     }
 
+    template <typename T>
+    static string fmt_dec(T v)
+    {
+      char b[max_dec_size];
+      return string(b, format_dec(v, b));
+    }
+
+    BOOST_AUTO_TEST_CASE(formatdec)
+    {
+      BOOST_CHECK_EQUAL(fmt_dec(uint64_t(0)), "0");
+      BOOST_CHECK_EQUAL(fmt_dec(int64_t(-1)), "-1");
+      BOOST_CHECK_EQUAL(fmt_dec(uint32_t(4294967295u)), "4294967295");
+      BOOST_CHECK_EQUAL(fmt_dec(int32_t(-2147483647 - 1)), "-2147483648");
+      BOOST_CHECK_EQUAL(fmt_dec(numeric_limits<uint64_t>::max()),
+          "18446744073709551615");
+      BOOST_CHECK_EQUAL(fmt_dec(numeric_limits<int64_t>::min()),
+          "-9223372036854775808");
+      // i.e. all digit counts and the boundaries between them
+      uint64_t p = 1;
+      for (unsigned i = 0; i < 20; ++i, p *= 10) {
+        BOOST_CHECK_EQUAL(fmt_dec(p), to_string(p));
+        BOOST_CHECK_EQUAL(fmt_dec(p - 1), to_string(p - 1));
+        BOOST_CHECK_EQUAL(fmt_dec(p + 7), to_string(p + 7));
+        BOOST_CHECK_EQUAL(fmt_dec(-int64_t(p)), to_string(-int64_t(p)));
+      }
+      mt19937_64 g(23);
+      for (unsigned i = 0; i < 10000; ++i) {
+        uint64_t v = g() >> (i % 64);
+        BOOST_CHECK_EQUAL(fmt_dec(v), to_string(v));
+        BOOST_CHECK_EQUAL(fmt_dec(int64_t(v)), to_string(int64_t(v)));
+      }
+    }
+
+    static pair<const char*, const char*> sp(const string &s)
+    {
+      return make_pair(s.data(), s.data() + s.size());
+    }
+
+    BOOST_AUTO_TEST_CASE(rangeto)
+    {
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("")), 0u);
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("x12")), 0u);
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("12x")), 12u);
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("1234567890123x5")), 1234567890123u);
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("00000000000000000000000042")), 42u);
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("18446744073709551615")),
+          numeric_limits<uint64_t>::max());
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("18446744073709551616")), 0u);
+      BOOST_CHECK_EQUAL(range_to_uint64(sp("99999999999999999999999")), 0u);
+      BOOST_CHECK_EQUAL(range_to_uint32(sp("4294967295")), 4294967295u);
+      BOOST_CHECK_EQUAL(range_to_uint32(sp("4294967296")), 0u);
+      BOOST_CHECK_EQUAL(range_to_int64(sp("-")), 0);
+      BOOST_CHECK_EQUAL(range_to_int64(sp("-12")), -12);
+      BOOST_CHECK_EQUAL(range_to_int64(sp("--12")), 0);
+      BOOST_CHECK_EQUAL(range_to_int64(sp("9223372036854775807")),
+          numeric_limits<int64_t>::max());
+      BOOST_CHECK_EQUAL(range_to_int64(sp("9223372036854775808")), 0);
+      BOOST_CHECK_EQUAL(range_to_int64(sp("-9223372036854775808")),
+          numeric_limits<int64_t>::min());
+      BOOST_CHECK_EQUAL(range_to_int64(sp("-9223372036854775809")), 0);
+      // i.e. all digit counts, with and without trailing garbage
+      // that is or isn't loaded together with the digits
+      mt19937_64 g(42);
+      for (unsigned i = 0; i < 10000; ++i) {
+        uint64_t v = g() >> (i % 64);
+        string s = to_string(v);
+        BOOST_CHECK_EQUAL(range_to_uint64(sp(s)), v);
+        BOOST_CHECK_EQUAL(range_to_uint64(sp(s + "/x:" + s)), v);
+        BOOST_CHECK_EQUAL(range_to_uint64(sp(s + string(i % 9, '\xff'))), v);
+        BOOST_CHECK_EQUAL(range_to_int64(sp(to_string(int64_t(v)))),
+            int64_t(v));
+      }
+    }
+
   BOOST_AUTO_TEST_SUITE_END() // integer_
 
 BOOST_AUTO_TEST_SUITE_END() // xfsx_
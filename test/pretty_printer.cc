@@ -0,0 +1,97 @@
+#include <catch.hpp>
+
+#include <xfsx/pretty_printer.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+using namespace std;
+using namespace xfsx;
+
+static string print(const pp::Printer &p, const string &s)
+{
+    auto w = scratchpad::mk_simple_writer<char>();
+    byte::writer::Base o(w);
+    if (!p.print(s.data(), s.data() + s.size(), o))
+        return "(none)";
+    w.flush();
+    auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
+            w.backend())->pad();
+    return string(pad.prelude(), pad.prelude() + w.pos());
+}
+static string print(const pp::Printer &p, int64_t v)
+{
+    auto w = scratchpad::mk_simple_writer<char>();
+    byte::writer::Base o(w);
+    if (!p.print(v, o))
+        return "(none)";
+    w.flush();
+    auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
+            w.backend())->pad();
+    return string(pad.prelude(), pad.prelude() + w.pos());
+}
+
+TEST_CASE("pretty printer tap", "[pp]")
+{
+    CHECK(print(pp::Timestamp(), "20050405090547") == "2005-04-05 09:05:47");
+    CHECK(print(pp::Timestamp(), "2005040509054") == "(none)");
+    CHECK(print(pp::Timestamp(), "2005040509054x") == "(none)");
+
+    CHECK(print(pp::Utc_Offset(), "+0200") == "+02:00");
+    CHECK(print(pp::Utc_Offset(), "-0130") == "-01:30");
+    CHECK(print(pp::Utc_Offset(), "0200") == "(none)");
+
+    CHECK(print(pp::Duration(), 153) == "2m33s");
+    CHECK(print(pp::Duration(), 500) == "8m20s");
+    CHECK(print(pp::Duration(), 7) == "7s");
+    CHECK(print(pp::Duration(), 3601) == "1h0m1s");
+    CHECK(print(pp::Duration(), -1) == "(none)");
+
+    CHECK(print(pp::Tadig(), "WERFD") == "country=\"WER\", operator=\"FD\"");
+    CHECK(print(pp::Tadig(), "WERF") == "(none)");
+
+    CHECK(print(pp::Cause_For_Termination(), 4)
+            == "unsuccessful call attempt");
+    CHECK(print(pp::Cause_For_Termination(), 2) == "(none)");
+    // string values aren't handled
+    CHECK(print(pp::Cause_For_Termination(), "4") == "(none)");
+
+    CHECK(print(pp::Tbcd(), "\x21\x43\xf5") == "12345");
+    CHECK(print(pp::Tbcd(), "\x21\x43") == "1234");
+    CHECK(print(pp::Tbcd(), "\xba") == "*#");
+    CHECK(print(pp::Tbcd(), "\xff") == "(none)");
+}
+
+TEST_CASE("pretty printer registry", "[pp]")
+{
+    pp::Registry r;
+    CHECK(r.empty());
+    CHECK(r.find(Klasse::APPLICATION, 16) == nullptr);
+
+    unordered_map<string, tuple<bool, uint32_t, uint32_t>> m;
+    m["LocalTimeStamp"] = make_tuple(false, 1u, 16u);
+    m["CauseForTermination"] = make_tuple(false, 1u, 58u);
+    m["Sender"] = make_tuple(true, 1u, 196u);
+    Name_Translator nt(std::move(m));
+    pp::register_tap(r, nt);
+    CHECK(!r.empty());
+
+    auto p = r.find(Klasse::APPLICATION, 16);
+    REQUIRE(p != nullptr);
+    CHECK(print(*p, "20140301140342") == "2014-03-01 14:03:42");
+    CHECK(r.find(Klasse::CONTEXT_SPECIFIC, 16) == nullptr);
+    CHECK(r.find(Klasse::APPLICATION, 58) != nullptr);
+    // not part of the grammar
+    CHECK(r.find(Klasse::APPLICATION, 231) == nullptr);
+    // i.e. left to the Lua module
+    CHECK(r.find(Klasse::APPLICATION, 196) == nullptr);
+
+    r.push(Klasse::APPLICATION, 16, make_shared<pp::Tadig>());
+    p = r.find(Klasse::APPLICATION, 16);
+    REQUIRE(p != nullptr);
+    CHECK(print(*p, "DEUD1") == "country=\"DEU\", operator=\"D1\"");
+
+    CHECK_THROWS(r.load("/nonexistent/libpp.so", nt));
+}
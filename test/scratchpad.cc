@@ -1,11 +1,14 @@
 #include <catch.hpp>
 
 #include <xfsx/scratchpad.hh>
+#include <xfsx/tlc_reader.hh>
+#include <xfsx/xfsx.hh>
 
 #include <ixxx/util.hh>
 
 #include <boost/filesystem.hpp>
 #include <sstream>
+#include <algorithm>
 
 #include "test.hh"
 
@@ -63,3 +66,148 @@ TEST_CASE( "scratchpad " "memory write through", "[scratchpad]" )
     string t(pad.prelude(), pad.cbegin());
     CHECK(t == s);
 }
+
+TEST_CASE( "scratchpad " "io stats", "[scratchpad]" )
+{
+    string out_dir(test::path::out() + "/scratchpad");
+    bf::create_directories(out_dir);
+    auto filename = out_dir + "/io_stats";
+    bf::remove(filename);
+    {
+        auto w = scratchpad::mk_simple_writer<char>(filename);
+        auto &sink = dynamic_cast<scratchpad::File_Writer<char>*>(w.backend())->sink();
+        sink.set_increment(4);
+        sink.set_sync(true);
+        w.write("Hello World");
+        w.write("Foo");
+        w.write("Bar23");
+        w.flush();
+        w.sync();
+        auto s = w.backend()->stats();
+        REQUIRE(s);
+        CHECK(s->write_bytes == 19);
+        CHECK(s->write_calls >= 5);
+        CHECK(s->sync_calls == 1);
+        CHECK(s->read_calls == 0);
+    }
+    auto r = scratchpad::mk_simple_reader<char>(filename);
+    auto &source = dynamic_cast<scratchpad::File_Reader<char>*>(r.backend())->source();
+    source.set_increment(4);
+    r.next(19);
+    auto s = r.backend()->stats();
+    REQUIRE(s);
+    CHECK(s->read_bytes == 19);
+    CHECK(s->read_calls == 5);
+    CHECK(s->write_calls == 0);
+    CHECK(s->grow_calls > 0);
+    CHECK(string(r.window().first, r.window().second) == "Hello WorldFooBar23");
+
+    // no read calls to count
+    auto m = scratchpad::mk_simple_reader_mapped<char>(filename);
+    CHECK(m.backend()->stats() == nullptr);
+}
+
+TEST_CASE( "scratchpad " "segmented reader", "[scratchpad]" )
+{
+    auto m = ixxx::util::mmap_file(test::path::in() + "/tap_3_12_valid.ber");
+    const u8 *begin = m.begin();
+    const u8 *end = m.end();
+    vector<TLC> ref;
+    {
+        auto r = scratchpad::mk_simple_reader<u8>(begin, end);
+        TLC t;
+        while (read_next(r, t))
+            ref.push_back(t);
+    }
+    REQUIRE(ref.size() > 100);
+    for (size_t k : { size_t(1), size_t(3), size_t(7), size_t(100),
+            size_t(m.size()) }) {
+        vector<pair<const u8*, const u8*>> segs;
+        for (const u8 *p = begin; p < end; p += k)
+            segs.emplace_back(p, min(p + k, end));
+        auto r = scratchpad::mk_simple_reader<u8>(std::move(segs));
+        TLC t;
+        size_t i = 0;
+        for (; read_next(r, t); ++i) {
+            REQUIRE(i < ref.size());
+            CHECK(t.tag == ref[i].tag);
+            CHECK(t.tl_size == ref[i].tl_size);
+            CHECK(t.length == ref[i].length);
+            if (t.shape == Shape::PRIMITIVE)
+                CHECK(equal(t.begin, t.begin + t.tl_size + t.length,
+                            ref[i].begin));
+        }
+        CHECK(i == ref.size());
+        CHECK(r.pos() == m.size());
+        auto be = dynamic_cast<scratchpad::Segmented_Reader<u8>*>(r.backend());
+        if (k == m.size())
+            CHECK(be->copied() == 0);
+        else if (k == 100)
+            CHECK(be->copied() < m.size());
+    }
+}
+
+TEST_CASE( "scratchpad " "windowed mapped reader", "[scratchpad]" )
+{
+    auto m = ixxx::util::mmap_file(test::path::in() + "/tap_3_12_valid.ber");
+    // i.e. span several pages such that TLCs straddle window boundaries
+    string data;
+    for (unsigned i = 0; i < 40; ++i)
+        data.append(m.begin(), m.end());
+    string out_dir(test::path::out() + "/scratchpad");
+    bf::create_directories(out_dir);
+    auto filename = out_dir + "/windowed.ber";
+    {
+        auto w = scratchpad::mk_simple_writer<char>(filename);
+        w.write(data.data(), data.data() + data.size());
+        w.flush();
+    }
+    const u8 *begin = reinterpret_cast<const u8*>(data.data());
+    vector<TLC> ref;
+    {
+        auto r = scratchpad::mk_simple_reader<u8>(begin, begin + data.size());
+        TLC t;
+        while (read_next(r, t))
+            ref.push_back(t);
+    }
+    for (size_t window : { size_t(1), size_t(4096), size_t(64 * 1024) }) {
+        scratchpad::Simple_Reader<u8> r(
+                std::unique_ptr<scratchpad::Reader<u8>>(
+                    new scratchpad::Windowed_Mapped_Reader<u8>(filename,
+                        window)));
+        TLC t;
+        size_t i = 0;
+        for (; read_next(r, t); ++i) {
+            REQUIRE(i < ref.size());
+            CHECK(t.tag == ref[i].tag);
+            CHECK(t.tl_size == ref[i].tl_size);
+            CHECK(t.length == ref[i].length);
+            if (t.shape == Shape::PRIMITIVE)
+                CHECK(equal(t.begin, t.begin + t.tl_size + t.length,
+                            ref[i].begin));
+        }
+        CHECK(i == ref.size());
+        CHECK(r.pos() == data.size());
+    }
+}
+
+TEST_CASE( "scratchpad " "skip", "[scratchpad]" )
+{
+    // i.e. more than one step
+    string data(3 * 1024 * 1024 + 17, '\0');
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = char(i * 7);
+    auto b = data.data();
+    auto r = scratchpad::mk_simple_reader(b, b + data.size());
+    r.skip(5);
+    CHECK(r.pos() == 5);
+    string copied;
+    r.skip(data.size() - 10, [&copied](const char *x, const char *y) {
+            copied.append(x, y); });
+    CHECK(r.pos() == data.size() - 5);
+    CHECK(copied == data.substr(5, data.size() - 10));
+    CHECK_THROWS_AS(r.skip(6), std::range_error);
+    r.skip(0);
+    r.skip(5);
+    CHECK(r.pos() == data.size());
+}
@@ -0,0 +1,50 @@
+#include <catch.hpp>
+
+#include <xfsx/sync_group.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <ixxx/util.hh>
+
+#include <boost/filesystem.hpp>
+#include <string>
+
+#include "test.hh"
+
+using namespace std;
+using namespace xfsx;
+namespace bf = boost::filesystem;
+
+TEST_CASE( "sync group " "many files", "[syncgroup]" )
+{
+    string out_dir(test::path::out() + "/sync_group");
+    bf::create_directories(out_dir);
+    scratchpad::Sync_Group g;
+    const unsigned n = 32;
+    for (unsigned i = 0; i < n; ++i) {
+        auto w = scratchpad::mk_simple_writer<char>(
+                out_dir + "/" + to_string(i));
+        dynamic_cast<scratchpad::File_Writer<char>*>(w.backend())
+            ->sink().set_increment(4);
+        w.set_sync(true);
+        w.set_sync_group(&g);
+        string s("Hello World " + to_string(i));
+        w.write(s.data(), s.data() + s.size());
+        w.flush();
+        w.sync();
+        CHECK(w.backend()->stats()->sync_calls == 1);
+    }
+    g.wait();
+    CHECK(g.batches() >= 1);
+    CHECK(g.batches() <= n);
+    for (unsigned i = 0; i < n; ++i) {
+        auto m = ixxx::util::mmap_file(out_dir + "/" + to_string(i));
+        CHECK(string(m.s_begin(), m.s_end()) == "Hello World " + to_string(i));
+    }
+}
+
+TEST_CASE( "sync group " "empty", "[syncgroup]" )
+{
+    scratchpad::Sync_Group g;
+    g.wait();
+    CHECK(g.batches() == 0);
+}
@@ -0,0 +1,84 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "tap_fixture.hh"
+
+#include <tuple>
+#include <unordered_map>
+
+using namespace std;
+using namespace xfsx;
+
+namespace test {
+
+    namespace tap {
+
+        string tlv(char tag, const string &content)
+        {
+            string r(1, tag);
+            auto n = content.size();
+            if (n < 0x80) {
+                r.push_back(char(n));
+            } else if (n < 0x100) {
+                r.push_back('\x81');
+                r.push_back(char(n));
+            } else {
+                r.push_back('\x82');
+                r.push_back(char(n >> 8));
+                r.push_back(char(n));
+            }
+            return r + content;
+        }
+
+        string indef(char tag, const string &content)
+        {
+            return string(1, tag) + '\x80' + content + string(2, '\0');
+        }
+
+        string cdr(const string &ts, int dur, const string &sender)
+        {
+            string r = tlv('\x50', ts);
+            if (dur >= 0)
+                r += tlv('\x54', string(1, char(dur)));
+            r += tlv('\x56', sender);
+            return tlv('\x69', r);
+        }
+
+        xml::Pretty_Writer_Arguments pretty_args()
+        {
+            xml::Pretty_Writer_Arguments args;
+            args.translator.push(Klasse::APPLICATION, {
+                    { 1, "TransferBatch" },
+                    { 3, "CallEventDetailList" },
+                    { 4, "BatchControlInfo" },
+                    { 9, "MobileOriginatedCall" },
+                    { 10, "BasicCallInformation" },
+                    { 15, "AuditControlInfo" },
+                    { 16, "LocalTimeStamp" },
+                    { 20, "TotalCallEventDuration" },
+                    { 22, "Sender" } });
+            args.typifier.push(Klasse::APPLICATION, 20, Type::INT_64);
+            return args;
+        }
+
+        Name_Translator names()
+        {
+            unordered_map<string, tuple<bool, uint32_t, uint32_t>> m;
+            m["BasicCallInformation"] = make_tuple(false, 1u, 10u);
+            m["LocalTimeStamp"] = make_tuple(true, 1u, 16u);
+            m["TotalCallEventDuration"] = make_tuple(true, 1u, 20u);
+            m["Sender"] = make_tuple(true, 1u, 22u);
+            return Name_Translator(std::move(m));
+        }
+
+        BER_Writer_Arguments ber_args()
+        {
+            BER_Writer_Arguments args;
+            args.translator = names();
+            args.typifier.push(Klasse::APPLICATION, 20, Type::INT_64);
+            return args;
+        }
+
+    }
+
+}
@@ -0,0 +1,48 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef TEST_TAP_FIXTURE_HH
+#define TEST_TAP_FIXTURE_HH
+
+#include <xfsx/ber_writer_arguments.hh>
+#include <xfsx/scratchpad.hh>
+#include <xfsx/xml_writer_arguments.hh>
+
+#include <string>
+
+// Small hand-made TAP-like BER fixtures, i.e. for tests that
+// don't need the full TAP grammar.
+namespace test {
+
+    namespace tap {
+
+        // i.e. definite length in the shortest form
+        std::string tlv(char tag, const std::string &content);
+        std::string indef(char tag, const std::string &content);
+
+        // i.e. MobileOriginatedCall with a LocalTimeStamp,
+        // a TotalCallEventDuration (omitted if negative) and a Sender
+        std::string cdr(const std::string &ts, int dur,
+                const std::string &sender);
+
+        // APPLICATION tag names of the fixtures, TotalCallEventDuration
+        // is typified as INT_64
+        xfsx::xml::Pretty_Writer_Arguments pretty_args();
+        xfsx::Name_Translator names();
+        xfsx::BER_Writer_Arguments ber_args();
+
+        // i.e. what was written into a scratchpad backed writer
+        template <typename Char>
+        std::string contents(xfsx::scratchpad::Simple_Writer<Char> &w)
+        {
+            auto &pad = dynamic_cast<
+                xfsx::scratchpad::Scratchpad_Writer<Char>*>(
+                        w.backend())->pad();
+            return std::string(pad.prelude(), pad.prelude() + w.pos());
+        }
+
+    }
+
+}
+
+#endif
@@ -26,6 +26,9 @@
 #include <array>
 #include <iostream>
 #include <limits>
+#include <string>
+#include <tuple>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 
@@ -2218,6 +2221,76 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
       BOOST_CHECK(type == Type::OCTET_STRING);
     }
 
+    BOOST_AUTO_TEST_CASE(translate_dense_and_sparse)
+    {
+      using namespace xfsx;
+      Tag_Translator t(Klasse::APPLICATION, { { 23u, "foo" },
+          { 100000u, "bar" } });
+      BOOST_CHECK_EQUAL(t.translate(Klasse::APPLICATION, 23u), "foo");
+      BOOST_CHECK_EQUAL(t.translate(Klasse::APPLICATION, 100000u), "bar");
+      BOOST_CHECK(!t.find(Klasse::APPLICATION, 22u));
+      BOOST_CHECK(!t.find(Klasse::APPLICATION, 24u));
+      BOOST_CHECK(!t.find(Klasse::CONTEXT_SPECIFIC, 23u));
+      size_t n = 0;
+      t.for_each([&n](Klasse, Tag_Int, const std::string &) { ++n; });
+      BOOST_CHECK_EQUAL(n, 2u);
+      t.push(Klasse::APPLICATION, { { 1u, "baz" } });
+      BOOST_CHECK(!t.find(Klasse::APPLICATION, 23u));
+      BOOST_CHECK(!t.empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(dereference_first_wins)
+    {
+      using namespace xfsx;
+      Tag_Dereferencer d;
+      d.push(Klasse::APPLICATION, { 1u, 2u, 100000u },
+          Klasse::UNIVERSAL, 4u);
+      d.push(Klasse::APPLICATION, { 2u, 3u }, Klasse::UNIVERSAL, 5u);
+      BOOST_CHECK_EQUAL(d.dereference(Klasse::APPLICATION, 2u).second, 4u);
+      BOOST_CHECK_EQUAL(d.dereference(Klasse::APPLICATION, 3u).second, 5u);
+      auto p = d.dereference(Klasse::APPLICATION, 100000u);
+      BOOST_CHECK_EQUAL(p.first, Klasse::UNIVERSAL);
+      BOOST_CHECK_EQUAL(p.second, 4u);
+      p = d.dereference(Klasse::APPLICATION, 7u);
+      BOOST_CHECK_EQUAL(p.first, Klasse::APPLICATION);
+      BOOST_CHECK_EQUAL(p.second, 7u);
+    }
+
+    BOOST_AUTO_TEST_CASE(typify_dense_and_sparse)
+    {
+      using namespace xfsx;
+      Tag_Typifier t;
+      t.push(Klasse::APPLICATION, 23u, Type::INT_64);
+      t.push(Klasse::APPLICATION, 100000u, Type::BCD);
+      BOOST_CHECK(t.typify(Klasse::APPLICATION, 23u) == Type::INT_64);
+      BOOST_CHECK(t.typify(Klasse::APPLICATION, 100000u) == Type::BCD);
+      BOOST_CHECK(t.typify(Klasse::APPLICATION, 22u) == Type::OCTET_STRING);
+      BOOST_CHECK(t.typify(Klasse::PRIVATE, 23u) == Type::OCTET_STRING);
+    }
+
+    BOOST_AUTO_TEST_CASE(name_translate)
+    {
+      using namespace xfsx;
+      std::unordered_map<std::string, std::tuple<bool, uint32_t, uint32_t> > m;
+      for (uint32_t i = 0; i < 1000; ++i)
+        m["Name" + std::to_string(i)] = std::make_tuple(i % 2, 1u, i);
+      Name_Translator t(std::move(m));
+      BOOST_CHECK(!t.empty());
+      for (uint32_t i = 0; i < 1000; ++i) {
+        auto s = "Name" + std::to_string(i);
+        auto r = t.translate(std::make_pair(s.data(), s.data() + s.size()));
+        BOOST_CHECK(std::get<0>(r)
+            == (i % 2 ? Shape::PRIMITIVE : Shape::CONSTRUCTED));
+        BOOST_CHECK_EQUAL(std::get<1>(r), Klasse::APPLICATION);
+        BOOST_CHECK_EQUAL(std::get<2>(r), i);
+      }
+      for (auto s : { "Name", "Name1000", "Nam1", "", "Name10x" })
+        BOOST_CHECK_THROW(t.translate(s_pair::mk_s_pair(s)),
+            std::out_of_range);
+      BOOST_CHECK_THROW(Name_Translator().translate(s_pair::mk_s_pair("x")),
+          std::out_of_range);
+    }
+
   BOOST_AUTO_TEST_SUITE_END()
 
 
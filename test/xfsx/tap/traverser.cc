@@ -25,6 +25,7 @@
 #include <xfsx/xfsx.hh>
 #include <xfsx/tap/traverser.hh>
 #include <xfsx/traverser/tlc.hh>
+#include <xfsx/scratchpad.hh>
 
 #include <xfsx/traverser/lxml.hh>
 #include <xfsx/xml_writer_arguments.hh>
@@ -36,8 +37,11 @@
 #include <xfsx/integer.hh>
 #include <xfsx/s_pair.hh>
 
+#include <algorithm>
 #include <deque>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
@@ -249,6 +253,75 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
           BOOST_CHECK_EQUAL(f4().second, "+0200");
         }
 
+        // i.e. the input arrives in small pieces, as with a windowed
+        // mapping
+        static xfsx::scratchpad::Simple_Reader<xfsx::u8> segmented_reader(
+            const ixxx::util::MMap &m, size_t k)
+        {
+          using namespace xfsx;
+          vector<pair<const u8*, const u8*>> segs;
+          for (const u8 *p = m.begin(); p < m.end();
+              p += std::min(k, size_t(m.end() - p)))
+            segs.emplace_back(p, std::min(p + k, m.end()));
+          return scratchpad::mk_simple_reader<u8>(std::move(segs));
+        }
+
+        BOOST_AUTO_TEST_CASE(reader_skip_children)
+        {
+          using namespace xfsx;
+          boost::filesystem::path in(test::path::in());
+          in /= "tap_3_12_valid.ber";
+          auto m = ixxx::util::mmap_file(in.generic_string());
+          auto r = segmented_reader(m, 5);
+          Vertical_TLC t;
+
+          using namespace xfsx::tap::traverser;
+          Vertical_TLC_Reader_Proxy p(r, t);
+
+          BOOST_CHECK(!p.eot(t));
+          p.advance(t);
+          BOOST_CHECK_EQUAL(p.tag(t), 4); // BatchControlInfo
+          p.skip_children(t);
+          BOOST_CHECK_EQUAL(p.tag(t), 5); // AccountingInfo
+          p.skip_children(t);
+          BOOST_CHECK_EQUAL(p.tag(t), 6); // NetworkInfo
+          p.skip_children(t);
+          BOOST_CHECK_EQUAL(p.tag(t), 3); // CallEventDetailList
+          p.skip_children(t);
+          BOOST_CHECK_EQUAL(p.tag(t), 15); // AuditControlInfo
+          BOOST_CHECK(!p.eot(t));
+          p.skip_children(t);
+          BOOST_CHECK(p.eot(t));
+        }
+
+        BOOST_AUTO_TEST_CASE(reader_multi_apply)
+        {
+          using namespace xfsx;
+          boost::filesystem::path in(test::path::in());
+          in /= "tap_3_12_valid.ber";
+          auto m = ixxx::util::mmap_file(in.generic_string());
+          for (size_t k : { size_t(1), size_t(5), m.size() }) {
+            auto r = segmented_reader(m, k);
+            Vertical_TLC t;
+
+            using namespace xfsx::tap::traverser;
+            Vertical_TLC_Reader_Proxy p(r, t);
+            CDR_Count f1;
+            Charge_Sum f2;
+            Timestamp<Less_Tag> f3;
+            Timestamp<Greater_Tag> f4;
+            Traverse st;
+            st(p, t, f1, f2, f3, f4);
+
+            BOOST_CHECK_EQUAL(f1(), 4);
+            BOOST_CHECK_EQUAL(f2(), 71200);
+            BOOST_CHECK_EQUAL(f3().first, "20140301140342");
+            BOOST_CHECK_EQUAL(f3().second, "+0200");
+            BOOST_CHECK_EQUAL(f4().first, "20140302150800");
+            BOOST_CHECK_EQUAL(f4().second, "+0200");
+          }
+        }
+
       BOOST_AUTO_TEST_SUITE_END() // basic
 
       BOOST_AUTO_TEST_SUITE(lxml)
@@ -278,6 +351,32 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
           BOOST_CHECK_EQUAL(aci.last_timestamp().second, "+0200");
         }
 
+        static size_t check_rank(const xmlNode *node)
+        {
+          size_t n = 0;
+          for (; node; node = xxxml::next_element_sibling(node)) {
+            auto rank = xxxml::get_prop(node, "rank");
+            BOOST_REQUIRE(rank.get());
+            BOOST_CHECK_EQUAL(std::to_string(xfsx::xml::l2::rank(node)),
+                rank.get());
+            n += 1 + check_rank(xxxml::first_element_child(node));
+          }
+          return n;
+        }
+
+        BOOST_AUTO_TEST_CASE(rank)
+        {
+          boost::filesystem::path in(test::path::in());
+          in /= "tap_3_12_valid.ber";
+          auto m = ixxx::util::mmap_file(in.generic_string());
+          deque<string> asn_filenames = { test::path::in()
+            + "/../../libgrammar/test/in/asn1/tap_3_12_strip.asn1"  };
+          xfsx::xml::Pretty_Writer_Arguments pargs(asn_filenames);
+          pargs.dump_rank = true;
+          auto doc = xfsx::xml::l2::generate_tree(m.begin(), m.end(), pargs);
+          BOOST_CHECK(check_rank(xxxml::doc::get_root_element(doc)) > 100);
+        }
+
       BOOST_AUTO_TEST_SUITE_END() // lxml
 
 
@@ -27,6 +27,7 @@
 #include <xfsx/scratchpad.hh>
 
 #include <string>
+#include <stdexcept>
 
 using namespace std;
 
@@ -301,7 +302,41 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
       BOOST_REQUIRE(t.has_more() == false);
     }
 
+    BOOST_AUTO_TEST_CASE(many_chunks)
+    {
+      // i.e. tags straddle the boundaries of the scanned chunks
+      string inp("<root>\n");
+      for (size_t i = 0; i < 10000; ++i)
+        inp += "<a" + string(i % 37, ' ') + ">" + to_string(i)
+          + " > " + string(i % 23, 'x') + "</a>\n";
+      inp += "</root>\n";
+      auto r = scratchpad::mk_simple_reader(inp.data(),
+          inp.data() + inp.size());
+      xml::Reader x(r);
+
+      BOOST_REQUIRE(x.next() == true);
+      BOOST_CHECK_EQUAL(string(x.tag().first, x.tag().second), "root");
+      for (size_t i = 0; i < 10000; ++i) {
+        BOOST_REQUIRE(x.next() == true);
+        BOOST_CHECK_EQUAL(s_pair::mk_string(element_name(x.tag())), "a");
+        BOOST_REQUIRE(x.next() == true);
+        BOOST_CHECK_EQUAL(string(x.tag().first, x.tag().second), "/a");
+        BOOST_CHECK_EQUAL(s_pair::mk_string(x.value()),
+            to_string(i) + " > " + string(i % 23, 'x'));
+      }
+      BOOST_REQUIRE(x.next() == true);
+      BOOST_CHECK_EQUAL(string(x.tag().first, x.tag().second), "/root");
+      BOOST_REQUIRE(x.next() == false);
+    }
 
+    BOOST_AUTO_TEST_CASE(unterminated)
+    {
+      const char inp[] = "<foo>bar</foo";
+      auto r = scratchpad::mk_simple_reader(inp, inp+sizeof inp - 1);
+      xml::Reader x(r);
+      BOOST_REQUIRE(x.next() == true);
+      BOOST_CHECK_THROW(x.next(), std::range_error);
+    }
 
   BOOST_AUTO_TEST_SUITE_END()
 
@@ -262,6 +262,73 @@ BOOST_AUTO_TEST_SUITE(xfsx_)
       }
 
 
+      static string encode(xfsx::scratchpad::Simple_Reader<char> &in,
+          unsigned threads)
+      {
+        using namespace xfsx;
+        BER_Writer_Arguments args;
+        args.threads = threads;
+        args.split_path = { 1, 3 };
+        auto o = scratchpad::mk_simple_writer<u8>();
+        xfsx::xml::write_ber(in, o, args);
+        auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
+            o.backend())->pad();
+        return string(pad.prelude(), pad.prelude() + o.pos());
+      }
+
+      BOOST_AUTO_TEST_CASE(threads)
+      {
+        // i.e. larger than the read increment of the xml::Reader
+        string inp("<?xml version='1.0'?>\n"
+            "<c tag='1' class='APPLICATION'>\n"
+            "  <c tag='4' class='APPLICATION'>\n"
+            "    <p tag='196' class='APPLICATION'>WERFD</p>\n"
+            "  </c>\n"
+            "  <c tag='3' class='APPLICATION'>\n");
+        for (size_t i = 0; i < 5000; ++i) {
+          inp += "    <c tag='9' class='APPLICATION'>\n"
+            "      <p tag='16' class='APPLICATION'>2014030114"
+            + to_string(1000 + i) + "</p>\n";
+          if (i % 7 == 0)
+            inp += "      <!-- comment -->\n"
+              "      <c tag='10' class='APPLICATION'/>\n";
+          inp += "      <c tag='11' class='APPLICATION'>\n"
+            "        <p tag='223' class='APPLICATION'>"
+            + string(i % 300, 'x') + "</p>\n"
+            "      </c>\n"
+            "    </c>\n";
+        }
+        inp += "  </c>\n"
+          "  <c tag='15' class='APPLICATION'>\n"
+          "    <p tag='223' class='APPLICATION'>5</p>\n"
+          "  </c>\n"
+          "</c>\n";
+
+        bf::path out(test::path::out());
+        out /= "xml_ber";
+        bf::create_directories(out);
+        out /= "threads.xml";
+        {
+          auto w = xfsx::scratchpad::mk_simple_writer<char>(
+              out.generic_string());
+          w.write(inp.data(), inp.data() + inp.size());
+          w.flush();
+        }
+
+        using namespace xfsx;
+        auto a = scratchpad::mk_simple_reader(inp.data(),
+            inp.data() + inp.size());
+        auto expected = encode(a, 1);
+        BOOST_REQUIRE(expected.size() > 1000);
+        for (unsigned threads : { 2u, 3u, 8u }) {
+          auto b = scratchpad::mk_simple_reader(inp.data(),
+              inp.data() + inp.size());
+          BOOST_CHECK(encode(b, threads) == expected);
+          auto c = scratchpad::mk_simple_reader<char>(out.generic_string());
+          BOOST_CHECK(encode(c, threads) == expected);
+        }
+      }
+
     BOOST_AUTO_TEST_SUITE_END()
 
   BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,7 @@
 #include "tlc_reader.hh"
 #include "tlc_writer.hh"
 #include "scratchpad.hh"
+#include "gather_writer.hh"
 
 #include <ixxx/ixxx.hh>
 #include <ixxx/util.hh>
@@ -143,23 +144,17 @@ namespace xfsx {
             // then the definite tag is finished
             std::deque<size_t> written_stack_;
 
-            // writers are reused to avoid unnecessary object reconstructions
-            // (thus no std::stack nor down-resize calls)
-            // first writer directly writes to a file
-            // for each definitive constructed a scratchpad writer is pushed
-            std::deque<scratchpad::Simple_Writer<u8>*> writer_stack_;
-            size_t writer_stack_top_{0};
-            // temporary non-root writers
-            std::deque<scratchpad::Simple_Writer<u8>> writers_;
+            // for each definite constructed tag a level is pushed,
+            // the content is gathered when the outermost one is popped
+            Gather_Writer w_;
     };
 
     Ber2Def::Ber2Def(scratchpad::Simple_Reader<u8> &r,
             scratchpad::Simple_Writer<u8> &w)
         :
-            r_(r)
+            r_(r),
+            w_(w)
     {
-        writer_stack_.push_back(&w);
-        ++writer_stack_top_;
         length_stack_.push_back(0); // for symmetry to catch all
         written_stack_.push_back(0); // catch all such that it's never popped
     }
@@ -168,45 +163,22 @@ namespace xfsx {
         while (read_next(r_, tlc_)) {
             process_tag();
         }
-        if (writer_stack_top_ != 1)
+        if (w_.depth())
             throw runtime_error("unexpected writer stack - unbalanced tags?");
         if (cons_stack_top_)
             throw runtime_error("unexpected tlv stack - unbalanced tags?");
 
-#ifndef NDEBUG
-        writer_stack_[1]->flush();
-        auto be = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
-                    writer_stack_[1]->backend());
-        auto b = be->pad().prelude();
-        auto e = be->pad().begin();
-        assert(e-b == 0);
-#endif // NDEBUG
-
-        writer_stack_[0]->flush();
+        w_.flush();
     }
     void Ber2Def::pop_constructed()
     {
-        cons_stack_[cons_stack_top_-1].init_length(
-                writer_stack_[writer_stack_top_-1]->pos()
-                );
-
-        assert(writer_stack_top_ > 1);
-        --writer_stack_top_;
-
-        writer_stack_[writer_stack_top_]->flush();
-        write_tag(*writer_stack_[writer_stack_top_-1],
-                cons_stack_[cons_stack_top_-1]);
         assert(cons_stack_top_);
-        --cons_stack_top_;
+        assert(w_.depth());
+        cons_stack_[cons_stack_top_-1].init_length(w_.length());
 
-        auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
-                writer_stack_[writer_stack_top_]->backend())->pad();
-        auto b = pad.prelude();
-        auto e = pad.begin();
-        // the Simple_Writer with File_Writer backend now supports
-        // write-through with large buffers
-        writer_stack_[writer_stack_top_-1]->write(b, e);
-        writer_stack_[writer_stack_top_]->clear();
+        write_tag(w_.begin_pop(), cons_stack_[cons_stack_top_-1]);
+        w_.end_pop();
+        --cons_stack_top_;
     }
     void Ber2Def::write_primitive()
     {
@@ -216,8 +188,7 @@ namespace xfsx {
             pop_constructed();
         } else { // non-eoc primitive
             // we can write it as-is
-            writer_stack_[writer_stack_top_-1]->write(tlc.begin,
-                    tlc.begin+tlc.tl_size+tlc.length);
+            w_.top().write(tlc.begin, tlc.begin+tlc.tl_size+tlc.length);
         }
     }
     void Ber2Def::write_constructed()
@@ -233,14 +204,7 @@ namespace xfsx {
         else
             cons_stack_[cons_stack_top_] = tlc;
         ++cons_stack_top_;
-        if (writer_stack_top_ >= writer_stack_.size()) {
-            writers_.emplace_back(
-                    std::unique_ptr<scratchpad::Writer<u8>>(
-                        new scratchpad::Scratchpad_Writer<u8>()
-                        ));
-            writer_stack_.push_back(&writers_.back());
-        }
-        ++writer_stack_top_;
+        w_.push();
     }
     void Ber2Def::process_tag()
     {
@@ -0,0 +1,335 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "ber2csv.hh"
+
+#include "xfsx.hh"
+#include "byte.hh"
+#include "bcd.hh"
+#include "hex.hh"
+#include "path.hh"
+#include "scratchpad.hh"
+#include "traverser/matcher.hh"
+#include "traverser/tlc.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace xfsx {
+
+    namespace csv {
+
+        std::vector<Column> read_columns(std::istream &in,
+                const Name_Translator &translator)
+        {
+            vector<Column> r;
+            string line;
+            size_t k = 0;
+            while (getline(in, line)) {
+                ++k;
+                istringstream l(line);
+                string name, path, rest;
+                if (!(l >> name) || name[0] == '#')
+                    continue;
+                if (!(l >> path))
+                    path = name;
+                if (l >> rest)
+                    throw runtime_error("column line " + to_string(k)
+                            + ": expected NAME PATH");
+                Column c;
+                c.name = name;
+                try {
+                    auto p = path::parse(path, translator);
+                    c.path = std::move(p.first);
+                    c.anywhere = p.second;
+                } catch (const std::range_error &e) {
+                    throw runtime_error("column line " + to_string(k)
+                            + ": " + e.what());
+                }
+                if (c.path.empty())
+                    throw runtime_error("column line " + to_string(k)
+                            + ": invalid path: " + path);
+                r.push_back(std::move(c));
+            }
+            if (r.empty())
+                throw runtime_error("no columns specified");
+            return r;
+        }
+        std::vector<Column> read_columns(const std::string &filename,
+                const Name_Translator &translator)
+        {
+            ifstream f(filename);
+            if (!f)
+                throw runtime_error("can't open columns file: " + filename);
+            return read_columns(f, translator);
+        }
+
+        using Proxy = traverser::Vertical_TLC_Reader_Proxy;
+        using Matcher = traverser::Basic_Matcher<Proxy, Vertical_TLC>;
+
+        static vector<Tag_Int> record_path(
+                const xml::Pretty_Writer_Arguments &args)
+        {
+            auto r = args.split_path;
+            r.push_back(0);
+            return r;
+        }
+
+        class Record_Matcher {
+            public:
+                Record_Matcher(const xml::Pretty_Writer_Arguments &args,
+                        const vector<Column> &columns);
+                void process(scratchpad::Simple_Reader<u8> &r,
+                        const std::function<void(const vector<TLC> &)> &f);
+            private:
+                // i.e. the height of the records
+                uint32_t height_ {0};
+                Matcher record_;
+                vector<Matcher> matchers_;
+                // the first match of each column in the current record,
+                // begin == nullptr if there is none
+                vector<TLC> values_;
+                // i.e. copies of the matched tags, since the reader
+                // may have moved on when the record is complete
+                vector<vector<u8>> buffers_;
+        };
+
+        Record_Matcher::Record_Matcher(
+                const xml::Pretty_Writer_Arguments &args,
+                const vector<Column> &columns)
+            :
+                height_(args.split_path.size()),
+                record_(record_path(args)),
+                values_(columns.size()),
+                buffers_(columns.size())
+        {
+            matchers_.reserve(columns.size());
+            for (auto &c : columns) {
+                if (c.anywhere) {
+                    matchers_.emplace_back(c.path, true);
+                } else {
+                    auto p = record_path(args);
+                    p.insert(p.end(), c.path.begin(), c.path.end());
+                    matchers_.emplace_back(p);
+                }
+            }
+        }
+
+        void Record_Matcher::process(scratchpad::Simple_Reader<u8> &r,
+                const std::function<void(const vector<TLC> &)> &f)
+        {
+            using namespace traverser;
+            Vertical_TLC t;
+            Proxy p(r, t);
+            bool inside = false;
+            auto flush = [this, &f]() {
+                f(values_);
+                for (auto &v : values_)
+                    v.begin = nullptr;
+            };
+            while (!p.eot(t)) {
+                if (inside && p.height(t) <= height_) {
+                    flush();
+                    inside = false;
+                }
+                if (t.is_eoc()) {
+                    p.advance(t);
+                    continue;
+                }
+                auto r = record_(p, t);
+                if (record_.result_ == Matcher_Result::INIT)
+                    inside = true;
+                bool descend = false;
+                for (size_t i = 0; i < matchers_.size(); ++i) {
+                    auto &m = matchers_[i];
+                    auto x = m(p, t);
+                    descend = descend || x == Hint::DESCEND;
+                    if (inside && m.result_ == Matcher_Result::INIT
+                            && t.shape == Shape::PRIMITIVE
+                            && !values_[i].begin) {
+                        buffers_[i].assign(t.begin,
+                                t.begin + t.tl_size + t.length);
+                        values_[i] = t;
+                        values_[i].begin = buffers_[i].data();
+                    }
+                }
+                // i.e. the matchers are also fed outside of the records
+                // since anchored paths start at the root
+                if (inside && !descend)
+                    r = Hint::SKIP_CHILDREN;
+                if (r == Hint::SKIP_CHILDREN)
+                    p.skip_children(t);
+                else
+                    p.advance(t);
+            }
+            if (inside)
+                flush();
+        }
+
+        void for_each_record(scratchpad::Simple_Reader<u8> &r,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns,
+                const std::function<void(const std::vector<TLC> &)> &f)
+        {
+            // i.e. skipping beyond the end just leaves no records
+            for (size_t k = args.skip;
+                    k && r.next(std::min(k, size_t(1024 * 1024))); ) {
+                size_t n = std::min(k,
+                        size_t(r.window().second - r.window().first));
+                r.forget(n);
+                k -= n;
+            }
+            Record_Matcher m(args, columns);
+            m.process(r, f);
+        }
+        void for_each_record(const u8 *begin, const u8 *end,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns,
+                const std::function<void(const std::vector<TLC> &)> &f)
+        {
+            auto r = scratchpad::mk_simple_reader(begin, end);
+            for_each_record(r, args, columns, f);
+        }
+
+        class Ber2Csv {
+            public:
+                Ber2Csv(scratchpad::Simple_Writer<char> &w,
+                        const xml::Pretty_Writer_Arguments &args,
+                        const vector<Column> &columns, char delimiter);
+                void write_header();
+                void write_row(const vector<TLC> &values);
+            private:
+                void write_field(const u8 *begin, const u8 *end);
+                void write_value(const TLC &t);
+
+                scratchpad::Simple_Writer<char> &w_;
+                byte::writer::Base o_;
+                const xml::Pretty_Writer_Arguments &args_;
+                const vector<Column> &columns_;
+                char delimiter_;
+        };
+
+        Ber2Csv::Ber2Csv(scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const vector<Column> &columns, char delimiter)
+            :
+                w_(w),
+                o_(w_),
+                args_(args),
+                columns_(columns),
+                delimiter_(delimiter)
+        {
+        }
+
+        // i.e. quote the field if necessary, cf. RFC 4180
+        void Ber2Csv::write_field(const u8 *begin, const u8 *end)
+        {
+            // i.e. TSV isn't quoted and tabs/newlines are escaped anyways
+            bool quote = delimiter_ != '\t' && std::any_of(begin, end,
+                    [this](u8 c) {
+                        return char(c) == '"' || char(c) == delimiter_; });
+            if (quote)
+                o_ << '"';
+            for (const u8 *p = begin; ; ) {
+                const u8 *q = quote ?
+                    std::find(p, end, u8('"')) : end;
+                // single pass, i.e. reserve for the worst case
+                size_t n = hex::max_decoded_size<hex::Style::C>(q - p);
+                auto x = w_.begin_write(n);
+                auto e = hex::decode<hex::Style::C>(p, q, x);
+                w_.commit_write(e - x);
+                if (q == end)
+                    break;
+                o_ << "\"\"";
+                p = q + 1;
+            }
+            if (quote)
+                o_ << '"';
+        }
+
+        void Ber2Csv::write_value(const TLC &t)
+        {
+            const u8 *b = t.begin + t.tl_size;
+            Type type = Type::STRING;
+            if (!args_.translator.empty())
+                type = args_.typifier.typify(
+                        args_.dereferencer.dereference(t.klasse, t.tag));
+            switch (type) {
+                case Type::INT_64: {
+                    if (!t.length)
+                        break;
+                    int64_t v {0};
+                    xfsx::decode(b, t.length, v);
+                    o_ << v;
+                    } break;
+                case Type::BCD: {
+                    size_t n = t.length*2;
+                    if (n) {
+                        auto x = w_.begin_write(n);
+                        bcd::decode(b, b + t.length, x);
+                        if (x[n-1] == 'f')
+                            --n;
+                        w_.commit_write(n);
+                    }
+                    } break;
+                case Type::STRING:
+                case Type::OCTET_STRING:
+                    write_field(b, b + t.length);
+                    break;
+            }
+        }
+
+        void Ber2Csv::write_header()
+        {
+            for (size_t i = 0; i < columns_.size(); ++i) {
+                if (i)
+                    o_ << delimiter_;
+                auto &s = columns_[i].name;
+                auto b = reinterpret_cast<const u8*>(s.data());
+                write_field(b, b + s.size());
+            }
+            o_ << '\n';
+        }
+
+        void Ber2Csv::write_row(const vector<TLC> &values)
+        {
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (i)
+                    o_ << delimiter_;
+                if (values[i].begin)
+                    write_value(values[i]);
+            }
+            o_ << '\n';
+        }
+
+        void write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns, char delimiter)
+        {
+            Ber2Csv b2c(w, args, columns, delimiter);
+            b2c.write_header();
+            for_each_record(r, args, columns,
+                    [&b2c](const vector<TLC> &values) {
+                        b2c.write_row(values); });
+            w.flush();
+        }
+        void write(const u8 *begin, const u8 *end,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns, char delimiter)
+        {
+            auto r = scratchpad::mk_simple_reader(begin, end);
+            write(r, w, args, columns, delimiter);
+        }
+
+    } // csv
+
+} // xfsx
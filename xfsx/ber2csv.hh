@@ -0,0 +1,87 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_BER2CSV_HH
+#define XFSX_BER2CSV_HH
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <xfsx/xml_writer_arguments.hh>
+
+namespace xfsx {
+    namespace scratchpad {
+        template<typename Char> class Simple_Reader;
+        template<typename Char> class Simple_Writer;
+    }
+
+    namespace csv {
+
+        struct Column {
+            std::string name;
+            std::vector<Tag_Int> path;
+            // i.e. the path may match anywhere inside of a record
+            bool anywhere {false};
+        };
+
+        // Reads a column specification, one column per line:
+        //
+        //     NAME PATH
+        //
+        // where PATH is relative to a record, e.g.
+        //
+        //     imsi   /BasicCallInformation/ChargeableSubscriber/SimChargeableSubscriber/Imsi
+        //     start  /BasicCallInformation/CallEventStartTimeStamp/LocalTimeStamp
+        //     dur    TotalCallEventDuration
+        //
+        // As with the --search option, a PATH without a leading / matches
+        // anywhere (inside of a record) and * matches any tag. A line that
+        // only contains a PATH uses it as NAME, as well. Empty lines
+        // and lines starting with # are ignored.
+        std::vector<Column> read_columns(std::istream &in,
+                const Name_Translator &translator);
+        std::vector<Column> read_columns(const std::string &filename,
+                const Name_Translator &translator);
+
+        // Calls f once per child of the constructed tag identified by
+        // args.split_path (i.e. once per CDR of a TAP
+        // CallEventDetailList), where values[i] is the first primitive
+        // tag of the record that matches columns[i] (values[i].begin is
+        // nullptr if there is none). With an empty split_path each
+        // top-level tag is a record.
+        //
+        // Only the subtrees that may contain a column are visited.
+        //
+        // The values stay valid until f returns, i.e. the reader may be
+        // a windowed one (e.g. scratchpad::mk_simple_reader_mapped()).
+        void for_each_record(scratchpad::Simple_Reader<u8> &r,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns,
+                const std::function<void(const std::vector<TLC> &)> &f);
+        void for_each_record(const u8 *begin, const u8 *end,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns,
+                const std::function<void(const std::vector<TLC> &)> &f);
+
+        // Writes a header line and one line per record (cf.
+        // for_each_record()). Values are typed via args.dereferencer/
+        // args.typifier like in the XML output, non-printable
+        // characters are escaped C-style (e.g. \x0a). Fields that
+        // contain the delimiter or a " are quoted as described in RFC
+        // 4180.
+        void write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns, char delimiter = ',');
+        void write(const u8 *begin, const u8 *end,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<Column> &columns, char delimiter = ',');
+
+    } // csv
+
+} // xfsx
+
+#endif // XFSX_BER2CSV_HH
@@ -0,0 +1,428 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "ber2json.hh"
+
+#include "xfsx.hh"
+#include "byte.hh"
+#include "bcd.hh"
+#include "hex.hh"
+#include "scratchpad.hh"
+#include "string.hh"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace xfsx {
+
+    namespace json {
+
+        // Returns the end of the complete unit that starts at p or nullptr
+        // if [p, end) doesn't contain all of it, yet.
+        static const u8 *unit_end(const u8 *p, const u8 *end)
+        {
+            size_t depth = 0;
+            do {
+                Unit u;
+                // a TL is at most 15 bytes long
+                if (end - p < 16) {
+                    try {
+                        u.load(p, end);
+                    } catch (const std::exception &) {
+                        return nullptr;
+                    }
+                } else {
+                    u.load(p, end);
+                }
+                if (u.is_eoc()) {
+                    if (!depth)
+                        throw Unexpected_EOC();
+                    --depth;
+                    p += u.tl_size;
+                } else if (u.is_indefinite) {
+                    ++depth;
+                    p += u.tl_size;
+                } else {
+                    if (size_t(end - p) - u.tl_size < u.length)
+                        return nullptr;
+                    p += u.tl_size + u.length;
+                }
+            } while (depth);
+            return p;
+        }
+
+        // Reads until the unit at the start of the window is complete,
+        // returns its size.
+        static size_t fetch_unit(scratchpad::Simple_Reader<u8> &r)
+        {
+            size_t want = 64;
+            for (;;) {
+                r.next(want);
+                auto &p = r.window();
+                auto e = unit_end(p.first, p.second);
+                if (e)
+                    return e - p.first;
+                if (size_t(p.second - p.first) < want)
+                    throw range_error("input ends inside of a tag");
+                want *= 2;
+            }
+        }
+
+        class Ber2Json {
+            public:
+                Ber2Json(scratchpad::Simple_Writer<char> &w,
+                        const xml::Pretty_Writer_Arguments &args);
+                void process(scratchpad::Simple_Reader<u8> &r);
+            private:
+                struct Level {
+                    Unit u;
+                    size_t left {0};
+                    // i.e. nothing was written for it, yet
+                    bool empty {true};
+                };
+                struct Member {
+                    Klasse klasse;
+                    Tag_Int tag;
+                    string value;
+                };
+
+                void write_key(byte::writer::Base &o, Klasse klasse,
+                        Tag_Int tag);
+                void write_value(byte::writer::Base &o,
+                        const u8 *begin, const u8 *end);
+                void write_primitive(byte::writer::Base &o, const TLC &t);
+                void write_members(byte::writer::Base &o,
+                        const u8 *begin, const u8 *end);
+                void write_line(const u8 *begin, const u8 *end);
+
+                void consume(size_t n);
+                void pop_complete();
+                void push_level(const Unit &u);
+                void pop_level();
+                bool is_on_path(const Unit &u) const;
+                void add_member(const u8 *begin, const u8 *end);
+                void close_section();
+
+                scratchpad::Simple_Writer<char> &w_;
+                byte::writer::Base o_;
+                const xml::Pretty_Writer_Arguments &args_;
+
+                // the streamed constructed tags on the split_path
+                vector<Level> levels_;
+
+                // siblings of the current level that are written
+                // as one line, e.g. the TAP header
+                vector<Member> section_;
+                scratchpad::Simple_Writer<char> section_w_;
+                byte::writer::Base section_o_;
+
+                BCD_String bcd_str_;
+        };
+
+        Ber2Json::Ber2Json(scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args)
+            :
+                w_(w),
+                o_(w_),
+                args_(args),
+                section_w_(scratchpad::mk_simple_writer<char>()),
+                section_o_(section_w_)
+        {
+        }
+
+        void Ber2Json::write_key(byte::writer::Base &o, Klasse klasse,
+                Tag_Int tag)
+        {
+            const string *s = args_.translator.empty() ?
+                nullptr : args_.translator.find(klasse, tag);
+            if (s)
+                o << '"' << *s << "\":";
+            else
+                o << '"' << klasse_to_cstr(klasse) << '_' << tag << "\":";
+        }
+
+        void Ber2Json::write_primitive(byte::writer::Base &o, const TLC &t)
+        {
+            const u8 *b = t.begin + t.tl_size;
+            Type type = Type::STRING;
+            if (!args_.translator.empty())
+                type = args_.typifier.typify(
+                        args_.dereferencer.dereference(t.klasse, t.tag));
+            switch (type) {
+                case Type::INT_64: {
+                    if (!t.length) {
+                        o << "null";
+                        break;
+                    }
+                    int64_t v {0};
+                    xfsx::decode(b, t.length, v);
+                    o << v;
+                    } break;
+                case Type::BCD:
+                    xfsx::decode(b, t.length, bcd_str_);
+                    o << '"';
+                    o.w.write(bcd_str_.get().data(),
+                            bcd_str_.get().data() + bcd_str_.get().size());
+                    o << '"';
+                    break;
+                case Type::STRING:
+                case Type::OCTET_STRING: {
+                    o << '"';
+                    // single pass, i.e. reserve for the worst case
+                    size_t n = hex::max_decoded_size<hex::Style::JSON>(
+                            t.length);
+                    auto x = o.w.begin_write(n);
+                    auto e = hex::decode<hex::Style::JSON>(b, b + t.length,
+                            x);
+                    o.w.commit_write(e - x);
+                    o << '"';
+                    } break;
+            }
+        }
+
+        void Ber2Json::write_value(byte::writer::Base &o,
+                const u8 *begin, const u8 *end)
+        {
+            TLC t;
+            t.load(begin, end);
+            if (t.shape == Shape::PRIMITIVE) {
+                write_primitive(o, t);
+            } else {
+                // i.e. without the EOC of an indefinite tag
+                const u8 *e = t.is_indefinite ? end - 2
+                    : begin + t.tl_size + t.length;
+                write_members(o, begin + t.tl_size, e);
+            }
+        }
+
+        void Ber2Json::write_members(byte::writer::Base &o,
+                const u8 *begin, const u8 *end)
+        {
+            o << '{';
+            bool first = true;
+            for (const u8 *p = begin; p < end; ) {
+                Unit u;
+                u.load(p, end);
+                const u8 *q = unit_end(p, end);
+                if (!q)
+                    throw range_error("child exceeds its parent");
+                // i.e. a run of children with the same tag
+                const u8 *x = q;
+                size_t k = 1;
+                while (x < end) {
+                    Unit v;
+                    v.load(x, end);
+                    if (v.tag != u.tag || v.klasse != u.klasse)
+                        break;
+                    x = unit_end(x, end);
+                    if (!x)
+                        throw range_error("child exceeds its parent");
+                    ++k;
+                }
+                if (!first)
+                    o << ',';
+                first = false;
+                write_key(o, u.klasse, u.tag);
+                if (k == 1) {
+                    write_value(o, p, q);
+                } else {
+                    o << '[';
+                    for (const u8 *y = p; y < x; ) {
+                        const u8 *z = unit_end(y, x);
+                        if (y != p)
+                            o << ',';
+                        write_value(o, y, z);
+                        y = z;
+                    }
+                    o << ']';
+                }
+                p = x;
+            }
+            o << '}';
+        }
+
+        void Ber2Json::write_line(const u8 *begin, const u8 *end)
+        {
+            for (auto &l : levels_)
+                l.empty = false;
+            Unit u;
+            u.load(begin, end);
+            o_ << '{';
+            write_key(o_, u.klasse, u.tag);
+            write_value(o_, begin, end);
+            o_ << "}\n";
+        }
+
+        void Ber2Json::add_member(const u8 *begin, const u8 *end)
+        {
+            Unit u;
+            u.load(begin, end);
+            write_value(section_o_, begin, end);
+            section_w_.flush();
+            auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
+                    section_w_.backend())->pad();
+            section_.push_back(Member{u.klasse, u.tag,
+                    string(pad.prelude(), pad.prelude() + section_w_.pos())});
+            section_w_.clear();
+        }
+
+        void Ber2Json::close_section()
+        {
+            if (section_.empty())
+                return;
+            for (auto &l : levels_) {
+                l.empty = false;
+                o_ << '{';
+                write_key(o_, l.u.klasse, l.u.tag);
+            }
+            o_ << '{';
+            for (size_t i = 0; i < section_.size(); ) {
+                auto &m = section_[i];
+                size_t j = i + 1;
+                while (j < section_.size() && section_[j].tag == m.tag
+                        && section_[j].klasse == m.klasse)
+                    ++j;
+                if (i)
+                    o_ << ',';
+                write_key(o_, m.klasse, m.tag);
+                if (j - i > 1)
+                    o_ << '[';
+                for (size_t k = i; k < j; ++k) {
+                    if (k != i)
+                        o_ << ',';
+                    o_ << section_[k].value;
+                }
+                if (j - i > 1)
+                    o_ << ']';
+                i = j;
+            }
+            o_ << '}';
+            for (size_t i = 0; i < levels_.size(); ++i)
+                o_ << '}';
+            o_ << '\n';
+            section_.clear();
+        }
+
+        bool Ber2Json::is_on_path(const Unit &u) const
+        {
+            auto &p = args_.split_path;
+            return levels_.size() < p.size()
+                && u.shape == Shape::CONSTRUCTED
+                && u.klasse == Klasse::APPLICATION
+                && u.tag == p[levels_.size()];
+        }
+
+        void Ber2Json::consume(size_t n)
+        {
+            for (auto &l : levels_) {
+                if (l.u.is_indefinite)
+                    continue;
+                if (n > l.left)
+                    throw range_error("child exceeds its parent");
+                l.left -= n;
+            }
+        }
+
+        // i.e. close all definite levels whose content was consumed
+        void Ber2Json::pop_complete()
+        {
+            while (!levels_.empty() && !levels_.back().u.is_indefinite
+                    && !levels_.back().left)
+                pop_level();
+        }
+
+        void Ber2Json::push_level(const Unit &u)
+        {
+            close_section();
+            Level l;
+            l.u = u;
+            l.left = u.length;
+            levels_.push_back(l);
+        }
+
+        void Ber2Json::pop_level()
+        {
+            close_section();
+            if (levels_.back().empty) {
+                for (auto &l : levels_) {
+                    l.empty = false;
+                    o_ << '{';
+                    write_key(o_, l.u.klasse, l.u.tag);
+                }
+                o_ << "{}";
+                for (size_t i = 0; i < levels_.size(); ++i)
+                    o_ << '}';
+                o_ << '\n';
+            }
+            levels_.pop_back();
+        }
+
+        void Ber2Json::process(scratchpad::Simple_Reader<u8> &r)
+        {
+            while (r.next(16)) {
+                auto &p = r.window();
+                Unit u;
+                u.load(p.first, p.second);
+                if (u.is_eoc()) {
+                    if (levels_.empty() || !levels_.back().u.is_indefinite)
+                        throw Unexpected_EOC();
+                    r.forget(u.tl_size);
+                    pop_level();
+                    consume(u.tl_size);
+                } else if (is_on_path(u)) {
+                    r.forget(u.tl_size);
+                    consume(u.tl_size);
+                    push_level(u);
+                } else {
+                    size_t n = fetch_unit(r);
+                    const u8 *b = r.window().first;
+                    if (levels_.empty()
+                            || levels_.size() == args_.split_path.size())
+                        write_line(b, b + n);
+                    else
+                        add_member(b, b + n);
+                    r.forget(n);
+                    consume(n);
+                }
+                pop_complete();
+            }
+            if (!levels_.empty())
+                throw range_error("some tags are still open");
+        }
+
+        void write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args)
+        {
+            if (args.skip) {
+                r.next(args.skip);
+                r.check_available(args.skip);
+                r.forget(args.skip);
+            }
+            Ber2Json b2j(w, args);
+            b2j.process(r);
+            w.flush();
+        }
+        void write(const u8 *begin, const u8 *end,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args)
+        {
+            auto r = scratchpad::mk_simple_reader(begin, end);
+            write(r, w, args);
+        }
+        void write(const u8 *begin, const u8 *end,
+                const std::string &filename,
+                const xml::Pretty_Writer_Arguments &args)
+        {
+            auto r = scratchpad::mk_simple_reader(begin, end);
+            auto w = scratchpad::mk_simple_writer<char>(filename);
+            write(r, w, args);
+        }
+
+    } // json
+
+} // xfsx
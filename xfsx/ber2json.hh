@@ -0,0 +1,50 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_BER2JSON_HH
+#define XFSX_BER2JSON_HH
+
+#include <string>
+
+#include <xfsx/xml_writer_arguments.hh>
+
+namespace xfsx {
+    namespace scratchpad {
+        template<typename Char> class Simple_Reader;
+        template<typename Char> class Simple_Writer;
+    }
+
+    namespace json {
+
+        // Writes newline delimited JSON (NDJSON), i.e. one JSON object
+        // per line:
+        //
+        // - one per child of the constructed tag identified by
+        //   args.split_path, e.g. one per CDR of a TAP
+        //   CallEventDetailList
+        // - one that contains the siblings before and one that contains
+        //   the siblings after such a record list (on each level),
+        //   e.g. the TAP header and trailer
+        // - one per top-level tag that isn't part of args.split_path
+        //
+        // Names are translated with args.translator and primitive
+        // values are typed via args.dereferencer/args.typifier, i.e.
+        // INT_64 values are written as numbers and everything else as
+        // string. Consecutive children with the same tag are written as
+        // array. Bytes outside of printable ASCII are escaped as
+        // \u00XX, i.e. they are interpreted as Latin-1.
+        void write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args);
+        void write(const u8 *begin, const u8 *end,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args);
+        void write(const u8 *begin, const u8 *end,
+                const std::string &filename,
+                const xml::Pretty_Writer_Arguments &args);
+
+    } // json
+
+} // xfsx
+
+#endif // XFSX_BER2JSON_HH
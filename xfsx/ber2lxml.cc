@@ -22,10 +22,13 @@
 
 #include <stack>
 #include <cassert>
+#include <new>
+#include <string>
+#include <vector>
 
 #include "xfsx.hh"
-#include "byte.hh"
 #include "hex.hh"
+#include "integer.hh"
 #include "string.hh"
 #include "scratchpad.hh"
 #include "tlc_reader.hh"
@@ -52,7 +55,10 @@ namespace xfsx {
           TLC tlc;
           xxxml::doc::Ptr doc_;
           xfsx::BCD_String bcd_;
-          scratchpad::Simple_Writer<char> memw_;
+          std::string hex_;
+          // element names interned in the document dictionary, indexed
+          // by klasse and tag (below dense_tag_limit)
+          std::vector<const xmlChar*> names_[4];
 
             // lengths of all all definite constructed tags
             stack<size_t> length_stack_;
@@ -60,6 +66,8 @@ namespace xfsx {
             // to detect when a tag is 'closed'
             stack<size_t> written_stack_;
 
+          const xmlChar *name();
+          xmlNode *new_node(const xmlChar *name);
           void gen_node();
           void gen_rank(xmlNode *node);
           void gen_hex(xmlNode *node);
@@ -80,15 +88,44 @@ namespace xfsx {
           const Pretty_Writer_Arguments &args)
         :
           args_(args),
-          doc_(std::move(doc)),
-          memw_(unique_ptr<scratchpad::Writer<char>>(
-                    new scratchpad::Scratchpad_Writer<char>()))
+          doc_(std::move(doc))
       {
         rank_stack_.push(0);
         length_stack_.push(0); // symmetric to catch-all
         written_stack_.push(0); // catch-all
       }
 
+      // i.e. each name is looked up in the dictionary only once, such that
+      // creating an element neither hashes nor copies its name
+      const xmlChar *Tree_Generator::name()
+      {
+        auto &v = names_[klasse_to_index(tlc.klasse)];
+        if (tlc.tag < v.size() && v[tlc.tag])
+          return v[tlc.tag];
+        const string &s = args_.translator.translate(tlc.klasse, tlc.tag);
+        const xmlChar *r = xmlDictLookup(doc_->dict,
+            reinterpret_cast<const xmlChar*>(s.data()), s.size());
+        if (!r)
+          throw bad_alloc();
+        if (tlc.tag < dense_tag_limit) {
+          if (tlc.tag >= v.size())
+            v.resize(tlc.tag + 1);
+          v[tlc.tag] = r;
+        }
+        return r;
+      }
+
+      xmlNode *Tree_Generator::new_node(const xmlChar *name)
+      {
+        // the name is owned by the dictionary, thus it isn't freed
+        // with the node
+        xmlNode *node = xmlNewDocNodeEatName(doc_.get(), nullptr,
+            const_cast<xmlChar*>(name), nullptr);
+        if (!node)
+          throw bad_alloc();
+        return node;
+      }
+
       void Tree_Generator::gen_node()
       {
         assert(!rank_stack_.empty());
@@ -104,13 +141,9 @@ namespace xfsx {
       {
         if (!args_.dump_rank)
           return;
-        memw_.clear();
-        byte::writer::Base w(memw_);
-        w << rank_stack_.top() << '\0';
-        memw_.flush();
-        const auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
-                memw_.backend())->pad();
-        xxxml::new_prop(node, "rank", pad.prelude());
+        char s[integer::max_dec_size + 1];
+        *integer::format_dec(uint64_t(rank_stack_.top()), s) = 0;
+        xxxml::new_prop(node, "rank", s);
       }
 
       void Tree_Generator::gen_indefinite(xmlNode *node)
@@ -124,22 +157,14 @@ namespace xfsx {
       {
         if (!args_.hex_dump)
           return;
-        memw_.clear();
-        byte::writer::Base w(memw_);
         size_t n = hex::decoded_size<hex::Style::Raw>(
             tlc.begin + tlc.tl_size, tlc.begin + tlc.tl_size + tlc.length
             );
-        auto o = memw_.begin_write(n);
-        auto r = hex::decode<hex::Style::Raw>(
+        hex_.resize(n);
+        hex::decode<hex::Style::Raw>(
             tlc.begin + tlc.tl_size, tlc.begin + tlc.tl_size + tlc.length,
-            o);
-        (void)r;
-        memw_.commit_write(n);
-        w << '\0';
-        memw_.flush();
-        const auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
-                memw_.backend())->pad();
-        xxxml::new_prop(node, "hex", pad.prelude());
+            &hex_[0]);
+        xxxml::new_prop(node, "hex", hex_.c_str());
       }
 
       void Tree_Generator::gen_primitive()
@@ -148,9 +173,8 @@ namespace xfsx {
           throw runtime_error("no parent available for primitive tag");
         auto kt = args_.dereferencer.dereference(tlc.klasse, tlc.tag);
         Type t = args_.typifier.typify(kt);
-        const string &name = args_.translator.translate(tlc.klasse, tlc.tag);
 
-        xmlNode *node = xxxml::new_doc_node(doc_, name);
+        xmlNode *node = new_node(name());
         xxxml::add_child(node_stack_.top(), node);
         gen_rank(node);
         gen_hex(node);
@@ -160,14 +184,9 @@ namespace xfsx {
             {
               int64_t v {0};
               xfsx::decode(tlc.begin + tlc.tl_size, tlc.length, v);
-              memw_.clear();
-              byte::writer::Base w(memw_);
-              w << v;
-              memw_.flush();
-                const auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
-                        memw_.backend())->pad();
-              xxxml::node_add_content(node,
-                  pad.prelude(), pad.begin()-pad.prelude());
+              char s[integer::max_dec_size];
+              auto e = integer::format_dec(v, s);
+              xxxml::node_add_content(node, s, e - s);
             }
             break;
           case Type::BCD:
@@ -188,17 +207,15 @@ namespace xfsx {
 
       void Tree_Generator::gen_constructed()
       {
-        const string &name = args_.translator.translate(tlc.klasse, tlc.tag);
-        xmlNode *node = nullptr;
+        xmlNode *node = new_node(name());
         if (node_stack_.empty()) {
-          node = xxxml::new_doc_node(doc_, name);
           auto t = xxxml::doc::set_root_element(doc_, node);
           if (t) {
               xmlFreeNode(t);
               throw runtime_error("multiple roots aren't supported with lxml");
           }
         } else {
-          node = xxxml::new_child(node_stack_.top(), name);
+          xxxml::add_child(node_stack_.top(), node);
         }
         gen_rank(node);
         gen_indefinite(node);
@@ -267,6 +284,15 @@ namespace xfsx {
         return g.generate(r);
       }
 
+      size_t rank(const xmlNode *node)
+      {
+        size_t r = 1;
+        for (auto n = node->prev; n; n = n->prev)
+          if (n->type == XML_ELEMENT_NODE)
+            ++r;
+        return r;
+      }
+
       xxxml::doc::Ptr generate_tree(
           const xfsx::u8 *begin,
           const xfsx::u8 *end,
@@ -42,6 +42,12 @@ namespace xfsx {
               const Pretty_Writer_Arguments &args);
       xxxml::doc::Ptr generate_tree(const u8 *begin, const u8 *end,
           const Pretty_Writer_Arguments &args);
+
+      // Returns the rank of an element of a generated tree, i.e. what
+      // its rank attribute contains with args.dump_rank, without
+      // requiring the attribute. Meant for reporting, since it is
+      // linear in the number of preceding siblings.
+      size_t rank(const xmlNode *node);
     }
   }
 }
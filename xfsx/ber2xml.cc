@@ -32,15 +32,29 @@
 #include "bcd.hh"
 
 #include <ixxx/ixxx.hh>
+#include <ixxx/util.hh>
 
 // XXX
 #include <iostream>
 
 #include <algorithm>
+#include <array>
 #include <string>
 #include <stack>
 #include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <memory>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <boost/algorithm/string.hpp>
 
@@ -225,8 +239,12 @@ static Tag_Matcher mk_tag_matcher(const std::string &path,
     const char *end = path.data() + path.size();
     for (;;) {
         x.second = std::find(x.first, end, '/');
-        auto r = nt.translate(x);
-        v.emplace_back(get<2>(r), get<1>(r));
+        if (x.second - x.first == 1 && *x.first == '*') {
+            v.emplace_back(0, Klasse::APPLICATION); // wild-card
+        } else {
+            auto r = nt.translate(x);
+            v.emplace_back(get<2>(r), get<1>(r));
+        }
         if (x.second == end)
             break;
         x.first = x.second+1;
@@ -294,31 +312,341 @@ void Tag_Matcher::pop()
     --pos_;
 }
 
+// Tracks which of the select paths may still match below the
+// open tags, i.e. whether a tag starts a selected subtree, may be an
+// ancestor of one or can be skipped.
+class Tag_Selector {
+    public:
+        enum Result {
+            NONE, // i.e. no path can match inside of it
+            PATH, // i.e. some path may match inside of it
+            ALL   // i.e. inside of a selected subtree
+        };
+        Tag_Selector();
+        Tag_Selector(
+                const std::vector<std::pair<std::vector<Tag_Int>, bool>>
+                    &paths);
+        bool empty() const { return paths_.empty(); }
+        // push constructed and primitive tags
+        // primitive tags are immediately popped
+        Result push(Tag_Int tag, Klasse klasse);
+        void pop();
+    private:
+        std::vector<std::pair<std::vector<Tag_Int>, bool>> paths_;
+        bool anywhere_ {false};
+        // (path, matched elements) for each open tag, where the states
+        // of the innermost one start at begin_.back()
+        std::vector<std::pair<uint32_t, uint32_t>> states_;
+        std::vector<size_t> begin_;
+        // depth inside of the selected subtree
+        size_t all_ {0};
+};
+Tag_Selector::Tag_Selector() =default;
+Tag_Selector::Tag_Selector(
+        const std::vector<std::pair<std::vector<Tag_Int>, bool>> &paths)
+    :
+        paths_(paths)
+{
+    begin_.push_back(0);
+    for (uint32_t i = 0; i < paths_.size(); ++i) {
+        if (paths_[i].first.empty())
+            throw range_error("select path is empty");
+        if (paths_[i].second)
+            anywhere_ = true;
+        else
+            states_.emplace_back(i, 0);
+    }
+}
+Tag_Selector::Result Tag_Selector::push(Tag_Int tag, Klasse klasse)
+{
+    if (all_) {
+        ++all_;
+        return ALL;
+    }
+    size_t b = begin_.back();
+    size_t e = states_.size();
+    bool done = false;
+    auto step = [this, tag, klasse, &done](uint32_t i, uint32_t k) {
+        auto &p = paths_[i].first;
+        if ((p[k] && p[k] != tag) // i.e. 0 is the * wild-card
+                || klasse != Klasse::APPLICATION)
+            return;
+        if (k + 1 == p.size())
+            done = true;
+        else
+            states_.emplace_back(i, k + 1);
+    };
+    for (size_t j = b; j < e; ++j)
+        step(states_[j].first, states_[j].second);
+    for (uint32_t i = 0; i < paths_.size(); ++i)
+        if (paths_[i].second)
+            step(i, 0);
+    if (done) {
+        states_.resize(e);
+        all_ = 1;
+        return ALL;
+    }
+    begin_.push_back(e);
+    return states_.size() > e || anywhere_ ? PATH : NONE;
+}
+void Tag_Selector::pop()
+{
+    if (all_) {
+        --all_;
+        return;
+    }
+    assert(begin_.size() > 1);
+    states_.resize(begin_.back());
+    begin_.pop_back();
+}
+
+
+#ifdef XFSX_USE_LUA
+// Collects the values of a CDR (or of an xpath_callback match) such
+// that they can be passed to Lua with a single call:
+//
+//     fn(n, tags, offs, lens, buf)
+//
+// where value i (1 <= i <= n) with tag tags[i] is
+// buf:sub(offs[i], offs[i] + lens[i] - 1). Integers are passed
+// in decimal notation. The tables are reused between calls, i.e.
+// entries after n are stale.
+class Lua_Batch {
+    public:
+        Lua_Batch(sol::state &lua)
+            :
+                t_tags_(lua.create_table(64, 0)),
+                t_offs_(lua.create_table(64, 0)),
+                t_lens_(lua.create_table(64, 0))
+        {
+            tags_.reserve(64);
+            offs_.reserve(64);
+            lens_.reserve(64);
+            buf_.reserve(4096);
+        }
+        void clear()
+        {
+            tags_.clear();
+            offs_.clear();
+            lens_.clear();
+            buf_.clear();
+        }
+        bool empty() const { return tags_.empty(); }
+        void push(Tag_Int tag, const char *begin, const char *end)
+        {
+            tags_.push_back(tag);
+            offs_.push_back(buf_.size() + 1);
+            lens_.push_back(end - begin);
+            buf_.append(begin, end);
+        }
+        void push(Tag_Int tag, int64_t v)
+        {
+            char a[24];
+            size_t n = byte::writer::encoded_length(v);
+            byte::writer::encode(v, a, n);
+            push(tag, a, a + n);
+        }
+        sol::function_result call(const sol::function &fn)
+        {
+            size_t n = tags_.size();
+            for (size_t i = 0; i < n; ++i) {
+                t_tags_[i+1] = tags_[i];
+                t_offs_[i+1] = offs_[i];
+                t_lens_[i+1] = lens_[i];
+            }
+            return fn(n, t_tags_, t_offs_, t_lens_,
+                    sol::string_view(buf_.data(), buf_.size()));
+        }
+    private:
+        vector<Tag_Int> tags_;
+        vector<size_t> offs_;
+        vector<size_t> lens_;
+        string buf_;
+        sol::table t_tags_;
+        sol::table t_offs_;
+        sol::table t_lens_;
+};
+#endif // XFSX_USE_LUA
+
+// The rendered start/end tags of all translated tags (including
+// the attributes that only depend on the tag), such that emitting
+// a named tag is a single copy from one arena.
+class Tag_Markup {
+    public:
+        enum Part {
+            PRIMITIVE_OPEN,   // <Name>
+            OPEN,             // <Name>\n
+            INDEFINITE_OPEN,  // <Name definite='false'>\n
+            EMPTY,            // <Name/>\n
+            CLOSE,            // </Name>\n
+            INDEFINITE_CLOSE, // </Name> <!-- indefinite -->\n
+            PARTS
+        };
+        struct Entry {
+            // i.e. part p is [off[p], off[p+1]) of the arena
+            uint32_t off[PARTS + 1];
+        };
+
+        Tag_Markup(const xml::Pretty_Writer_Arguments &args);
+
+        // nullptr if the tag isn't translated
+        const Entry *find(Klasse klasse, Tag_Int tag) const;
+        std::pair<const char*, const char*> part(const Entry &e,
+                Part p) const
+        {
+            return std::make_pair(arena_.data() + e.off[p],
+                    arena_.data() + e.off[p+1]);
+        }
+        size_t size(const Entry &e, Part p) const
+        {
+            return e.off[p+1] - e.off[p];
+        }
+    private:
+        std::string arena_;
+        std::array<std::unordered_map<Tag_Int, Entry>, 4> entries_;
+};
+Tag_Markup::Tag_Markup(const xml::Pretty_Writer_Arguments &args)
+{
+    args.translator.for_each([this, &args](Klasse klasse, Tag_Int tag,
+                const string &name) {
+        string attrs;
+        if (args.dump_tag)
+            attrs += " tag='" + std::to_string(tag) + '\'';
+        if (args.dump_class)
+            attrs += " class='" + string(klasse_to_cstr(klasse)) + '\'';
+        Entry e;
+        size_t i = 0;
+        auto mark = [this, &e, &i]() {
+            e.off[i++] = uint32_t(arena_.size()); };
+        mark(); arena_ += '<' + name + attrs + '>';
+        mark(); arena_ += '<' + name + attrs + ">\n";
+        mark(); arena_ += '<' + name + " definite='false'" + attrs + ">\n";
+        mark(); arena_ += '<' + name + attrs + "/>\n";
+        mark(); arena_ += "</" + name + ">\n";
+        mark(); arena_ += "</" + name + "> <!-- indefinite -->\n";
+        mark();
+        entries_[klasse_to_index(klasse)].emplace(tag, e);
+    });
+}
+const Tag_Markup::Entry *Tag_Markup::find(Klasse klasse, Tag_Int tag) const
+{
+    auto &m = entries_[klasse_to_index(klasse)];
+    if (m.empty())
+        return nullptr;
+    auto i = m.find(tag);
+    if (i == m.end())
+        return nullptr;
+    return &i->second;
+}
 
 class Ber2Xml {
     public:
         Ber2Xml(scratchpad::Simple_Writer<char> &w,
                 const xml::Pretty_Writer_Arguments &args);
+        // for formatting a chunk of children that starts at indent_level,
+        // sharing the markup of the parent
+        Ber2Xml(scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                size_t indent_level,
+                std::shared_ptr<const Tag_Markup> markup);
         //void process(Simple_Reader<TLC> &r);
         void process(scratchpad::Simple_Reader<u8> &r);
         void process_blocks(scratchpad::Simple_Reader<u8> &r);
+        // continue with the state saved in c
+        void resume(const xml::Checkpoint &c);
 
         size_t open_tags();
+
+        // i.e. the output size only depends on the input and the
+        // arguments, and not on pretty-printers, searches etc.
+        bool measurable() const;
+        // Returns the exact size of the XML that process() writes for
+        // the complete tags read from r, without writing anything.
+        // Since some values are formatted into a reserved maximum, the
+        // writer needs reserve more bytes of room at the end of that
+        // output. The children of split_path tags are measured with
+        // args.threads threads and their regions are added to layout.
+        size_t measure(scratchpad::Simple_Reader<u8> &r, size_t &reserve,
+                xml::Layout *layout = nullptr) const;
+        // i.e. process() writes the children of split_path tags into
+        // the regions that measure() stored in layout
+        void set_layout(const xml::Layout &layout);
     private:
-        void print_primitive(const TLC &tlc, const string *s);
-        void print_constructed(const TLC &tlc, const string *s);
-        void pop_constructed(bool is_indefinite);
-        void print_attributes(const TLC &tlc, const string *s);
+        // The common flag combinations, i.e. the formatting functions
+        // are instantiated for each, such that the NAMED/PRETTY
+        // variants don't test the flags for each tag.
+        enum class Mode {
+            GENERIC, // e.g. dumping attributes, untranslated tags,
+                     // searching, selecting, counting
+            NAMED,   // only translated tags and their values
+            PRETTY   // like NAMED, plus pretty-printed values
+        };
+        Mode mode_ {Mode::GENERIC};
+        Mode select_mode() const;
+        // i.e. constant unless M is GENERIC
+        template <Mode M> bool var_attributes() const
+        {
+            return M == Mode::GENERIC && var_attributes_;
+        }
+        template <Mode M> bool pretty() const
+        {
+            return M == Mode::PRETTY
+                || (M == Mode::GENERIC && args_.pretty_print);
+        }
+        template <Mode M> bool translated() const
+        {
+            return M != Mode::GENERIC || !args_.translator.empty();
+        }
+        template <Mode M> bool filtered() const
+        {
+            return M == Mode::GENERIC && filtered_;
+        }
+        // i.e. the searcher or pretty-printing callbacks track the path
+        template <Mode M> bool matching() const
+        {
+            return M != Mode::NAMED;
+        }
+
+        template <Mode M> void process_units(
+                scratchpad::Simple_Reader<u8> &r);
+        template <Mode M> void print_primitive(const TLC &tlc,
+                const Tag_Markup::Entry *m);
+        template <Mode M> void print_constructed(const TLC &tlc,
+                const Tag_Markup::Entry *m);
+        template <Mode M> void pop_constructed(bool is_indefinite);
+        void print_attributes(const TLC &tlc);
+        void print_variable_attributes(const TLC &tlc);
+        template <Mode M> void print_start(const Tag_Markup::Entry &m,
+                Tag_Markup::Part part, size_t suffix, const TLC &tlc);
+        void print_indented(const char *begin, const char *end);
         void indent(size_t k);
+        size_t measure_attributes(const TLC &tlc, size_t off) const;
+        size_t measure_variable_attributes(const TLC &tlc, size_t off) const;
+        size_t measure_content(const TLC &tlc, size_t &reserve) const;
+        size_t measure(scratchpad::Simple_Reader<u8> &r, size_t level,
+                bool split, size_t &reserve, xml::Layout *layout) const;
+        bool splits_here(const TLC &tlc) const;
+        bool split_bounds(const u8 *begin, const u8 *end,
+                vector<const u8*> &bounds) const;
+        bool measure_split(const u8 *begin, const u8 *end, size_t pos,
+                size_t level, xml::Layout::Split &s) const;
+        bool process_split(const u8 *begin, const u8 *end, size_t pos);
+        void save_checkpoint();
 
         scratchpad::Simple_Writer<char> &w_;
         byte::writer::Base o_;
         const xml::Pretty_Writer_Arguments &args_;
 
 
+        std::shared_ptr<const Tag_Markup> markup_;
+        // i.e. tl/t/length/off/hex attributes are enabled
+        bool var_attributes_ {false};
+        // i.e. searching, selecting or stopping early
+        bool filtered_ {false};
+
         deque<Unit> cons_stack_;
         size_t cons_stack_top_{0};
-        deque<const std::string*> cons_str_stack_;
+        deque<const Tag_Markup::Entry*> cons_markup_stack_;
         // lengths of all all definite constructed tags
         stack<size_t> length_stack_;
         // counts against the same position in the length_stack_
@@ -331,16 +659,42 @@ class Ber2Xml {
         size_t match_cnt_ {0};
         size_t search_ranges_pos_ {0};
 
+        Tag_Selector selector_;
+        // i.e. the start tags of the outermost shown_ open tags are
+        // written, the others are written when something is selected
+        // inside of them
+        size_t shown_ {0};
+        // offsets of the open tags
+        vector<size_t> select_offs_;
+        void print_selected_ancestors();
+
+        bool split_ {false};
+        const xml::Layout *layout_ {nullptr};
+        // i.e. the next split of layout_
+        size_t layout_pos_ {0};
+
+        bool checkpoint_ {false};
+        // input offset of the last checkpoint
+        size_t checkpoint_pos_ {0};
+        // i.e. w_ appends to an output of that size when resuming
+        size_t out_base_ {0};
+
+        scratchpad::Simple_Writer<char> pp_w_;
+        byte::writer::Base pp_o_;
+        std::string pp_bcd_;
 
         bool searcher_matches();
         void push_matcher(const TLC &tlc);
         void pop_matcher();
         void pretty_print(const TLC &tlc, Type type);
+        bool print_native(const TLC &tlc, Type type);
         void update_matcher(const TLC &tlc, int64_t v);
         void update_matcher(const TLC &tlc, const char *begin, const char *end);
 #ifdef XFSX_USE_LUA
         void setup_lua();
         void setup_lua_functions();
+        void start_pp_batch(const u8 *begin, const u8 *end, size_t pos);
+        bool print_pp_batch(const TLC &tlc, Type type);
 
         sol::state lua_;
         unordered_map<Tag_Int, sol::function> pp_fn_map_;
@@ -352,6 +706,21 @@ class Ber2Xml {
         // 3 -> done
         vector<uint8_t> matcher_state_;
         bool matcher_done_ {false};
+        // xpath callbacks with a batch function instead of push/store
+        vector<sol::function> matcher_batch_fn_;
+        vector<Lua_Batch> matcher_batch_;
+
+        // optional pp_batch: tag_callback values of each CDR
+        // are pretty-printed with a single call
+        sol::function pp_batch_fn_;
+        Tag_Matcher pp_batch_matcher_;
+        unique_ptr<Lua_Batch> pp_batch_;
+        bool pp_batch_active_ {false};
+        size_t pp_batch_level_ {0};
+        size_t pp_batch_idx_ {0};
+        vector<size_t> pp_batch_pos_;
+        vector<string> pp_batch_str_;
+        vector<uint8_t> pp_batch_has_;
         // reuse those helper buffer,
         // avoiding superfluous allocations/constructions
         bool pretty_printed_{false};
@@ -366,24 +735,73 @@ size_t Ber2Xml::open_tags()
 }
 
 Ber2Xml::Ber2Xml(scratchpad::Simple_Writer<char> &w,
-        const xml::Pretty_Writer_Arguments &args)
+        const xml::Pretty_Writer_Arguments &args,
+        size_t indent_level,
+        std::shared_ptr<const Tag_Markup> markup)
     :
         w_(w),
         o_(w_),
         args_(args),
-        searcher_(args_.search_path)
+        markup_(std::move(markup)),
+        var_attributes_(args_.dump_tl || args_.dump_t || args_.dump_length
+                || args_.dump_offset || args_.hex_dump),
+        indent_level_(indent_level),
+        searcher_(args_.search_path),
+        selector_(args_.select_paths),
+        pp_w_(scratchpad::mk_simple_writer<char>()),
+        pp_o_(pp_w_)
 {
     length_stack_.push(0); // symmetric to catch-all
     written_stack_.push(0); // catch-all
 
     if (args_.search_everywhere)
         searcher_.set_start_anywhere(true);
+    filtered_ = !searcher_.empty() || !selector_.empty()
+        || !args_.search_ranges.empty()
+        || args_.count || args_.stop_after_first;
+    mode_ = select_mode();
 
 #ifdef XFSX_USE_LUA
-    if (args.pretty_print)
+    if (args.pretty_print && !args.pp_filename.empty())
         setup_lua();
 #endif // XFSX_USE_LUA
 }
+Ber2Xml::Mode Ber2Xml::select_mode() const
+{
+    // i.e. tag/class attributes are part of the rendered markup
+    if (args_.translator.empty() || var_attributes_ || filtered_)
+        return Mode::GENERIC;
+    return args_.pretty_print ? Mode::PRETTY : Mode::NAMED;
+}
+Ber2Xml::Ber2Xml(scratchpad::Simple_Writer<char> &w,
+        const xml::Pretty_Writer_Arguments &args)
+    :
+        Ber2Xml(w, args, 0, std::make_shared<const Tag_Markup>(args))
+{
+    // i.e. only when the children are independent of everything
+    // that was formatted before them
+    split_ = args_.threads > 1 && !args_.split_path.empty()
+        && searcher_.empty() && selector_.empty()
+        && !args_.count && !args_.block_size
+        && !args_.skip_zero && !args_.stop_after_first;
+#ifdef XFSX_USE_LUA
+    // xpath callbacks may store state across CDRs
+    if (!matcher_.empty())
+        split_ = false;
+#endif // XFSX_USE_LUA
+
+    checkpoint_ = !args_.checkpoint_filename.empty();
+    // i.e. their state isn't part of a checkpoint
+    if (checkpoint_ && (!searcher_.empty() || !selector_.empty()
+                || args_.count || args_.block_size || args_.skip_zero
+                || args_.stop_after_first))
+        throw range_error("checkpoints aren't supported when searching,"
+                " selecting, counting or reading blocks");
+#ifdef XFSX_USE_LUA
+    if (checkpoint_ && !matcher_.empty())
+        throw range_error("checkpoints aren't supported with xpath callbacks");
+#endif // XFSX_USE_LUA
+}
 
 #ifdef XFSX_USE_LUA
 
@@ -440,14 +858,109 @@ void Ber2Xml::setup_lua_functions()
       matcher_.reserve(10);
       sol::table ps = lua_["xpath_callback"];
       for (auto &p : ps) {
+        sol::table t = p.second.as<sol::table>();
         matcher_.emplace_back(
-                mk_tag_matcher(p.second.as<sol::table>()["path"].get<string>(),
+                mk_tag_matcher(t["path"].get<string>(),
                     args_.name_translator),
                 make_pair(
-                    p.second.as<sol::table>()["push"].get<sol::function>(),
-                    p.second.as<sol::table>()["store"].get<sol::function>()));
+                    t["push"].get<sol::function>(),
+                    t["store"].get<sol::function>()));
+        // i.e. batch(n, tags, offs, lens, buf) is called once
+        // after each match instead of push() for each value
+        sol::function batch = t["batch"].get<sol::function>();
+        matcher_batch_fn_.push_back(batch);
+        matcher_batch_.emplace_back(lua_);
       }
       matcher_state_.resize(matcher_.size());
+
+      // pp_batch = { path = 'TransferBatch/CallEventDetailList/*',
+      //              fn = function(n, tags, offs, lens, buf) ... end }
+      //
+      // fn is called once per matching element with all values
+      // that have a tag_callback and returns a table that maps
+      // each index to the pp string (or nil).
+      sol::optional<sol::table> b = lua_["pp_batch"];
+      if (b && !args_.translator.empty() && searcher_.empty()
+              && !args_.count && !args_.block_size) {
+        pp_batch_matcher_ = mk_tag_matcher((*b)["path"].get<string>(),
+                args_.name_translator);
+        pp_batch_fn_ = (*b)["fn"].get<sol::function>();
+        pp_batch_.reset(new Lua_Batch(lua_));
+      }
+}
+// Collects the values in [begin, end) in the same order as process()
+// visits them, calls the pp_batch function and stores its results
+// for print_pp_batch().
+void Ber2Xml::start_pp_batch(const u8 *begin, const u8 *end, size_t pos)
+{
+    auto &b = *pp_batch_;
+    b.clear();
+    pp_batch_pos_.clear();
+    for (const u8 *p = begin; p < end; ) {
+        TLC t;
+        t.load(p, end);
+        if (t.shape == Shape::CONSTRUCTED) {
+            p += t.tl_size;
+            continue;
+        }
+        if (size_t(end - p) - t.tl_size < t.length)
+            break; // the regular parse reports this
+        if (t.length && pp_fn_map_.count(t.tag)) {
+            auto kt = args_.dereferencer.dereference(t.klasse, t.tag);
+            switch (args_.typifier.typify(kt)) {
+                case Type::INT_64:
+                    b.push(t.tag, t.lexical_cast<int64_t>());
+                    break;
+                case Type::BCD:
+                    t.copy_content(bcd_str_);
+                    b.push(t.tag, bcd_str_.get().data(),
+                            bcd_str_.get().data() + bcd_str_.get().size());
+                    break;
+                case Type::STRING:
+                case Type::OCTET_STRING:
+                    t.copy_content(hex_str_);
+                    b.push(t.tag, hex_str_.get().data(),
+                            hex_str_.get().data() + hex_str_.get().size());
+                    break;
+            }
+            pp_batch_pos_.push_back(pos + (p - begin));
+        }
+        p += t.tl_size + t.length;
+    }
+    size_t n = pp_batch_pos_.size();
+    pp_batch_str_.resize(n);
+    pp_batch_has_.assign(n, 0);
+    if (n) {
+        sol::table r = b.call(pp_batch_fn_);
+        for (size_t i = 0; i < n; ++i) {
+            sol::optional<string> x = r[i+1];
+            if (x) {
+                pp_batch_str_[i] = std::move(*x);
+                pp_batch_has_[i] = 1;
+            }
+        }
+    }
+    pp_batch_idx_ = 0;
+    pp_batch_active_ = true;
+    pp_batch_level_ = cons_stack_top_;
+}
+// returns false if tlc isn't part of the current batch
+bool Ber2Xml::print_pp_batch(const TLC &tlc, Type type)
+{
+    if (!pp_batch_active_)
+        return false;
+    // i.e. be robust against values that aren't printed
+    while (pp_batch_idx_ < pp_batch_pos_.size()
+            && pp_batch_pos_[pp_batch_idx_] < off_)
+        ++pp_batch_idx_;
+    if (pp_batch_idx_ == pp_batch_pos_.size()
+            || pp_batch_pos_[pp_batch_idx_] != off_)
+        return false;
+    size_t i = pp_batch_idx_++;
+    // native printers take precedence
+    if (!print_native(tlc, type) && pp_batch_has_[i])
+        o_ << " pp='" << pp_batch_str_[i] << '\'';
+    return true;
 }
 #endif // XFSX_USE_LUA
 void Ber2Xml::push_matcher(const TLC &tlc)
@@ -461,6 +974,8 @@ void Ber2Xml::push_matcher(const TLC &tlc)
 #ifdef XFSX_USE_LUA
     if (!args_.pretty_print)
         return;
+    if (pp_batch_)
+        pp_batch_matcher_.push(tlc.tag, tlc.klasse);
     if (matcher_done_)
         return;
     size_t i = 0;
@@ -471,8 +986,13 @@ void Ber2Xml::push_matcher(const TLC &tlc)
             m.first.push(tlc.tag, tlc.klasse);
             if (matcher_state_[i] == 0 && m.first.matches())
                 matcher_state_[i] = 1;
-            if (matcher_state_[i] == 1 && !m.first.matches())
+            if (matcher_state_[i] == 1 && !m.first.matches()) {
                 matcher_state_[i] = 2;
+                if (matcher_batch_fn_[i] && !matcher_batch_[i].empty()) {
+                    matcher_batch_[i].call(matcher_batch_fn_[i]);
+                    matcher_batch_[i].clear();
+                }
+            }
             if (matcher_state_[i] == 2 && !m.first.matches())
                 matcher_state_[i] = 3;
         }
@@ -493,7 +1013,10 @@ void Ber2Xml::update_matcher(const TLC &tlc, int64_t v)
         return;
     size_t i = 0;
     for (auto &m : matcher_) {
-        if (matcher_state_[i] == 1)
+        if (matcher_batch_fn_[i]) {
+            if (matcher_state_[i] == 1)
+                matcher_batch_[i].push(tlc.tag, v);
+        } else if (matcher_state_[i] == 1)
             m.second.first(tlc.tag, v);
         else if (matcher_state_[i] == 2 && m.second.second)
             m.second.second();
@@ -513,7 +1036,10 @@ void Ber2Xml::update_matcher(const TLC &tlc, const char *begin, const char *end)
         return;
     size_t i = 0;
     for (auto &m : matcher_) {
-        if (matcher_state_[i] == 1)
+        if (matcher_batch_fn_[i]) {
+            if (matcher_state_[i] == 1)
+                matcher_batch_[i].push(tlc.tag, begin, end);
+        } else if (matcher_state_[i] == 1)
             m.second.first(tlc.tag, sol::string_view(begin, end-begin));
         else if (matcher_state_[i] == 2)
             m.second.second();
@@ -528,12 +1054,22 @@ void Ber2Xml::pop_matcher()
 #ifdef XFSX_USE_LUA
     if (!args_.pretty_print)
         return;
+    if (pp_batch_)
+        pp_batch_matcher_.pop();
     if (matcher_done_)
         return;
     size_t i = 0;
     for (auto &m : matcher_) {
-        if (matcher_state_[i] < 2)
+        if (matcher_state_[i] < 2) {
+            bool t = m.first.matches();
             m.first.pop();
+            // i.e. the end of one match
+            if (t && !m.first.matches() && matcher_batch_fn_[i]
+                    && !matcher_batch_[i].empty()) {
+                matcher_batch_[i].call(matcher_batch_fn_[i]);
+                matcher_batch_[i].clear();
+            }
+        }
         ++i;
     }
 #endif // XFSX_USE_LUA
@@ -555,36 +1091,59 @@ void Ber2Xml::process_blocks(scratchpad::Simple_Reader<u8> &r)
     }
 }
 void Ber2Xml::process(scratchpad::Simple_Reader<u8> &r)
+{
+    switch (mode_) {
+        case Mode::GENERIC: process_units<Mode::GENERIC>(r); break;
+        case Mode::NAMED:   process_units<Mode::NAMED  >(r); break;
+        case Mode::PRETTY:  process_units<Mode::PRETTY >(r); break;
+    }
+}
+template <Ber2Xml::Mode M>
+void Ber2Xml::process_units(scratchpad::Simple_Reader<u8> &r)
 {
     off_ = r.pos();
     TLC u;
     size_t i = 0; // XXX count globally for process_blocks()
     while (read_next(r, u)) {
-        if (args_.count && i >= args_.count) {
+        if (filtered<M>() && args_.count && i >= args_.count) {
             while (cons_stack_top_)
-                pop_constructed(cons_stack_[cons_stack_top_-1].is_indefinite);
+                pop_constructed<M>(
+                        cons_stack_[cons_stack_top_-1].is_indefinite);
             return;
         }
         ++i;
         written_stack_.top() += u.tl_size;
         bool eoc = u.is_eoc();
-        if (!eoc)
+        if (!eoc && matching<M>())
             push_matcher(u);
-        if (!eoc && !args_.search_everywhere && !u.is_indefinite
+        auto sel = Tag_Selector::ALL;
+        if (filtered<M>() && !eoc && !selector_.empty())
+            sel = selector_.push(u.tag, u.klasse);
+        if (filtered<M>() && !eoc && !args_.search_everywhere
+                && !u.is_indefinite
                 && !searcher_.empty() && searcher_.skippable()) {
             r.next(u.length);
             r.forget(u.length);
             written_stack_.top() += u.length;
             pop_matcher();
+        } else if (filtered<M>() && sel == Tag_Selector::NONE
+                && u.shape == Shape::CONSTRUCTED && !u.is_indefinite) {
+            // i.e. skip the subtree without formatting it
+            r.next(u.length);
+            r.check_available(u.length);
+            r.forget(u.length);
+            written_stack_.top() += u.length;
+            selector_.pop();
+            pop_matcher();
         } else {
-            const string *tag_str = args_.translator.empty() ?
-                nullptr : args_.translator.find(u.klasse, u.tag);
+            const Tag_Markup::Entry *m = markup_->find(u.klasse, u.tag);
             if (u.shape == Shape::PRIMITIVE) {
                 written_stack_.top() += u.length;
                 if (eoc) {
                     try {
-                        pop_constructed(true);
-                        if (args_.stop_after_first && !cons_stack_top_)
+                        pop_constructed<M>(true);
+                        if (filtered<M>() && args_.stop_after_first
+                                && !cons_stack_top_)
                             return;
                     } catch (const Unexpected_EOC &) {
                         if (args_.skip_zero) {
@@ -596,44 +1155,308 @@ void Ber2Xml::process(scratchpad::Simple_Reader<u8> &r)
                         }
                     }
                 }
-                else {
-                    print_primitive(u, tag_str);
+                else if (!filtered<M>() || selector_.empty()) {
+                    print_primitive<M>(u, m);
+                } else if (sel == Tag_Selector::ALL) {
+                    print_selected_ancestors();
+                    print_primitive<M>(u, m);
+                    selector_.pop();
+                } else {
+                    selector_.pop();
+                    pop_matcher();
                 }
             } else { // constructed
-                print_constructed(u, tag_str);
+                if (!filtered<M>() || selector_.empty()) {
+                    print_constructed<M>(u, m);
+                } else if (sel == Tag_Selector::ALL) {
+                    print_selected_ancestors();
+                    print_constructed<M>(u, m);
+                    ++shown_;
+                } else {
+                    if (cons_stack_top_ >= select_offs_.size())
+                        select_offs_.resize(cons_stack_top_ + 1);
+                    select_offs_[cons_stack_top_] = off_;
+                }
                 if (!u.is_indefinite) {
                     length_stack_.push(u.length);
                     written_stack_.push(0);
                 }
                 if (cons_stack_top_ >= cons_stack_.size()) {
                     cons_stack_.push_back(u);
-                    cons_str_stack_.push_back(tag_str);
+                    cons_markup_stack_.push_back(m);
                 } else {
                     cons_stack_[cons_stack_top_] = u;
-                    cons_str_stack_[cons_stack_top_] = tag_str;
+                    cons_markup_stack_[cons_stack_top_] = m;
                 }
                 ++cons_stack_top_;
+                if (split_ && splits_here(u)) {
+                    r.next(u.length);
+                    r.check_available(u.length);
+                    auto b = r.window().first;
+                    if (process_split(b, b + u.length, r.pos())) {
+                        r.forget(u.length);
+                        written_stack_.top() += u.length;
+                    }
+                }
+#ifdef XFSX_USE_LUA
+                else if (pp_batch_ && !pp_batch_active_
+                        && pp_batch_matcher_.matches()
+                        && !u.is_indefinite && u.length) {
+                    r.next(u.length);
+                    r.check_available(u.length);
+                    auto b = r.window().first;
+                    start_pp_batch(b, b + u.length, r.pos());
+                }
+#endif // XFSX_USE_LUA
             }
         }
         while (!length_stack_.empty()
                 && length_stack_.top() == written_stack_.top()) {
-            pop_constructed(false);
+            pop_constructed<M>(false);
             auto t = length_stack_.top();
             length_stack_.pop();
             written_stack_.pop();
             written_stack_.top() += t;
         }
-        if (args_.stop_after_first && !cons_stack_top_)
+        if (filtered<M>() && args_.stop_after_first && !cons_stack_top_)
             return;
         // Bail-out early if no range can match anymore
-        if (!args_.search_ranges.empty()
+        if (filtered<M>() && !args_.search_ranges.empty()
                 && args_.search_ranges.size() == search_ranges_pos_) {
             cons_stack_top_ = 0;
             return;
         }
         off_ = r.pos();
+        if (checkpoint_ && off_ - checkpoint_pos_ >= args_.checkpoint_interval)
+            save_checkpoint();
+    }
+}
+void Ber2Xml::save_checkpoint()
+{
+#ifdef XFSX_USE_LUA
+    // i.e. the batch is only complete at the end of the CDR
+    if (pp_batch_active_)
+        return;
+#endif // XFSX_USE_LUA
+    xml::Checkpoint c;
+    c.in_off = off_;
+    c.key = args_.checkpoint_key;
+    // i.e. the output up to out_off must be on disk before the
+    // checkpoint refers to it
+    w_.flush();
+    w_.sync();
+    c.out_off = out_base_ + w_.pos();
+    c.indent_level = indent_level_;
+    c.tags.assign(cons_stack_.begin(), cons_stack_.begin() + cons_stack_top_);
+    auto l = length_stack_;
+    auto x = written_stack_;
+    c.lengths.resize(l.size());
+    for (size_t i = l.size(); i; --i) {
+        c.lengths[i-1] = make_pair(l.top(), x.top());
+        l.pop();
+        x.pop();
+    }
+    c.save(args_.checkpoint_filename);
+    checkpoint_pos_ = off_;
+}
+void Ber2Xml::resume(const xml::Checkpoint &c)
+{
+    size_t definite = count_if(c.tags.begin(), c.tags.end(),
+            [](const Unit &u) { return !u.is_indefinite; });
+    if (c.lengths.size() != definite + 1)
+        throw range_error("inconsistent checkpoint");
+    off_ = checkpoint_pos_ = c.in_off;
+    out_base_ = c.out_off;
+    indent_level_ = c.indent_level;
+    cons_stack_.assign(c.tags.begin(), c.tags.end());
+    cons_markup_stack_.clear();
+    for (auto &u : c.tags) {
+        cons_markup_stack_.push_back(markup_->find(u.klasse, u.tag));
+#ifdef XFSX_USE_LUA
+        if (pp_batch_)
+            pp_batch_matcher_.push(u.tag, u.klasse);
+#endif // XFSX_USE_LUA
+    }
+    cons_stack_top_ = c.tags.size();
+    length_stack_ = stack<size_t>();
+    written_stack_ = stack<size_t>();
+    for (auto &p : c.lengths) {
+        length_stack_.push(p.first);
+        written_stack_.push(p.second);
+    }
+}
+bool Ber2Xml::splits_here(const TLC &tlc) const
+{
+    if (tlc.is_indefinite || !tlc.length)
+        return false;
+    auto &p = args_.split_path;
+    if (cons_stack_top_ != p.size())
+        return false;
+    for (size_t i = 0; i < p.size(); ++i) {
+        if (cons_stack_[i].klasse != Klasse::APPLICATION
+                || cons_stack_[i].tag != p[i])
+            return false;
     }
+    return true;
+}
+// i.e. calls f(0) .. f(n-1) with n threads
+static void run_parallel(size_t n, const std::function<void(size_t)> &f)
+{
+    vector<future<void>> fs;
+    fs.reserve(n - 1);
+    for (size_t i = 1; i < n; ++i)
+        fs.push_back(std::async(std::launch::async, f, i));
+    f(0);
+    for (auto &x : fs)
+        x.get();
 }
+// Splits the children in [begin, end) into up to args_.threads chunks
+// of about the same size.
+// Returns false if the children can't be split, e.g. because
+// one is indefinite.
+bool Ber2Xml::split_bounds(const u8 *begin, const u8 *end,
+        vector<const u8*> &bounds) const
+{
+    vector<const u8*> children;
+    for (const u8 *p = begin; p < end; ) {
+        Unit u;
+        u.load(p, end);
+        if (u.is_indefinite || u.is_eoc()
+                || size_t(end - p) - u.tl_size < u.length)
+            return false;
+        children.push_back(p);
+        p += u.tl_size + u.length;
+    }
+    size_t n = std::min(size_t(args_.threads), children.size());
+    if (n < 2)
+        return false;
+    bounds.clear();
+    bounds.reserve(n + 1);
+    bounds.push_back(begin);
+    for (size_t k = 1; k < n; ++k) {
+        auto i = std::lower_bound(children.begin(), children.end(),
+                begin + size_t(end - begin) * k / n);
+        if (i != children.end() && *i > bounds.back())
+            bounds.push_back(*i);
+    }
+    bounds.push_back(end);
+    return true;
+}
+// Measures the chunks of the children in [begin, end) in parallel,
+// where pos is the input offset of begin and level the indent level
+// of the children.
+bool Ber2Xml::measure_split(const u8 *begin, const u8 *end, size_t pos,
+        size_t level, xml::Layout::Split &s) const
+{
+    vector<const u8*> bounds;
+    if (!split_bounds(begin, end, bounds))
+        return false;
+    size_t n = bounds.size() - 1;
+    s.bounds.resize(n + 1);
+    for (size_t i = 0; i <= n; ++i)
+        s.bounds[i] = pos + size_t(bounds[i] - begin);
+    s.sizes.resize(n);
+    vector<size_t> reserves(n);
+    run_parallel(n, [this, &s, &reserves, &bounds, level](size_t i) {
+        auto x = scratchpad::mk_simple_reader(bounds[i], bounds[i+1]);
+        x.set_pos(s.bounds[i]);
+        reserves[i] = integer::max_dec_size;
+        s.sizes[i] = measure(x, level, false, reserves[i], nullptr);
+    });
+    s.reserve = *std::max_element(reserves.begin(), reserves.end());
+    return true;
+}
+// Format the children in [begin, end) in args_.threads chunks of
+// about the same size, each with its own Ber2Xml.
+// Returns false if the children can't be split, e.g. because
+// one is indefinite - then the caller just continues serially.
+bool Ber2Xml::process_split(const u8 *begin, const u8 *end, size_t pos)
+{
+    if (measurable()) {
+        // i.e. unless pretty_size() already measured the chunks
+        xml::Layout::Split m;
+        const xml::Layout::Split *s = nullptr;
+        if (layout_ && layout_pos_ < layout_->splits.size()
+                && layout_->splits[layout_pos_].bounds.front() == pos
+                && layout_->splits[layout_pos_].bounds.back()
+                    == pos + size_t(end - begin)) {
+            s = &layout_->splits[layout_pos_++];
+        } else {
+            if (!measure_split(begin, end, pos, indent_level_, m))
+                return false;
+            s = &m;
+        }
+        size_t n = s->sizes.size();
+        vector<size_t> offs(n + 1);
+        for (size_t i = 0; i < n; ++i)
+            offs[i+1] = offs[i] + s->sizes[i];
+        // i.e. each chunk is written directly into its own region of
+        // the output, without any intermediate buffers
+        char *o = w_.begin_write(offs[n] + s->reserve);
+        vector<scratchpad::Simple_Writer<char>> ws;
+        ws.reserve(n);
+        vector<unique_ptr<Ber2Xml>> bs;
+        bs.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            // Reserving room may reach into the following regions,
+            // but since the sizes are exact nothing is written there.
+            ws.push_back(scratchpad::mk_simple_writer<char>(o + offs[i],
+                        o + offs[n] + s->reserve));
+            bs.emplace_back(new Ber2Xml(ws.back(), args_, indent_level_,
+                        markup_));
+        }
+        run_parallel(n, [&bs, &ws, &offs, s, begin, pos](size_t i) {
+            scratchpad::Simple_Reader<u8> x(begin + (s->bounds[i] - pos),
+                    begin + (s->bounds[i+1] - pos));
+            x.set_pos(s->bounds[i]);
+            bs[i]->process(x);
+            if (bs[i]->open_tags())
+                throw overflow_error("some tags are still open");
+            if (ws[i].pos() != offs[i+1] - offs[i])
+                throw logic_error("measured XML size doesn't match output");
+        });
+        w_.commit_write(offs[n]);
+        return true;
+    }
+
+    vector<const u8*> bounds;
+    if (!split_bounds(begin, end, bounds))
+        return false;
+    size_t n = bounds.size() - 1;
+    // constructed here since setting up Lua isn't thread-safe
+    vector<scratchpad::Simple_Writer<char>> ws;
+    ws.reserve(n);
+    vector<unique_ptr<Ber2Xml>> bs;
+    bs.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        ws.push_back(scratchpad::mk_simple_writer<char>());
+        bs.emplace_back(new Ber2Xml(ws.back(), args_, indent_level_,
+                    markup_));
+    }
+    auto work = [&bs, &ws, &bounds, begin, pos](size_t i) {
+        scratchpad::Simple_Reader<u8> x(bounds[i], bounds[i+1]);
+        x.set_pos(pos + size_t(bounds[i] - begin));
+        bs[i]->process(x);
+        if (bs[i]->open_tags())
+            throw overflow_error("some tags are still open");
+        ws[i].flush();
+    };
+    vector<future<void>> fs;
+    fs.reserve(n - 1);
+    for (size_t i = 1; i < n; ++i)
+        fs.push_back(std::async(std::launch::async, work, i));
+    work(0);
+    for (size_t i = 0; i < n; ++i) {
+        if (i)
+            fs[i-1].get();
+        auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
+                ws[i].backend())->pad();
+        w_.write(pad.prelude(), pad.prelude() + ws[i].pos());
+        ws[i].clear();
+    }
+    return true;
+}
+template <Ber2Xml::Mode M>
 void Ber2Xml::pop_constructed(bool is_indefinite)
 {
     if (!cons_stack_top_)
@@ -644,23 +1467,24 @@ void Ber2Xml::pop_constructed(bool is_indefinite)
         else
             throw xfsx::Unexpected_EOC();
     }
-    if (searcher_matches()) {
+    // i.e. without selecting, each open tag is shown
+    bool shown = !filtered<M>() || cons_stack_top_ <= shown_
+        || selector_.empty();
+    if (shown && (!filtered<M>() || searcher_matches())) {
 
 
     --indent_level_;
     if (cons_stack_[cons_stack_top_-1].is_indefinite
             || cons_stack_[cons_stack_top_-1].length) {
-        indent(indent_level_);
         //indent(cons_stack_top_-1);
-        const string *s = cons_str_stack_[cons_stack_top_-1];
-        if (s) {
-            w_.write("</");
-            w_.write(s->data(), s->data()+s->size());
-            if (cons_stack_[cons_stack_top_-1].is_indefinite)
-                w_.write("> <!-- indefinite -->\n");
-            else
-                w_.write(">\n");
+        const Tag_Markup::Entry *m = cons_markup_stack_[cons_stack_top_-1];
+        if (m) {
+            auto p = markup_->part(*m,
+                    cons_stack_[cons_stack_top_-1].is_indefinite ?
+                    Tag_Markup::INDEFINITE_CLOSE : Tag_Markup::CLOSE);
+            print_indented(p.first, p.second);
         } else {
+            indent(indent_level_);
             if (cons_stack_[cons_stack_top_-1].is_indefinite)
                 w_.write("</i>\n");
             else
@@ -669,8 +1493,32 @@ void Ber2Xml::pop_constructed(bool is_indefinite)
     }
 
     }
+#ifdef XFSX_USE_LUA
+    if (pp_batch_active_ && cons_stack_top_ == pp_batch_level_)
+        pp_batch_active_ = false;
+#endif // XFSX_USE_LUA
+    if (filtered<M>() && !selector_.empty()) {
+        if (shown)
+            --shown_;
+        selector_.pop();
+    }
     --cons_stack_top_;
-    pop_matcher();
+    if (matching<M>())
+        pop_matcher();
+}
+// e.g. the path to the first selected tag inside of a CDR
+void Ber2Xml::print_selected_ancestors()
+{
+    if (shown_ == cons_stack_top_)
+        return;
+    size_t off = off_;
+    for (; shown_ < cons_stack_top_; ++shown_) {
+        TLC t;
+        static_cast<Unit&>(t) = cons_stack_[shown_];
+        off_ = select_offs_[shown_];
+        print_constructed<Mode::GENERIC>(t, cons_markup_stack_[shown_]);
+    }
+    off_ = off;
 }
 bool Ber2Xml::searcher_matches()
 {
@@ -694,25 +1542,29 @@ bool Ber2Xml::searcher_matches()
         return false;
     }
 }
-void Ber2Xml::print_constructed(const TLC &tlc, const string *tag_str)
+template <Ber2Xml::Mode M>
+void Ber2Xml::print_constructed(const TLC &tlc, const Tag_Markup::Entry *m)
 {
-    if (searcher_matches()) {
+    if (!filtered<M>() || searcher_matches()) {
 
-    //indent(cons_stack_top_);
-    indent(indent_level_);
-    ++indent_level_;
-    if (tag_str) {
-        w_.write("<");
-        w_.write(tag_str->data(), tag_str->data()+tag_str->size());
-        if (tlc.is_indefinite)
-            w_.write(" definite='false'");
-    } else {
+    if (m) {
         if (tlc.is_indefinite)
-            w_.write("<i");
+            print_start<M>(*m, Tag_Markup::INDEFINITE_OPEN, 2, tlc);
+        else if (!tlc.length)
+            print_start<M>(*m, Tag_Markup::EMPTY, 3, tlc);
         else
-            w_.write("<c");
+            print_start<M>(*m, Tag_Markup::OPEN, 2, tlc);
+        ++indent_level_;
+        return;
     }
-    print_attributes(tlc, tag_str);
+    //indent(cons_stack_top_);
+    indent(indent_level_);
+    ++indent_level_;
+    if (tlc.is_indefinite)
+        w_.write("<i");
+    else
+        w_.write("<c");
+    print_attributes(tlc);
     if (!tlc.is_indefinite && !tlc.length)
         w_.write("/>\n");
     else
@@ -720,12 +1572,39 @@ void Ber2Xml::print_constructed(const TLC &tlc, const string *tag_str)
 
     }
 }
-void Ber2Xml::print_attributes(const TLC &tlc, const string *tag_str)
+// i.e. the variable attributes are inserted before the last suffix
+// characters of the part (e.g. before '>\n')
+template <Ber2Xml::Mode M>
+void Ber2Xml::print_start(const Tag_Markup::Entry &m, Tag_Markup::Part part,
+        size_t suffix, const TLC &tlc)
+{
+    auto p = markup_->part(m, part);
+    if (var_attributes<M>()) {
+        print_indented(p.first, p.second - suffix);
+        print_variable_attributes(tlc);
+        w_.write(p.second - suffix, p.second);
+    } else {
+        print_indented(p.first, p.second);
+    }
+}
+void Ber2Xml::print_indented(const char *begin, const char *end)
+{
+    size_t k = indent_level_ * args_.indent_size;
+    size_t n = end - begin;
+    auto x = w_.begin_write(k + n);
+    std::fill(x, x + k, ' ');
+    std::copy(begin, end, x + k);
+    w_.commit_write(k + n);
+}
+// of an untranslated tag
+void Ber2Xml::print_attributes(const TLC &tlc)
+{
+    o_ << " tag='" << tlc.tag << '\'';
+    o_ << " class='" << klasse_to_cstr(tlc.klasse) << '\'';
+    print_variable_attributes(tlc);
+}
+void Ber2Xml::print_variable_attributes(const TLC &tlc)
 {
-    if (!tag_str || args_.dump_tag)
-        o_ << " tag='" << tlc.tag << '\'';
-    if (!tag_str || args_.dump_class)
-        o_ << " class='" << klasse_to_cstr(tlc.klasse) << '\'';
     if (args_.dump_tl)
         o_ << " tl='" << tlc.tl_size << '\'';
     if (args_.dump_t)
@@ -745,18 +1624,63 @@ void Ber2Xml::print_attributes(const TLC &tlc, const string *tag_str)
         o_ << "'";
     }
 }
+bool Ber2Xml::print_native(const TLC &tlc, Type type)
+{
+    auto p = args_.printers.find(tlc.klasse, tlc.tag);
+    if (!p)
+        return false;
+    const u8 *b = tlc.begin + tlc.tl_size;
+    bool r = false;
+    switch (type) {
+        case Type::INT_64: {
+            int64_t v {0};
+            xfsx::decode(b, tlc.length, v);
+            r = p->print(v, pp_o_);
+            } break;
+        case Type::BCD: {
+            size_t n = tlc.length * 2;
+            pp_bcd_.resize(n);
+            if (n) {
+                bcd::decode(b, b + tlc.length, &pp_bcd_[0]);
+                if (pp_bcd_[n-1] == 'f')
+                    --n;
+            }
+            r = p->print(pp_bcd_.data(), pp_bcd_.data() + n, pp_o_);
+            } break;
+        case Type::STRING:
+        case Type::OCTET_STRING:
+            r = p->print(reinterpret_cast<const char*>(b),
+                    reinterpret_cast<const char*>(b) + tlc.length, pp_o_);
+            break;
+    }
+    if (r) {
+        pp_w_.flush();
+        auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<char>*>(
+                pp_w_.backend())->pad();
+        o_ << " pp='";
+        w_.write(pad.prelude(), pad.prelude() + pp_w_.pos());
+        o_ << '\'';
+    }
+    pp_w_.clear();
+    return r;
+}
 void Ber2Xml::pretty_print(const TLC &tlc, Type type)
 {
-    (void)tlc;
-    (void)type;
-#ifdef XFSX_USE_LUA
     if (!args_.pretty_print)
         return;
 
     if (tlc.shape != Shape::PRIMITIVE)
         return;
 
+#ifdef XFSX_USE_LUA
     pretty_printed_ = false;
+    if (print_pp_batch(tlc, type))
+        return;
+#endif // XFSX_USE_LUA
+    if (print_native(tlc, type))
+        return;
+
+#ifdef XFSX_USE_LUA
     auto i = pp_fn_map_.find(tlc.tag);
     if (i == pp_fn_map_.end())
         return;
@@ -787,35 +1711,46 @@ void Ber2Xml::pretty_print(const TLC &tlc, Type type)
     }
 #endif // XFSX_USE_LUA
 }
-void Ber2Xml::print_primitive(const TLC &tlc, const string *tag_str)
+template <Ber2Xml::Mode M>
+void Ber2Xml::print_primitive(const TLC &tlc, const Tag_Markup::Entry *m)
 {
-    if (searcher_matches()) {
+    if (!filtered<M>() || searcher_matches()) {
 
-    //indent(cons_stack_top_);
-    indent(indent_level_);
-    if (tag_str)
-        o_ << '<' << *tag_str;
-    else
+    // i.e. the start tag isn't terminated, yet
+    bool gt = true;
+    if (!m) {
+        //indent(cons_stack_top_);
+        indent(indent_level_);
         o_ << "<p";
-    print_attributes(tlc, tag_str);
+        print_attributes(tlc);
+    } else if (!tlc.length) {
+        print_start<M>(*m, Tag_Markup::EMPTY, 3, tlc);
+    } else {
+        // i.e. a pretty-printed value adds an attribute
+        gt = var_attributes<M>() || pretty<M>();
+        auto p = markup_->part(*m, Tag_Markup::PRIMITIVE_OPEN);
+        print_indented(p.first, p.second - (gt ? 1 : 0));
+        if (var_attributes<M>())
+            print_variable_attributes(tlc);
+    }
     if (tlc.length) {
-    if (args_.translator.empty()) {
+    if (!translated<M>()) {
         w_.write(">");
-        size_t n = hex::decoded_size<hex::Style::XML>(
-                tlc.begin + tlc.tl_size, tlc.begin + tlc.tl_size + tlc.length
-                );
+        size_t n = hex::max_decoded_size<hex::Style::XML>(tlc.length);
         auto x = w_.begin_write(n);
-        hex::decode<hex::Style::XML>(
+        auto e = hex::decode<hex::Style::XML>(
                 tlc.begin + tlc.tl_size, tlc.begin + tlc.tl_size + tlc.length,
                 x);
-        w_.commit_write(n);
+        w_.commit_write(e - x);
     } else {
 	auto kt = args_.dereferencer.dereference(tlc.klasse, tlc.tag);
 	auto type = args_.typifier.typify(kt);
-        pretty_print(tlc, type);
-        w_.write(">");
+        if (pretty<M>())
+            pretty_print(tlc, type);
+        if (gt)
+            w_.write(">");
 #ifdef XFSX_USE_LUA
-        if (args_.pretty_print && pretty_printed_) {
+        if (pretty<M>() && pretty_printed_) {
             switch (type) {
             case Type::INT_64:
                 o_ << v_;
@@ -846,7 +1781,8 @@ void Ber2Xml::print_primitive(const TLC &tlc, const string *tag_str)
             case Type::INT_64: {
                 int64_t v {0};
                 xfsx::decode(tlc.begin + tlc.tl_size, tlc.length, v);
-                update_matcher(tlc, v);
+                if (pretty<M>())
+                    update_matcher(tlc, v);
                 o_ << v;
                 } break;
             case Type::BCD: {
@@ -857,34 +1793,38 @@ void Ber2Xml::print_primitive(const TLC &tlc, const string *tag_str)
                             tlc.begin+tlc.tl_size+tlc.length, x);
                     if (x[n-1] == 'f')
                         --n;
-                    update_matcher(tlc, x, x+n);
+                    if (pretty<M>())
+                        update_matcher(tlc, x, x+n);
                     w_.commit_write(n);
                 }
                 } break;
             case Type::STRING:
             case Type::OCTET_STRING:
-                size_t n = hex::decoded_size<hex::Style::XML>(
-                    tlc.begin + tlc.tl_size, tlc.begin + tlc.tl_size + tlc.length
-                    );
+                // single pass, i.e. reserve for the worst case
+                size_t n = hex::max_decoded_size<hex::Style::XML>(tlc.length);
                 auto x = w_.begin_write(n);
-                hex::decode<hex::Style::XML>(
+                auto e = hex::decode<hex::Style::XML>(
                     tlc.begin + tlc.tl_size, tlc.begin + tlc.tl_size + tlc.length,
                     x);
-                update_matcher(tlc, x, x+n);
-                w_.commit_write(n);
+                if (pretty<M>())
+                    update_matcher(tlc, x, e);
+                w_.commit_write(e - x);
                 break;
         }
         }
     }
-    if (tag_str)
-        o_ << "</" << *tag_str << ">\n";
-    else
-        o_ << "</p>\n";
+    if (m) {
+        auto p = markup_->part(*m, Tag_Markup::CLOSE);
+        w_.write(p.first, p.second);
     } else {
+        o_ << "</p>\n";
+    }
+    } else if (!m) {
         o_ << "/>\n";
     }
     }
-    pop_matcher();
+    if (matching<M>())
+        pop_matcher();
 }
 void Ber2Xml::indent(size_t k)
 {
@@ -894,11 +1834,290 @@ void Ber2Xml::indent(size_t k)
     w_.commit_write(n);
 }
 
+bool Ber2Xml::measurable() const
+{
+    return !args_.pretty_print && searcher_.empty() && selector_.empty()
+        && !args_.count && !args_.block_size && !args_.skip_zero
+        && !args_.stop_after_first;
+}
+size_t Ber2Xml::measure(scratchpad::Simple_Reader<u8> &r, size_t &reserve,
+        xml::Layout *layout) const
+{
+    // e.g. integer attributes
+    reserve = integer::max_dec_size;
+    return measure(r, indent_level_, split_, reserve, layout);
+}
+void Ber2Xml::set_layout(const xml::Layout &layout)
+{
+    layout_ = &layout;
+    layout_pos_ = 0;
+}
+// i.e. mirrors process() and the print functions
+size_t Ber2Xml::measure(scratchpad::Simple_Reader<u8> &r, size_t level,
+        bool split, size_t &reserve, xml::Layout *layout) const
+{
+    struct Frame {
+        // i.e. input offset, unless indefinite
+        size_t end;
+        bool is_indefinite;
+        const Tag_Markup::Entry *m;
+        Klasse klasse;
+        Tag_Int tag;
+    };
+    vector<Frame> stack;
+    size_t n = 0;
+    auto &split_path = args_.split_path;
+    TLC u;
+    for (;;) {
+        size_t off = r.pos();
+        if (!read_next(r, u))
+            break;
+        const Tag_Markup::Entry *m = markup_->find(u.klasse, u.tag);
+        size_t indent = level * args_.indent_size;
+        if (u.is_eoc()) {
+            if (stack.empty())
+                throw xfsx::Unexpected_EOC();
+            if (!stack.back().is_indefinite)
+                throw xfsx::TL_Too_Small();
+            --level;
+            n += level * args_.indent_size + (stack.back().m
+                    ? markup_->size(*stack.back().m,
+                        Tag_Markup::INDEFINITE_CLOSE)
+                    : 5); // </i>\n
+            stack.pop_back();
+        } else if (u.shape == Shape::PRIMITIVE) {
+            if (!m) {
+                // <p .../> or <p ...>...</p>\n
+                n += indent + 2 + measure_attributes(u, off)
+                    + (u.length ? 1 + measure_content(u, reserve) + 5 : 3);
+            } else if (!u.length) {
+                n += indent + markup_->size(*m, Tag_Markup::EMPTY)
+                    + measure_variable_attributes(u, off);
+            } else {
+                n += indent + markup_->size(*m, Tag_Markup::PRIMITIVE_OPEN)
+                    + measure_variable_attributes(u, off)
+                    + measure_content(u, reserve)
+                    + markup_->size(*m, Tag_Markup::CLOSE);
+            }
+        } else {
+            if (m) {
+                n += indent + markup_->size(*m, u.is_indefinite
+                        ? Tag_Markup::INDEFINITE_OPEN
+                        : (u.length ? Tag_Markup::OPEN : Tag_Markup::EMPTY))
+                    + measure_variable_attributes(u, off);
+            } else {
+                // <i ...>\n, <c .../>\n or <c ...>\n
+                n += indent + 2 + measure_attributes(u, off)
+                    + (u.is_indefinite || u.length ? 2 : 3);
+            }
+            if (u.is_indefinite || u.length) {
+                ++level;
+                stack.push_back(Frame{u.is_indefinite ? ~size_t(0)
+                        : r.pos() + u.length, bool(u.is_indefinite), m,
+                        u.klasse, u.tag});
+            }
+            // cf. splits_here()
+            if (split && !u.is_indefinite && u.length
+                    && stack.size() == split_path.size()
+                    && std::equal(stack.begin(), stack.end(),
+                        split_path.begin(),
+                        [](const Frame &f, Tag_Int t) {
+                            return f.klasse == Klasse::APPLICATION
+                                && f.tag == t; })) {
+                r.next(u.length);
+                r.check_available(u.length);
+                auto b = r.window().first;
+                xml::Layout::Split s;
+                if (measure_split(b, b + u.length, r.pos(), level, s)) {
+                    for (auto k : s.sizes)
+                        n += k;
+                    reserve = std::max(reserve, s.reserve);
+                    r.forget(u.length);
+                    if (layout)
+                        layout->splits.push_back(std::move(s));
+                }
+            }
+        }
+        while (!stack.empty() && stack.back().end == r.pos()) {
+            --level;
+            n += level * args_.indent_size + (stack.back().m
+                    ? markup_->size(*stack.back().m, Tag_Markup::CLOSE)
+                    : 5); // </c>\n
+            stack.pop_back();
+        }
+    }
+    if (!stack.empty())
+        throw overflow_error("some tags are still open");
+    return n;
+}
+size_t Ber2Xml::measure_attributes(const TLC &tlc, size_t off) const
+{
+    // i.e.  tag='' class=''
+    return 6 + byte::writer::encoded_length(tlc.tag) + 1
+        + 8 + strlen(klasse_to_cstr(tlc.klasse)) + 1
+        + measure_variable_attributes(tlc, off);
+}
+size_t Ber2Xml::measure_variable_attributes(const TLC &tlc, size_t off) const
+{
+    size_t n = 0;
+    if (args_.dump_tl)
+        n += 5 + byte::writer::encoded_length(size_t(tlc.tl_size)) + 1;
+    if (args_.dump_t)
+        n += 4 + byte::writer::encoded_length(size_t(tlc.t_size)) + 1;
+    if (args_.dump_length)
+        n += 9 + byte::writer::encoded_length(tlc.length) + 1;
+    if (args_.dump_offset)
+        n += 6 + byte::writer::encoded_length(off) + 1;
+    if (args_.hex_dump && tlc.shape == Shape::PRIMITIVE)
+        n += 6 + hex::decoded_size<hex::Style::Raw>(tlc.begin + tlc.tl_size,
+                tlc.begin + tlc.tl_size + tlc.length) + 1;
+    return n;
+}
+size_t Ber2Xml::measure_content(const TLC &tlc, size_t &reserve) const
+{
+    const u8 *b = tlc.begin + tlc.tl_size;
+    // i.e. the content is decoded into the reserved worst case
+    auto decoded = [b, &tlc, &reserve]() {
+        size_t n = hex::decoded_size<hex::Style::XML>(b, b + tlc.length);
+        reserve = std::max(reserve,
+                hex::max_decoded_size<hex::Style::XML>(tlc.length) - n);
+        return n;
+    };
+    if (args_.translator.empty())
+        return decoded();
+    auto kt = args_.dereferencer.dereference(tlc.klasse, tlc.tag);
+    switch (args_.typifier.typify(kt)) {
+        case Type::INT_64: {
+            int64_t v {0};
+            xfsx::decode(b, tlc.length, v);
+            return byte::writer::encoded_length(v);
+            }
+        case Type::BCD:
+            // i.e. a trailing filler nibble isn't printed
+            if (tlc.length && (b[tlc.length-1] & 0xfu) == 0xfu)
+                return tlc.length * 2 - 1;
+            return tlc.length * 2;
+        case Type::STRING:
+        case Type::OCTET_STRING:
+            break;
+    }
+    return decoded();
+}
+
 
 
     namespace xml {
 
 
+        void Checkpoint::save(const std::string &filename) const
+        {
+            ostringstream o;
+            o << "xfsx-checkpoint 2\n"
+              << "key " << key << '\n'
+              << "in " << in_off << '\n'
+              << "out " << out_off << '\n'
+              << "indent " << indent_level << '\n'
+              << "tags " << tags.size() << '\n';
+            for (auto &u : tags)
+                o << unsigned(u.klasse) << ' ' << u.tag << ' '
+                  << unsigned(u.is_indefinite) << ' ' << u.length << '\n';
+            o << "lengths " << lengths.size() << '\n';
+            for (auto &p : lengths)
+                o << p.first << ' ' << p.second << '\n';
+            auto s = o.str();
+
+            string tmp(filename + ".tmp");
+            {
+                ixxx::util::FD fd(tmp, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+                ixxx::util::write_all(fd, s.data(), s.size());
+                ixxx::posix::fsync(fd);
+            }
+            if (::rename(tmp.c_str(), filename.c_str()) == -1)
+                throw std::system_error(errno, std::generic_category(),
+                        "rename " + tmp);
+        }
+        void Checkpoint::load(const std::string &filename)
+        {
+            ifstream f(filename);
+            if (!f)
+                throw runtime_error("can't open checkpoint: " + filename);
+            auto expect = [&f, &filename](const char *key) {
+                string k;
+                if (!(f >> k) || k != key)
+                    throw runtime_error("invalid checkpoint (expected "
+                            + string(key) + "): " + filename);
+            };
+            auto fail = [&filename]() {
+                throw runtime_error("invalid checkpoint: " + filename);
+            };
+            unsigned version {0};
+            expect("xfsx-checkpoint");
+            if (!(f >> version) || version != 2)
+                fail();
+            expect("key");
+            // i.e. the rest of the line, after the separating blank
+            if (f.get() != ' ' || !getline(f, key))
+                fail();
+            size_t n {0};
+            expect("in");
+            f >> in_off;
+            expect("out");
+            f >> out_off;
+            expect("indent");
+            f >> indent_level;
+            expect("tags");
+            f >> n;
+            tags.clear();
+            for (size_t i = 0; f && i < n; ++i) {
+                unsigned k {0}, indefinite {0};
+                Tag_Int tag {0};
+                size_t length {0};
+                if (!(f >> k >> tag >> indefinite >> length) || k > 0xff
+                        || (k & 0x3fu) || indefinite > 1)
+                    fail();
+                Unit u;
+                u.klasse = Klasse(k);
+                u.shape = Shape::CONSTRUCTED;
+                u.init_tag(tag);
+                if (indefinite)
+                    u.init_indefinite();
+                else
+                    u.init_length(length);
+                tags.push_back(u);
+            }
+            expect("lengths");
+            f >> n;
+            lengths.clear();
+            for (size_t i = 0; f && i < n; ++i) {
+                size_t a {0}, b {0};
+                if (!(f >> a >> b))
+                    fail();
+                lengths.emplace_back(a, b);
+            }
+            if (!f || lengths.empty())
+                fail();
+        }
+
+        void pretty_write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const Pretty_Writer_Arguments &args,
+                const Checkpoint &c)
+        {
+            if (c.key != args.checkpoint_key)
+                throw runtime_error("checkpoint belongs to a different"
+                        " input or different options");
+            if (r.pos() < c.in_off)
+                r.skip(c.in_off - r.pos());
+            if (r.pos() != c.in_off)
+                throw range_error("reader is positioned after the checkpoint");
+            Ber2Xml b2x(w, args);
+            b2x.resume(c);
+            b2x.process(r);
+            w.flush();
+            if (b2x.open_tags())
+                throw overflow_error("some tags are still open");
+        }
+
         void pretty_write(scratchpad::Simple_Reader<u8> &r,
                 scratchpad::Simple_Writer<char> &w,
                 const Pretty_Writer_Arguments &args)
@@ -918,6 +2137,20 @@ void Ber2Xml::indent(size_t k)
             if (b2x.open_tags() && !args.count)
                 throw overflow_error("some tags are still open");
         }
+        void pretty_write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const Pretty_Writer_Arguments &args,
+                const Layout &layout)
+        {
+            if (args.skip)
+                r.skip(args.skip);
+            Ber2Xml b2x(w, args);
+            b2x.set_layout(layout);
+            b2x.process(r);
+            w.flush();
+            if (b2x.open_tags())
+                throw overflow_error("some tags are still open");
+        }
         void pretty_write(
             const u8 *begin, const u8 *end,
             scratchpad::Simple_Writer<char> &w,
@@ -936,6 +2169,31 @@ void Ber2Xml::indent(size_t k)
             pretty_write(r, w, args);
         }
 
+        size_t pretty_size(const u8 *begin, const u8 *end,
+            const Pretty_Writer_Arguments &args, size_t *reserve)
+        {
+            auto r = scratchpad::mk_simple_reader(begin, end);
+            return pretty_size(r, args, reserve);
+        }
+        size_t pretty_size(scratchpad::Simple_Reader<u8> &r,
+            const Pretty_Writer_Arguments &args, size_t *reserve,
+            Layout *layout)
+        {
+            if (args.skip)
+                r.skip(args.skip);
+            auto w = scratchpad::mk_simple_writer<char>();
+            Ber2Xml b2x(w, args);
+            if (!b2x.measurable())
+                throw range_error("output size isn't known in advance when"
+                        " pretty-printing, searching, counting or reading"
+                        " blocks");
+            size_t x = 0;
+            size_t n = b2x.measure(r, x, layout);
+            if (reserve)
+                *reserve = x;
+            return n;
+        }
+
 
   } // xml
 
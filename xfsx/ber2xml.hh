@@ -23,6 +23,10 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 //#include <xfsx/byte.hh>
 #include <xfsx/xml_writer_arguments.hh>
 
@@ -69,9 +73,39 @@ namespace xfsx {
         const u8 *begin, const u8 *end,
         const char *filename);
 
+    // The state of pretty_write() at a tag boundary, i.e. an
+    // interrupted conversion can be resumed from it after the output
+    // is truncated to out_off.
+    struct Checkpoint {
+      size_t in_off       {0};
+      size_t out_off      {0};
+      size_t indent_level {0};
+      // the open constructed tags, outermost first
+      std::vector<Unit> tags;
+      // (length, processed bytes) of the open definite tags,
+      // starting with a catch-all entry
+      std::vector<std::pair<size_t, size_t> > lengths;
+      // cf. Writer_Arguments::checkpoint_key
+      std::string key;
+
+      // replaces the file atomically
+      void save(const std::string &filename) const;
+      // throws if the file doesn't contain a valid checkpoint
+      void load(const std::string &filename);
+    };
+
+    // With args.checkpoint_filename, the state is periodically saved
+    // to that file (cf. args.checkpoint_interval).
     void pretty_write(scratchpad::Simple_Reader<u8> &r,
             scratchpad::Simple_Writer<char> &w,
             const Pretty_Writer_Arguments &args);
+    // Resumes a conversion where r is positioned at (or before)
+    // c.in_off and w appends to the output truncated to c.out_off.
+    // Throws if c.key doesn't match args.checkpoint_key.
+    void pretty_write(scratchpad::Simple_Reader<u8> &r,
+            scratchpad::Simple_Writer<char> &w,
+            const Pretty_Writer_Arguments &args,
+            const Checkpoint &c);
     void pretty_write(
         const u8 *begin, const u8 *end,
         scratchpad::Simple_Writer<char> &w,
@@ -81,6 +115,45 @@ namespace xfsx {
         const std::string &filename,
         const Pretty_Writer_Arguments &args);
 
+    // The output regions of the children of split_path tags (cf.
+    // Writer_Arguments::threads) as measured by pretty_size(), i.e.
+    // such that pretty_write() doesn't measure them again.
+    struct Layout {
+      struct Split {
+        // input offsets of the chunk boundaries
+        std::vector<size_t> bounds;
+        // output size of each chunk
+        std::vector<size_t> sizes;
+        size_t reserve {0};
+      };
+      std::vector<Split> splits;
+    };
+
+    // Returns the exact size of the output of pretty_write() for
+    // [begin, end), without formatting anything, e.g. for
+    // preallocating the output file. Throws if the size depends on
+    // more than the input and the arguments, i.e. with pretty-printing,
+    // searching, counting, reading blocks etc.
+    //
+    // Since the writer reserves room for some values before formatting
+    // them, a memory writer needs *reserve additional bytes after
+    // the output.
+    //
+    // With args.threads, the children of the split_path tag are
+    // measured in parallel and, if layout isn't null, their regions
+    // are stored in it.
+    size_t pretty_size(const u8 *begin, const u8 *end,
+        const Pretty_Writer_Arguments &args, size_t *reserve = nullptr);
+    size_t pretty_size(scratchpad::Simple_Reader<u8> &r,
+        const Pretty_Writer_Arguments &args, size_t *reserve = nullptr,
+        Layout *layout = nullptr);
+    // i.e. with the layout that pretty_size() measured for the same
+    // input and arguments
+    void pretty_write(scratchpad::Simple_Reader<u8> &r,
+            scratchpad::Simple_Writer<char> &w,
+            const Pretty_Writer_Arguments &args,
+            const Layout &layout);
+
   } // xml
 
 }
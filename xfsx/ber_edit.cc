@@ -0,0 +1,317 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "ber_edit.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/regex.hpp>
+
+#include "xfsx.hh"
+#include "integer.hh"
+#include "string.hh"
+#include "scratchpad.hh"
+#include "tlc_reader.hh"
+#include "xml2ber.hh"
+#include "xml_writer_arguments.hh"
+#include "ber_writer_arguments.hh"
+
+using namespace std;
+
+namespace xfsx {
+    namespace ber {
+        namespace edit {
+
+            static bool is_name_char(char c)
+            {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                    || (c >= '0' && c <= '9') || c == '_' || c == '-';
+            }
+
+            bool parse_path(const std::string &xpath, Path &path)
+            {
+                Path p;
+                size_t i = 0;
+                if (xpath.compare(0, 2, "//") == 0) {
+                    p.anywhere = true;
+                    i = 2;
+                } else if (xpath.compare(0, 1, "/") == 0) {
+                    i = 1;
+                } else {
+                    return false;
+                }
+                for (;;) {
+                    size_t j = xpath.find('/', i);
+                    if (j == string::npos)
+                        j = xpath.size();
+                    string step(xpath, i, j - i);
+                    if (step.empty())
+                        return false;
+                    if (step != "*" && !all_of(step.begin(), step.end(),
+                                is_name_char))
+                        return false;
+                    p.steps.push_back(std::move(step));
+                    if (j == xpath.size())
+                        break;
+                    i = j + 1;
+                }
+                path = std::move(p);
+                return true;
+            }
+
+            namespace {
+
+                struct Level {
+                    Unit unit;
+                    size_t off;
+                    size_t end;
+                    const string *name;
+                    // i.e. how much the content of this level grows
+                    // (or shrinks) due to the edits of its descendants
+                    ptrdiff_t delta;
+                };
+
+                // Levels of the element and its ancestors, i.e.
+                // the element is at the top.
+                bool matches(const Path &p, const vector<Level> &levels)
+                {
+                    size_t n = p.steps.size();
+                    if (p.anywhere ? levels.size() < n : levels.size() != n)
+                        return false;
+                    auto l = levels.end() - n;
+                    for (auto &step : p.steps) {
+                        if (step != "*" && (!l->name || *l->name != step))
+                            return false;
+                        ++l;
+                    }
+                    return true;
+                }
+
+            }
+
+            Editor::Editor(const std::vector<Op> &ops,
+                    const xml::Pretty_Writer_Arguments &pargs,
+                    const BER_Writer_Arguments &bargs)
+                :
+                    ops_(ops),
+                    pargs_(pargs),
+                    bargs_(bargs)
+            {
+            }
+
+            // i.e. as in the XML output, cf. l2::Tree_Generator
+            std::string Editor::render(const TLC &tlc) const
+            {
+                auto kt = pargs_.dereferencer.dereference(tlc.klasse, tlc.tag);
+                const u8 *b = tlc.begin + tlc.tl_size;
+                switch (pargs_.typifier.typify(kt)) {
+                    case Type::INT_64:
+                        {
+                            int64_t v {0};
+                            xfsx::decode(b, tlc.length, v);
+                            char s[integer::max_dec_size];
+                            return string(s, integer::format_dec(v, s));
+                        }
+                    case Type::BCD:
+                        {
+                            BCD_String bcd;
+                            xfsx::decode(b, tlc.length, bcd);
+                            return string(bcd.get().begin(), bcd.get().end());
+                        }
+                    case Type::STRING:
+                    case Type::OCTET_STRING:
+                        break;
+                }
+                return string(reinterpret_cast<const char*>(b), tlc.length);
+            }
+
+            // i.e. as the BER writer encodes a primitive element
+            std::string Editor::encode(const std::string &name,
+                    const std::string &text) const
+            {
+                TLV tlv;
+                xml::Attributes as;
+                as.full_tag = xml::read_tag(
+                        make_pair(name.data(), name.data() + name.size()),
+                        tlv, bargs_);
+                xml::add_content(
+                        make_pair(text.data(), text.data() + text.size()),
+                        tlv, as, bargs_);
+                string r(tlv.tl_size + tlv.length, '\0');
+                u8 *o = reinterpret_cast<u8*>(&r[0]);
+                tlv.write(o, o + r.size());
+                return r;
+            }
+
+            void Editor::scan(scratchpad::Simple_Reader<u8> &r)
+            {
+                vector<boost::regex> regexes;
+                for (auto &op : ops_)
+                    regexes.emplace_back(op.kind == Kind::REPLACE
+                            ? op.regex : string());
+                patches_.clear();
+                vector<Level> levels;
+                auto patch = [this, &levels](size_t off, size_t size,
+                        string &&bytes) {
+                    if (!levels.empty())
+                        levels.back().delta += ptrdiff_t(bytes.size())
+                            - ptrdiff_t(size);
+                    patches_.push_back(Patch{off, size, std::move(bytes)});
+                };
+                auto pop = [this, &levels]() {
+                    Level l = std::move(levels.back());
+                    levels.pop_back();
+                    ptrdiff_t d = l.delta;
+                    if (d && !l.unit.is_indefinite) {
+                        Unit u(l.unit);
+                        u.init_length(l.unit.length);
+                        // i.e. a non-minimal length encoding is kept
+                        // (if possible), as with the l_size attribute
+                        bool keep = l.unit.tl_size > u.tl_size;
+                        u.init_length(l.unit.length + d);
+                        if (keep && l.unit.tl_size > u.tl_size) {
+                            u.tl_size = l.unit.tl_size;
+                            u.is_long_definite = true;
+                        }
+                        string h(u.tl_size, '\0');
+                        u8 *o = reinterpret_cast<u8*>(&h[0]);
+                        u.write(o, o + h.size());
+                        d += ptrdiff_t(u.tl_size) - ptrdiff_t(l.unit.tl_size);
+                        patches_.push_back(Patch{l.off, l.unit.tl_size,
+                                std::move(h)});
+                    }
+                    if (!levels.empty())
+                        levels.back().delta += d;
+                };
+
+                TLC tlc;
+                for (;;) {
+                    size_t off = r.pos();
+                    if (!read_next(r, tlc))
+                        break;
+                    if (tlc.is_eoc()) {
+                        if (levels.empty() || !levels.back().unit.is_indefinite)
+                            throw Unexpected_EOC();
+                        pop();
+                    } else {
+                        levels.push_back(Level{tlc, off,
+                                off + tlc.tl_size + tlc.length,
+                                pargs_.translator.find(tlc.klasse, tlc.tag),
+                                0});
+                        bool removed = false;
+                        bool replaced = false;
+                        string text;
+                        for (size_t i = 0; i < ops_.size(); ++i) {
+                            auto &op = ops_[i];
+                            if (!matches(op.path, levels))
+                                continue;
+                            if (op.kind == Kind::REMOVE) {
+                                removed = true;
+                                break;
+                            }
+                            if (tlc.shape == Shape::CONSTRUCTED)
+                                throw runtime_error("can't replace the content"
+                                        " of a constructed element");
+                            if (!replaced)
+                                text = render(tlc);
+                            replaced = true;
+                            text = boost::regex_replace(text, regexes[i],
+                                    op.subst);
+                        }
+                        if (removed || replaced
+                                || tlc.shape == Shape::PRIMITIVE) {
+                            Level l = std::move(levels.back());
+                            levels.pop_back();
+                            if (removed) {
+                                size_t n = tlc.tl_size + tlc.length;
+                                if (tlc.shape == Shape::CONSTRUCTED) {
+                                    if (tlc.is_indefinite) {
+                                        // i.e. skip to the matching EOC
+                                        Unit u;
+                                        for (size_t depth = 1; depth; ) {
+                                            if (!read_next(r, u))
+                                                throw runtime_error(
+                                                    "indefinite tag is"
+                                                    " still open");
+                                            if (u.is_eoc())
+                                                --depth;
+                                            else if (u.is_indefinite)
+                                                ++depth;
+                                        }
+                                        n = r.pos() - off;
+                                    } else {
+                                        r.skip(tlc.length);
+                                    }
+                                }
+                                patch(off, n, string());
+                            } else if (replaced) {
+                                if (!l.name)
+                                    throw range_error("can't translate tag: "
+                                            + std::to_string(tlc.tag));
+                                patch(off, tlc.tl_size + tlc.length,
+                                        encode(*l.name, text));
+                            }
+                        }
+                    }
+                    while (!levels.empty() && !levels.back().unit.is_indefinite
+                            && r.pos() >= levels.back().end) {
+                        if (r.pos() > levels.back().end)
+                            throw range_error("element is longer than its"
+                                    " definite parent");
+                        pop();
+                    }
+                }
+                if (!levels.empty())
+                    throw overflow_error("some tags are still open");
+                // i.e. the header patch of a level is recorded after
+                // the patches of its descendants
+                sort(patches_.begin(), patches_.end(),
+                        [](const Patch &a, const Patch &b) {
+                            return a.off < b.off; });
+            }
+
+            void Editor::write(scratchpad::Simple_Reader<u8> &r,
+                    scratchpad::Simple_Writer<u8> &w) const
+            {
+                auto copy = [&w](const u8 *b, const u8 *e) { w.write(b, e); };
+                size_t pos = r.pos();
+                for (auto &p : patches_) {
+                    r.skip(p.off - pos, copy);
+                    auto b = reinterpret_cast<const u8*>(p.bytes.data());
+                    w.write(b, b + p.bytes.size());
+                    r.skip(p.size);
+                    pos = p.off + p.size;
+                }
+                while (r.next(1024 * 1024)) {
+                    auto &x = r.window();
+                    size_t k = x.second - x.first;
+                    w.write(x.first, x.second);
+                    r.forget(k);
+                }
+                w.flush();
+            }
+
+            size_t Editor::patches() const
+            {
+                return patches_.size();
+            }
+
+            void apply(const u8 *begin, const u8 *end,
+                    scratchpad::Simple_Writer<u8> &w,
+                    const std::vector<Op> &ops,
+                    const xml::Pretty_Writer_Arguments &pargs,
+                    const BER_Writer_Arguments &bargs)
+            {
+                Editor e(ops, pargs, bargs);
+                {
+                    auto r = scratchpad::mk_simple_reader(begin, end);
+                    e.scan(r);
+                }
+                auto r = scratchpad::mk_simple_reader(begin, end);
+                e.write(r, w);
+            }
+
+        } // namespace edit
+    } // namespace ber
+} // namespace xfsx
@@ -0,0 +1,105 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_BER_EDIT_HH
+#define XFSX_BER_EDIT_HH
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include "octet.hh"
+
+namespace xfsx {
+
+    namespace scratchpad {
+        template <typename Char> class Simple_Reader;
+        template <typename Char> class Simple_Writer;
+    }
+    namespace xml {
+        struct Pretty_Writer_Arguments;
+    }
+    class BER_Writer_Arguments;
+    struct TLC;
+
+    // Edits BER data without building a tree, for edit ops that are
+    // addressed by simple paths.
+    //
+    // The first pass (scan()) reads the input TLC by TLC and records
+    // a patch for each removed or replaced element. When a definite
+    // constructed tag that encloses edits is closed, a patch for its
+    // header (i.e. the new length) is recorded, as well. Thus, the
+    // memory usage is proportional to the nesting depth plus the
+    // number of edits.
+    //
+    // The second pass (write()) copies the untouched byte ranges
+    // verbatim and splices in the patches.
+    namespace ber {
+        namespace edit {
+
+            // i.e. /A/B/C or //B/C, where '*' matches any element
+            struct Path {
+                // i.e. the path starts with '//'
+                bool anywhere {false};
+                std::vector<std::string> steps;
+            };
+            // returns false if the XPath expression isn't a simple path
+            bool parse_path(const std::string &xpath, Path &path);
+
+            enum class Kind { REMOVE, REPLACE };
+
+            struct Op {
+                Kind kind {Kind::REMOVE};
+                Path path;
+                // replace the content of matching primitive elements,
+                // cf. boost::regex_replace()
+                std::string regex;
+                std::string subst;
+            };
+
+            class Editor {
+                public:
+                    // Elements are named via pargs.translator and their
+                    // content is rendered as text as in the XML output.
+                    // Replaced content is encoded via bargs.
+                    Editor(const std::vector<Op> &ops,
+                            const xml::Pretty_Writer_Arguments &pargs,
+                            const BER_Writer_Arguments &bargs);
+
+                    void scan(scratchpad::Simple_Reader<u8> &r);
+                    // r has to read the same input as the one
+                    // passed to scan()
+                    void write(scratchpad::Simple_Reader<u8> &r,
+                            scratchpad::Simple_Writer<u8> &w) const;
+
+                    size_t patches() const;
+                private:
+                    struct Patch {
+                        size_t off;
+                        // number of input bytes replaced
+                        size_t size;
+                        std::string bytes;
+                    };
+                    std::string render(const TLC &tlc) const;
+                    std::string encode(const std::string &name,
+                            const std::string &text) const;
+
+                    const std::vector<Op> &ops_;
+                    const xml::Pretty_Writer_Arguments &pargs_;
+                    const BER_Writer_Arguments &bargs_;
+                    // ordered by offset after scan()
+                    std::vector<Patch> patches_;
+            };
+
+            void apply(const u8 *begin, const u8 *end,
+                    scratchpad::Simple_Writer<u8> &w,
+                    const std::vector<Op> &ops,
+                    const xml::Pretty_Writer_Arguments &pargs,
+                    const BER_Writer_Arguments &bargs);
+
+        } // namespace edit
+    } // namespace ber
+
+} // namespace xfsx
+
+#endif // XFSX_BER_EDIT_HH
@@ -21,6 +21,8 @@
 #ifndef XFSX_BER_WRITER_ARGUMENTS_HH
 #define XFSX_BER_WRITER_ARGUMENTS_HH
 
+#include <vector>
+
 #include <xfsx/xfsx.hh>
 
 namespace xfsx {
@@ -30,6 +32,10 @@ namespace xfsx {
         xfsx::Name_Translator translator;
         xfsx::Tag_Dereferencer dereferencer;
         xfsx::Tag_Typifier typifier;
+        // i.e. encode the children of the definite element identified
+        // by split_path (of APPLICATION tags) with that many threads
+        unsigned threads {0};
+        std::vector<xfsx::Tag_Int> split_path;
     };
 
     extern BER_Writer_Arguments default_ber_writer_arguments;
@@ -30,12 +30,6 @@
 
 #include <ixxx/ixxx.hh>
 
-#if XFSX_HAVE_FROM_CHARS
-    #include <charconv>
-#else
-    #include <fmt/format.h>
-#endif
-
 using namespace std;
 
 namespace xfsx {
@@ -130,38 +124,9 @@ namespace xfsx {
       }
 
       template <typename T>
-      char *encode_int(T value, char *buffer, size_t n)
-      {
-#if XFSX_HAVE_FROM_CHARS
-          auto r = std::to_chars(buffer, buffer+n, value);
-          return r.ptr;
-#else
-          // copied and slightly adapted this encoding part from
-          // fmt/fmt/format/format.h:3425, format_decimal()
-          // https://github.com/fmtlib/fmt
-          // BSD 2-clause "Simplified" License
-        typedef typename fmt::internal::IntTraits<T>::MainType MainType;
-        MainType abs_value = static_cast<MainType>(value);
-        if (fmt::internal::is_negative(value)) {
-          *buffer++ = '-';
-          --n;
-          abs_value = 0 - abs_value;
-        }
-        if (abs_value < 100) {
-          if (abs_value < 10) {
-            *buffer++ = static_cast<char>('0' + abs_value);
-            return buffer;
-          }
-          unsigned index = static_cast<unsigned>(abs_value * 2);
-          *buffer++ = fmt::internal::Data::DIGITS[index];
-          *buffer++ = fmt::internal::Data::DIGITS[index + 1];
-          return buffer;
-        }
-        unsigned num_digits = n;
-        fmt::internal::format_decimal(buffer, abs_value, num_digits);
-        buffer += num_digits;
-        return buffer;
-#endif
+      char *encode_int(T value, char *buffer, size_t /*n*/)
+      {
+        return integer::format_dec(value, buffer);
       }
       template <> char *encode(uint32_t v, char *o, size_t n)
       {
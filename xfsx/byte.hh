@@ -26,6 +26,7 @@
 #include <ixxx/util.hh>
 
 #include "scratchpad.hh"
+#include "integer.hh"
 
 namespace xfsx {
 
@@ -110,6 +111,23 @@ namespace xfsx {
           b.w.commit_write(n);
           return b;
         }
+      // i.e. integers are formatted in one pass, directly into
+      // the reserved maximum
+      template <typename T>
+        inline Base &write_dec(Base &b, T v)
+        {
+          char *o = b.w.begin_write(integer::max_dec_size);
+          b.w.commit_write(integer::format_dec(v, o) - o);
+          return b;
+        }
+      inline Base &operator<<(Base &b, uint32_t v) { return write_dec(b, v); }
+      inline Base &operator<<(Base &b, uint64_t v) { return write_dec(b, v); }
+      inline Base &operator<<(Base &b, int32_t v) { return write_dec(b, v); }
+      inline Base &operator<<(Base &b, int64_t v) { return write_dec(b, v); }
+#if (defined(__APPLE__) && defined(__MACH__))
+      inline Base &operator<<(Base &b, size_t v) { return write_dec(b, v); }
+      inline Base &operator<<(Base &b, long v) { return write_dec(b, v); }
+#endif
       template <size_t N>
         inline Base &operator<<(Base &b, const char (&s)[N])
         {
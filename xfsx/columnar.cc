@@ -0,0 +1,628 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "columnar.hh"
+
+#include "xfsx.hh"
+#include "bcd.hh"
+#include "scratchpad.hh"
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+
+namespace xfsx {
+
+    namespace columnar {
+
+        static const char magic[] = "xfsxcol\x01";
+        static const size_t magic_size = sizeof magic - 1;
+
+        enum class Encoding : uint8_t {
+            EMPTY, INT_DELTA, STRING_PLAIN, STRING_DICT, DIGITS_DELTA,
+            LAST_
+        };
+
+        static void put_varint(string &o, uint64_t v)
+        {
+            while (v >= 0x80u) {
+                o.push_back(char(v | 0x80u));
+                v >>= 7;
+            }
+            o.push_back(char(v));
+        }
+        static uint64_t get_varint(const u8 *&p, const u8 *end)
+        {
+            uint64_t v = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                if (p == end)
+                    throw range_error("columnar: truncated varint");
+                u8 b = *p++;
+                v |= uint64_t(b & 0x7fu) << shift;
+                if (!(b & 0x80u))
+                    return v;
+            }
+            throw range_error("columnar: varint too long");
+        }
+        static uint64_t zigzag(int64_t v)
+        {
+            return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+        }
+        static int64_t unzigzag(uint64_t v)
+        {
+            return int64_t(v >> 1) ^ -int64_t(v & 1u);
+        }
+        static void put_string(string &o, const string &s)
+        {
+            put_varint(o, s.size());
+            o += s;
+        }
+        static pair<const char*, const char*> get_string(const u8 *&p,
+                const u8 *end)
+        {
+            size_t n = get_varint(p, end);
+            if (size_t(end - p) < n)
+                throw range_error("columnar: truncated string");
+            auto b = reinterpret_cast<const char*>(p);
+            p += n;
+            return make_pair(b, b + n);
+        }
+
+        // i.e. min/max are the first varints/strings of a chunk
+        template <typename T>
+        static bool range_may_match(const T &min, const T &max, Op op,
+                const T &x)
+        {
+            switch (op) {
+                case Op::EQ: return !(x < min) && !(max < x);
+                case Op::NE: return !(min == max && min == x);
+                case Op::LT: return min < x;
+                case Op::LE: return !(x < min);
+                case Op::GT: return x < max;
+                case Op::GE: return !(max < x);
+            }
+            return true;
+        }
+        template <typename T>
+        static bool compare(const T &a, Op op, const T &b)
+        {
+            switch (op) {
+                case Op::EQ: return a == b;
+                case Op::NE: return !(a == b);
+                case Op::LT: return a < b;
+                case Op::LE: return !(b < a);
+                case Op::GT: return b < a;
+                case Op::GE: return !(a < b);
+            }
+            return false;
+        }
+
+        static bool is_digits(const string &s)
+        {
+            return std::all_of(s.begin(), s.end(),
+                    [](char c) { return c >= '0' && c <= '9'; });
+        }
+        static int64_t digits_to_int64(const string &s)
+        {
+            int64_t r = 0;
+            for (char c : s)
+                r = r * 10 + (c - '0');
+            return r;
+        }
+
+        class Columnizer {
+            public:
+                Columnizer(scratchpad::Simple_Writer<char> &w,
+                        const xml::Pretty_Writer_Arguments &args,
+                        const vector<csv::Column> &columns,
+                        size_t block_rows);
+                void write_header();
+                void add(const vector<TLC> &values);
+                void flush_block();
+            private:
+                void assign(const TLC &t, Value &v);
+                void encode_chunk(const Value *vs, size_t n);
+                void encode_ints(const Value *vs, size_t n,
+                        const string &bitmap);
+                void encode_strings(const Value *vs, size_t n,
+                        const string &bitmap, size_t present);
+
+                scratchpad::Simple_Writer<char> &w_;
+                const xml::Pretty_Writer_Arguments &args_;
+                const vector<csv::Column> &columns_;
+                size_t block_rows_ {0};
+                size_t rows_ {0};
+                // i.e. values_[column][row]
+                vector<vector<Value>> values_;
+                // i.e. the kind of each column's values so far
+                vector<Kind> kinds_;
+                string block_;
+                string chunk_;
+                unordered_map<string, size_t> dict_;
+                vector<size_t> indices_;
+        };
+
+        Columnizer::Columnizer(scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const vector<csv::Column> &columns,
+                size_t block_rows)
+            :
+                w_(w),
+                args_(args),
+                columns_(columns),
+                block_rows_(block_rows),
+                values_(columns.size(), vector<Value>(block_rows)),
+                kinds_(columns.size(), Kind::NONE)
+        {
+            if (!block_rows)
+                throw range_error("columnar: block_rows must be positive");
+        }
+
+        void Columnizer::write_header()
+        {
+            string h(magic, magic + magic_size);
+            put_varint(h, columns_.size());
+            for (auto &c : columns_)
+                put_string(h, c.name);
+            w_.write(h.data(), h.data() + h.size());
+        }
+
+        void Columnizer::assign(const TLC &t, Value &v)
+        {
+            if (!t.begin) {
+                v.kind = Kind::NONE;
+                return;
+            }
+            const u8 *b = t.begin + t.tl_size;
+            Type type = Type::STRING;
+            if (!args_.translator.empty())
+                type = args_.typifier.typify(
+                        args_.dereferencer.dereference(t.klasse, t.tag));
+            switch (type) {
+                case Type::INT_64:
+                    if (!t.length) {
+                        v.kind = Kind::NONE;
+                        break;
+                    }
+                    v.kind = Kind::INT;
+                    xfsx::decode(b, t.length, v.i);
+                    break;
+                case Type::BCD:
+                    v.kind = Kind::STRING;
+                    v.s.resize(t.length * 2);
+                    if (t.length) {
+                        bcd::decode(b, b + t.length, &v.s[0]);
+                        if (v.s.back() == 'f')
+                            v.s.pop_back();
+                    }
+                    break;
+                case Type::STRING:
+                case Type::OCTET_STRING:
+                    v.kind = Kind::STRING;
+                    v.s.assign(reinterpret_cast<const char*>(b), t.length);
+                    break;
+            }
+        }
+
+        void Columnizer::add(const vector<TLC> &values)
+        {
+            for (size_t i = 0; i < values.size(); ++i) {
+                auto &v = values_[i][rows_];
+                assign(values[i], v);
+                if (v.kind == Kind::NONE)
+                    continue;
+                // i.e. a path that matches tags of different types,
+                // predicates on such a column would compare integers
+                // bytewise
+                if (kinds_[i] == Kind::NONE)
+                    kinds_[i] = v.kind;
+                else if (kinds_[i] != v.kind)
+                    throw runtime_error("columnar: column "
+                            + columns_[i].name
+                            + " matches integer and string fields");
+            }
+            ++rows_;
+            if (rows_ == block_rows_)
+                flush_block();
+        }
+
+        void Columnizer::encode_ints(const Value *vs, size_t n,
+                const string &bitmap)
+        {
+            int64_t min = numeric_limits<int64_t>::max();
+            int64_t max = numeric_limits<int64_t>::min();
+            for (size_t i = 0; i < n; ++i) {
+                if (vs[i].kind == Kind::NONE)
+                    continue;
+                min = std::min(min, vs[i].i);
+                max = std::max(max, vs[i].i);
+            }
+            put_varint(chunk_, zigzag(min));
+            put_varint(chunk_, zigzag(max));
+            chunk_ += bitmap;
+            uint64_t prev = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (vs[i].kind == Kind::NONE)
+                    continue;
+                // i.e. wraps around consistently
+                put_varint(chunk_, zigzag(int64_t(uint64_t(vs[i].i) - prev)));
+                prev = uint64_t(vs[i].i);
+            }
+        }
+
+        void Columnizer::encode_strings(const Value *vs, size_t n,
+                const string &bitmap, size_t present)
+        {
+            const string *min = nullptr;
+            const string *max = nullptr;
+            bool digits = true;
+            size_t width = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (vs[i].kind == Kind::NONE)
+                    continue;
+                auto &s = vs[i].s;
+                if (!min || s < *min)
+                    min = &s;
+                if (!max || *max < s)
+                    max = &s;
+                if (!width)
+                    width = s.size();
+                // i.e. fits into an int64_t
+                digits = digits && s.size() == width && width
+                    && width <= 18 && is_digits(s);
+            }
+            put_string(chunk_, *min);
+            put_string(chunk_, *max);
+            chunk_ += bitmap;
+            if (digits) {
+                chunk_.push_back(char(width));
+                uint64_t prev = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    if (vs[i].kind == Kind::NONE)
+                        continue;
+                    auto x = uint64_t(digits_to_int64(vs[i].s));
+                    put_varint(chunk_, zigzag(int64_t(x - prev)));
+                    prev = x;
+                }
+                block_.push_back(char(Encoding::DIGITS_DELTA));
+                return;
+            }
+            dict_.clear();
+            indices_.clear();
+            for (size_t i = 0; i < n; ++i) {
+                if (vs[i].kind == Kind::NONE)
+                    continue;
+                auto r = dict_.emplace(vs[i].s, dict_.size());
+                indices_.push_back(r.first->second);
+            }
+            if (dict_.size() * 2 <= present) {
+                vector<const string*> entries(dict_.size());
+                for (auto &e : dict_)
+                    entries[e.second] = &e.first;
+                put_varint(chunk_, entries.size());
+                for (auto e : entries)
+                    put_string(chunk_, *e);
+                for (auto k : indices_)
+                    put_varint(chunk_, k);
+                block_.push_back(char(Encoding::STRING_DICT));
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    if (vs[i].kind != Kind::NONE)
+                        put_string(chunk_, vs[i].s);
+                }
+                block_.push_back(char(Encoding::STRING_PLAIN));
+            }
+        }
+
+        void Columnizer::encode_chunk(const Value *vs, size_t n)
+        {
+            size_t ints = 0, strings = 0;
+            string bitmap((n + 7) / 8, '\0');
+            for (size_t i = 0; i < n; ++i) {
+                switch (vs[i].kind) {
+                    case Kind::NONE: continue;
+                    case Kind::INT: ++ints; break;
+                    case Kind::STRING: ++strings; break;
+                }
+                bitmap[i / 8] |= char(1u << (i % 8));
+            }
+            chunk_.clear();
+            if (!ints && !strings) {
+                block_.push_back(char(Encoding::EMPTY));
+            } else if (!strings) {
+                encode_ints(vs, n, bitmap);
+                block_.push_back(char(Encoding::INT_DELTA));
+            } else {
+                encode_strings(vs, n, bitmap, strings);
+            }
+            put_varint(block_, chunk_.size());
+            block_ += chunk_;
+        }
+
+        void Columnizer::flush_block()
+        {
+            if (!rows_)
+                return;
+            block_.clear();
+            for (auto &vs : values_)
+                encode_chunk(vs.data(), rows_);
+            string h;
+            put_varint(h, rows_);
+            put_varint(h, block_.size());
+            w_.write(h.data(), h.data() + h.size());
+            w_.write(block_.data(), block_.data() + block_.size());
+            rows_ = 0;
+        }
+
+        void write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<csv::Column> &columns,
+                size_t block_rows)
+        {
+            Columnizer c(w, args, columns, block_rows);
+            c.write_header();
+            csv::for_each_record(r, args, columns,
+                    [&c](const vector<TLC> &values) { c.add(values); });
+            c.flush_block();
+            w.flush();
+        }
+        void write(const u8 *begin, const u8 *end,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<csv::Column> &columns,
+                size_t block_rows)
+        {
+            auto r = scratchpad::mk_simple_reader(begin, end);
+            write(r, w, args, columns, block_rows);
+        }
+
+
+        struct Chunk {
+            Encoding encoding {Encoding::EMPTY};
+            const u8 *begin {nullptr};
+            const u8 *end {nullptr};
+        };
+
+        struct Condition {
+            size_t column {0};
+            Op op {Op::EQ};
+            string s;
+            bool is_int {false};
+            int64_t i {0};
+        };
+
+        static bool may_match(const Chunk &c, const Condition &p)
+        {
+            const u8 *q = c.begin;
+            switch (c.encoding) {
+                case Encoding::EMPTY:
+                    return false;
+                case Encoding::INT_DELTA: {
+                    int64_t min = unzigzag(get_varint(q, c.end));
+                    int64_t max = unzigzag(get_varint(q, c.end));
+                    return !p.is_int || range_may_match(min, max, p.op, p.i);
+                    }
+                default: {
+                    auto a = get_string(q, c.end);
+                    auto b = get_string(q, c.end);
+                    return range_may_match(string(a.first, a.second),
+                            string(b.first, b.second), p.op, p.s);
+                    }
+            }
+        }
+
+        static bool matches(const Value &v, const Condition &p)
+        {
+            switch (v.kind) {
+                case Kind::NONE:
+                    return false;
+                case Kind::INT:
+                    if (p.is_int)
+                        return compare(v.i, p.op, p.i);
+                    return compare(to_string(v.i), p.op, p.s);
+                case Kind::STRING:
+                    return compare(v.s, p.op, p.s);
+            }
+            return false;
+        }
+
+        static void decode(const Chunk &c, size_t rows, vector<Value> &vs)
+        {
+            vs.resize(rows);
+            for (auto &v : vs)
+                v.kind = Kind::NONE;
+            if (c.encoding == Encoding::EMPTY)
+                return;
+            const u8 *q = c.begin;
+            if (c.encoding == Encoding::INT_DELTA) {
+                get_varint(q, c.end);
+                get_varint(q, c.end);
+            } else {
+                get_string(q, c.end);
+                get_string(q, c.end);
+            }
+            size_t n = (rows + 7) / 8;
+            if (size_t(c.end - q) < n)
+                throw range_error("columnar: truncated bitmap");
+            const u8 *bitmap = q;
+            q += n;
+            auto present = [bitmap](size_t i) {
+                return bitmap[i / 8] & (1u << (i % 8)); };
+            switch (c.encoding) {
+                case Encoding::INT_DELTA: {
+                    uint64_t prev = 0;
+                    for (size_t i = 0; i < rows; ++i) {
+                        if (!present(i))
+                            continue;
+                        prev += uint64_t(unzigzag(get_varint(q, c.end)));
+                        vs[i].kind = Kind::INT;
+                        vs[i].i = int64_t(prev);
+                    }
+                    } break;
+                case Encoding::DIGITS_DELTA: {
+                    if (q == c.end)
+                        throw range_error("columnar: truncated chunk");
+                    size_t width = *q++;
+                    uint64_t prev = 0;
+                    for (size_t i = 0; i < rows; ++i) {
+                        if (!present(i))
+                            continue;
+                        prev += uint64_t(unzigzag(get_varint(q, c.end)));
+                        auto &s = vs[i].s;
+                        s.resize(width);
+                        uint64_t x = prev;
+                        for (size_t k = width; k; --k) {
+                            s[k - 1] = char('0' + x % 10);
+                            x /= 10;
+                        }
+                        vs[i].kind = Kind::STRING;
+                    }
+                    } break;
+                case Encoding::STRING_DICT: {
+                    size_t k = get_varint(q, c.end);
+                    vector<pair<const char*, const char*>> dict;
+                    dict.reserve(std::min(k, size_t(c.end - q)));
+                    for (size_t i = 0; i < k; ++i)
+                        dict.push_back(get_string(q, c.end));
+                    for (size_t i = 0; i < rows; ++i) {
+                        if (!present(i))
+                            continue;
+                        size_t j = get_varint(q, c.end);
+                        if (j >= dict.size())
+                            throw range_error("columnar: invalid dictionary "
+                                    "index");
+                        vs[i].s.assign(dict[j].first, dict[j].second);
+                        vs[i].kind = Kind::STRING;
+                    }
+                    } break;
+                case Encoding::STRING_PLAIN:
+                    for (size_t i = 0; i < rows; ++i) {
+                        if (!present(i))
+                            continue;
+                        auto s = get_string(q, c.end);
+                        vs[i].s.assign(s.first, s.second);
+                        vs[i].kind = Kind::STRING;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        Reader::Reader(const u8 *begin, const u8 *end)
+            :
+                end_(end)
+        {
+            if (size_t(end - begin) < magic_size
+                    || memcmp(begin, magic, magic_size))
+                throw runtime_error("not a columnar archive");
+            const u8 *p = begin + magic_size;
+            size_t n = get_varint(p, end);
+            for (size_t i = 0; i < n; ++i) {
+                auto s = get_string(p, end);
+                columns_.emplace_back(s.first, s.second);
+            }
+            begin_ = p;
+        }
+
+        const std::vector<std::string> &Reader::columns() const
+        {
+            return columns_;
+        }
+        size_t Reader::decoded_blocks() const
+        {
+            return decoded_blocks_;
+        }
+        size_t Reader::skipped_blocks() const
+        {
+            return skipped_blocks_;
+        }
+
+        void Reader::scan(const std::vector<std::string> &columns,
+                const std::vector<Predicate> &predicates,
+                const std::function<void(const std::vector<Value> &)> &f)
+        {
+            auto index = [this](const string &name) {
+                auto i = find(columns_.begin(), columns_.end(), name);
+                if (i == columns_.end())
+                    throw range_error("unknown column: " + name);
+                return size_t(i - columns_.begin());
+            };
+            vector<bool> needed(columns_.size());
+            vector<size_t> selected;
+            for (auto &c : columns) {
+                selected.push_back(index(c));
+                needed[selected.back()] = true;
+            }
+            vector<Condition> conditions;
+            for (auto &p : predicates) {
+                Condition c;
+                c.column = index(p.column);
+                c.op = p.op;
+                c.s = p.value;
+                try {
+                    c.i = boost::lexical_cast<int64_t>(p.value);
+                    c.is_int = true;
+                } catch (const boost::bad_lexical_cast &) {
+                }
+                needed[c.column] = true;
+                conditions.push_back(std::move(c));
+            }
+
+            decoded_blocks_ = 0;
+            skipped_blocks_ = 0;
+            vector<Chunk> chunks(columns_.size());
+            vector<vector<Value>> values(columns_.size());
+            vector<Value> row(selected.size());
+            for (const u8 *p = begin_; p != end_; ) {
+                size_t rows = get_varint(p, end_);
+                size_t n = get_varint(p, end_);
+                if (size_t(end_ - p) < n)
+                    throw range_error("columnar: truncated block");
+                const u8 *block_end = p + n;
+                for (auto &c : chunks) {
+                    if (p == block_end || *p >= u8(Encoding::LAST_))
+                        throw range_error("columnar: invalid chunk");
+                    c.encoding = Encoding(*p++);
+                    size_t m = get_varint(p, block_end);
+                    if (size_t(block_end - p) < m)
+                        throw range_error("columnar: truncated chunk");
+                    c.begin = p;
+                    c.end = p + m;
+                    p += m;
+                }
+                p = block_end;
+                if (!all_of(conditions.begin(), conditions.end(),
+                            [&chunks](const Condition &c) {
+                                return may_match(chunks[c.column], c); })) {
+                    ++skipped_blocks_;
+                    continue;
+                }
+                ++decoded_blocks_;
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    if (needed[i])
+                        decode(chunks[i], rows, values[i]);
+                }
+                for (size_t r = 0; r < rows; ++r) {
+                    if (!all_of(conditions.begin(), conditions.end(),
+                                [&values, r](const Condition &c) {
+                                    return matches(values[c.column][r], c);
+                                }))
+                        continue;
+                    for (size_t k = 0; k < selected.size(); ++k)
+                        row[k] = values[selected[k]][r];
+                    f(row);
+                }
+            }
+        }
+
+    } // columnar
+
+} // xfsx
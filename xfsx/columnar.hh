@@ -0,0 +1,105 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_COLUMNAR_HH
+#define XFSX_COLUMNAR_HH
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <xfsx/ber2csv.hh>
+
+namespace xfsx {
+    namespace scratchpad {
+        template<typename Char> class Simple_Reader;
+        template<typename Char> class Simple_Writer;
+    }
+
+    // A columnar archive of selected CDR fields, e.g. for repeatedly
+    // querying a few fields of many TAP files without decoding them
+    // again.
+    //
+    // The archive consists of a header (magic, column names) and a
+    // sequence of blocks. Each block holds up to block_rows records
+    // and one chunk per column. A chunk starts with the min/max values
+    // of its column (in that block) and a presence bitmap, followed by
+    // the encoded values:
+    //
+    // - integers are delta encoded (zig-zag varints)
+    // - strings of equal length that only consist of digits (e.g.
+    //   timestamps, IMSIs) are delta encoded as integers
+    // - other strings are dictionary encoded (e.g. TADIG codes,
+    //   service codes) if they repeat enough, otherwise they are
+    //   stored as is
+    //
+    // Since each block and chunk is prefixed with its size, a reader
+    // only decodes the selected columns of the blocks whose statistics
+    // may satisfy the predicates.
+    namespace columnar {
+
+        enum class Kind : uint8_t { NONE, INT, STRING };
+
+        struct Value {
+            // i.e. NONE means that the record doesn't contain the field
+            Kind kind {Kind::NONE};
+            int64_t i {0};
+            std::string s;
+        };
+
+        // Values are typed via args.dereferencer/args.typifier, i.e.
+        // INT_64 as integers, BCD as digit strings and everything
+        // else as byte strings. Throws if a column matches both
+        // integers and strings (e.g. tags of different classes).
+        void write(scratchpad::Simple_Reader<u8> &r,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<csv::Column> &columns,
+                size_t block_rows = 4096);
+        void write(const u8 *begin, const u8 *end,
+                scratchpad::Simple_Writer<char> &w,
+                const xml::Pretty_Writer_Arguments &args,
+                const std::vector<csv::Column> &columns,
+                size_t block_rows = 4096);
+
+        enum class Op { EQ, NE, LT, LE, GT, GE };
+
+        // The value is compared numerically with integer columns and
+        // bytewise with string columns. A missing field never
+        // satisfies a predicate.
+        struct Predicate {
+            std::string column;
+            Op op {Op::EQ};
+            std::string value;
+        };
+
+        class Reader {
+            public:
+                // throws if [begin, end) doesn't start with a header
+                Reader(const u8 *begin, const u8 *end);
+
+                const std::vector<std::string> &columns() const;
+
+                // Calls f for each record that satisfies all predicates,
+                // where row[i] is the value of columns[i].
+                void scan(const std::vector<std::string> &columns,
+                        const std::vector<Predicate> &predicates,
+                        const std::function<void(const std::vector<Value> &)>
+                            &f);
+
+                // i.e. of the last scan()
+                size_t decoded_blocks() const;
+                size_t skipped_blocks() const;
+            private:
+                const u8 *begin_ {nullptr};
+                const u8 *end_ {nullptr};
+                std::vector<std::string> columns_;
+                size_t decoded_blocks_ {0};
+                size_t skipped_blocks_ {0};
+        };
+
+    } // columnar
+
+} // xfsx
+
+#endif // XFSX_COLUMNAR_HH
@@ -0,0 +1,129 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "gather_writer.hh"
+
+#include <assert.h>
+
+namespace xfsx {
+
+    Gather_Writer::Gather_Writer(scratchpad::Simple_Writer<u8> &out)
+        :
+            out_(out),
+            pad_(scratchpad::mk_simple_writer<u8>())
+    {
+    }
+
+    scratchpad::Simple_Writer<u8> &Gather_Writer::top()
+    {
+        return levels_top_ ? pad_ : out_;
+    }
+    size_t Gather_Writer::depth() const
+    {
+        return levels_top_;
+    }
+    size_t Gather_Writer::length() const
+    {
+        assert(levels_top_);
+        auto &l = levels_[levels_top_-1];
+        return l.length + (pad_.pos() - l.run_start);
+    }
+
+    void Gather_Writer::append(Level &l, size_t off, size_t len)
+    {
+        if (!len)
+            return;
+        if (l.tail != npos) {
+            auto &t = segments_[l.tail];
+            if (t.off + t.len == off) {
+                t.len += len;
+                l.length += len;
+                return;
+            }
+        }
+        segments_.push_back(Segment{off, len, npos});
+        size_t i = segments_.size() - 1;
+        if (l.tail == npos)
+            l.head = i;
+        else
+            segments_[l.tail].next = i;
+        l.tail = i;
+        l.length += len;
+    }
+    void Gather_Writer::close_run(Level &l)
+    {
+        size_t pos = pad_.pos();
+        append(l, l.run_start, pos - l.run_start);
+        l.run_start = pos;
+    }
+
+    void Gather_Writer::push()
+    {
+        if (levels_top_)
+            close_run(levels_[levels_top_-1]);
+        Level l{npos, npos, pad_.pos(), 0};
+        if (levels_top_ < levels_.size())
+            levels_[levels_top_] = l;
+        else
+            levels_.push_back(l);
+        ++levels_top_;
+    }
+
+    scratchpad::Simple_Writer<u8> &Gather_Writer::begin_pop()
+    {
+        assert(levels_top_);
+        close_run(levels_[levels_top_-1]);
+        header_start_ = pad_.pos();
+        return levels_top_ > 1 ? pad_ : out_;
+    }
+    void Gather_Writer::end_pop()
+    {
+        assert(levels_top_);
+        --levels_top_;
+        const Level &child = levels_[levels_top_];
+        if (levels_top_) {
+            auto &parent = levels_[levels_top_-1];
+            size_t pos = pad_.pos();
+            // the header was appended behind the child's content
+            // thus, it can't be merged with the last child segment
+            segments_.push_back(Segment{header_start_, pos - header_start_,
+                    child.head});
+            size_t i = segments_.size() - 1;
+            if (parent.tail == npos)
+                parent.head = i;
+            else
+                segments_[parent.tail].next = i;
+            parent.tail = child.tail == npos ? i : child.tail;
+            parent.length += (pos - header_start_) + child.length;
+            parent.run_start = pos;
+        } else {
+            emit(child);
+            pad_.clear();
+            segments_.clear();
+        }
+    }
+
+    void Gather_Writer::emit(const Level &l)
+    {
+        pad_.flush();
+        auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
+                pad_.backend())->pad();
+        const u8 *base = pad.prelude();
+        iov_.clear();
+        for (size_t i = l.head; i != npos; i = segments_[i].next) {
+            auto &s = segments_[i];
+            const u8 *b = base + s.off;
+            if (!iov_.empty() && iov_.back().second == b)
+                iov_.back().second += s.len;
+            else
+                iov_.emplace_back(b, b + s.len);
+        }
+        out_.gather_write(iov_.data(), iov_.size());
+    }
+
+    void Gather_Writer::flush()
+    {
+        out_.flush();
+    }
+
+} // namespace xfsx
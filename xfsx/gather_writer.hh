@@ -0,0 +1,78 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_GATHER_WRITER_HH
+#define XFSX_GATHER_WRITER_HH
+
+#include <vector>
+#include <utility>
+#include <stddef.h>
+
+#include "scratchpad.hh"
+#include "octet.hh"
+
+namespace xfsx {
+
+    // Writes nested definite length constructed tags without copying
+    // the content of each level into its parent.
+    //
+    // The content of all open levels goes into one scratchpad.
+    // Each level records the byte ranges it owns as a chain of segments.
+    // When a level is closed, the tag/length header is appended to the
+    // scratchpad and the chain is spliced into the parent chain, behind
+    // the header. When the outermost level is closed, its header is
+    // written to the output writer and the segments are gathered
+    // with writev() (or copied, for non-file writers).
+    class Gather_Writer {
+        public:
+            Gather_Writer(scratchpad::Simple_Writer<u8> &out);
+
+            // writer for the current level, i.e. the scratchpad
+            // or the output writer if no level is open
+            scratchpad::Simple_Writer<u8> &top();
+            // number of open levels
+            size_t depth() const;
+            // content length of the innermost open level
+            size_t length() const;
+
+            // open a new level
+            void push();
+            // returns the writer the header of the innermost
+            // level has to be written to ...
+            scratchpad::Simple_Writer<u8> &begin_pop();
+            // ... and close it, after the header is written
+            void end_pop();
+
+            void flush();
+        private:
+            static constexpr size_t npos = size_t(-1);
+            struct Segment {
+                size_t off;
+                size_t len;
+                size_t next;
+            };
+            struct Level {
+                size_t head;
+                size_t tail;
+                // start of the range written after the last child
+                size_t run_start;
+                // length of all segments of the chain
+                size_t length;
+            };
+            void append(Level &l, size_t off, size_t len);
+            void close_run(Level &l);
+            void emit(const Level &l);
+
+            scratchpad::Simple_Writer<u8> &out_;
+            scratchpad::Simple_Writer<u8> pad_;
+            std::vector<Segment> segments_;
+            // levels are reused, i.e. they aren't popped
+            std::vector<Level> levels_;
+            size_t levels_top_ {0};
+            size_t header_start_ {0};
+            std::vector<std::pair<const u8*, const u8*>> iov_;
+    };
+
+} // namespace xfsx
+
+#endif // XFSX_GATHER_WRITER_HH
@@ -42,6 +42,18 @@ namespace xfsx {
         const u8 *begin, const u8 *end);
     template size_t decoded_size<Style::Raw>(
         const u8 *begin, const u8 *end);
+    template size_t decoded_size<Style::JSON>(
+        const u8 *begin, const u8 *end);
+
+    template <typename Style_Tag>
+    size_t max_decoded_size(size_t n)
+    {
+      return impl::max_decoded_size<Style_Tag>(n);
+    }
+    template size_t max_decoded_size<Style::XML>(size_t n);
+    template size_t max_decoded_size<Style::C>(size_t n);
+    template size_t max_decoded_size<Style::Raw>(size_t n);
+    template size_t max_decoded_size<Style::JSON>(size_t n);
 
     template <typename Style_Tag>
     char *decode(const u8 *begin, const u8 *end, char *o)
@@ -54,6 +66,8 @@ namespace xfsx {
         const u8 *begin, const u8 *end, char *o);
     template char *decode<Style::Raw>(
         const u8 *begin, const u8 *end, char *o);
+    template char *decode<Style::JSON>(
+        const u8 *begin, const u8 *end, char *o);
 
     template <typename Style_Tag>
       u8 *encode(const char *begin, const char *end, u8 *o)
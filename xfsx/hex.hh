@@ -50,11 +50,19 @@ namespace xfsx {
         struct C {};
 
         struct Raw {};
+
+        // i.e. the content of a JSON string where '"', '\\' and
+        // non-printable bytes are escaped as \u00XX
+        struct JSON {};
       };
 
 
     template <typename Style_Tag>
       size_t decoded_size(const uint8_t *begin, const uint8_t *end);
+    // upper bound of decoded_size() for n input bytes,
+    // e.g. for reserving the output buffer without scanning the input twice
+    template <typename Style_Tag>
+      size_t max_decoded_size(size_t n);
     template <typename Style_Tag>
       char *decode(const uint8_t *begin, const uint8_t *end, char *o);
     template <typename Style_Tag>
@@ -27,6 +27,13 @@
 #include <stdint.h>
 #include <boost/regex.hpp>
 
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+    #include <immintrin.h>
+#endif
+
 #include "bcd_impl.hh"
 #include "octet.hh"
 
@@ -58,6 +65,11 @@ namespace xfsx {
         template <> struct Base<Style::Raw> {
           bool operator()(u8) const { return false; }
         };
+        template <> struct Base<Style::JSON> {
+          bool operator()(u8 b) const {
+            return char(b) == '"' || char(b) == '\\';
+          }
+        };
       }
 
       template <typename Style_Tag> struct Is_Normal {
@@ -119,6 +131,23 @@ namespace xfsx {
           constexpr size_t suffix_size() const { return 0u; }
         };
 
+        template <> struct Base<Style::JSON> {
+          char *prefix(char *o) const
+          {
+            *o++ = '\\';
+            *o++ = 'u';
+            *o++ = '0';
+            *o++ = '0';
+            return o;
+          }
+          constexpr size_t prefix_size() const { return 4u; }
+          char *suffix(char *o) const
+          {
+            return o;
+          }
+          constexpr size_t suffix_size() const { return 0u; }
+        };
+
         template <> struct Base<Style::Raw> {
           char *prefix(char *o) const
           {
@@ -152,10 +181,121 @@ namespace xfsx {
           }
         };
 
+#ifdef __SSE2__
+      // Bit i is set iff x[i] isn't Is_Normal<Style::XML>, i.e. it
+      // is outside of [32, 127) or one of &<>.
+      // Bytes >= 128 are negative in the signed comparison.
+      inline unsigned not_normal_mask_xml(__m128i x)
+      {
+        __m128i printable = _mm_and_si128(
+            _mm_cmpgt_epi8(x, _mm_set1_epi8(31)),
+            _mm_cmplt_epi8(x, _mm_set1_epi8(127)));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(
+              _mm_cmpeq_epi8(x, _mm_set1_epi8('&')),
+              _mm_cmpeq_epi8(x, _mm_set1_epi8('<'))),
+            _mm_cmpeq_epi8(x, _mm_set1_epi8('>')));
+        return unsigned(_mm_movemask_epi8(_mm_andnot_si128(special,
+                printable))) ^ 0xffffu;
+      }
+#endif // __SSE2__
+#ifdef __AVX2__
+      inline uint32_t not_normal_mask_xml(__m256i x)
+      {
+        __m256i printable = _mm256_andnot_si256(
+            _mm256_cmpgt_epi8(x, _mm256_set1_epi8(126)),
+            _mm256_cmpgt_epi8(x, _mm256_set1_epi8(31)));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(
+              _mm256_cmpeq_epi8(x, _mm256_set1_epi8('&')),
+              _mm256_cmpeq_epi8(x, _mm256_set1_epi8('<'))),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('>')));
+        return ~uint32_t(_mm256_movemask_epi8(_mm256_andnot_si256(special,
+                printable)));
+      }
+#endif // __AVX2__
+
+      template <typename Style_Tag>
+        struct Count_Not_Normal {
+          size_t operator()(const u8 *begin, const u8 *end) const
+          {
+            return std::count_if(begin, end, Is_Not_Normal<Style_Tag>());
+          }
+        };
+#ifdef __SSE2__
+      template <> struct Count_Not_Normal<Style::XML> {
+        size_t operator()(const u8 *begin, const u8 *end) const
+        {
+          size_t n = 0;
+          for (; end - begin >= 16; begin += 16) {
+            __m128i x = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(begin));
+            n += __builtin_popcount(not_normal_mask_xml(x));
+          }
+          return n + std::count_if(begin, end,
+              Is_Not_Normal<Style::XML>());
+        }
+      };
+#endif // __SSE2__
+
+      // Copy the leading run of normal bytes, i.e. returns the
+      // first byte that needs escaping and the new output position.
+      template <typename Style_Tag>
+        struct Copy_Normal {
+          std::pair<const u8*, char*> operator()(const u8 *begin,
+              const u8 *end, char *o) const
+          {
+            auto i = std::find_if_not(begin, end, Is_Normal<Style_Tag>());
+            o = std::copy(begin, i, o);
+            return std::make_pair(i, o);
+          }
+        };
+#ifdef __SSE2__
+      // Always stores whole vectors - even if the run ends inside of one.
+      // This doesn't overflow the output since each input byte is
+      // decoded to at least one output byte, i.e. at least as many bytes as
+      // are left in the input are still available in the output.
+      template <> struct Copy_Normal<Style::XML> {
+        std::pair<const u8*, char*> operator()(const u8 *begin,
+            const u8 *end, char *o) const
+        {
+#ifdef __AVX2__
+          while (end - begin >= 32) {
+            __m256i x = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(begin));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(o), x);
+            uint32_t m = not_normal_mask_xml(x);
+            if (m) {
+              unsigned k = __builtin_ctz(m);
+              return std::make_pair(begin + k, o + k);
+            }
+            begin += 32;
+            o += 32;
+          }
+#endif // __AVX2__
+          while (end - begin >= 16) {
+            __m128i x = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(begin));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o), x);
+            unsigned m = not_normal_mask_xml(x);
+            if (m) {
+              unsigned k = __builtin_ctz(m);
+              return std::make_pair(begin + k, o + k);
+            }
+            begin += 16;
+            o += 16;
+          }
+          auto i = std::find_if_not(begin, end, Is_Normal<Style::XML>());
+          o = std::copy(begin, i, o);
+          return std::make_pair(i, o);
+        }
+      };
+#endif // __SSE2__
+
       template <typename Style_Tag>
         size_t count_decode_overhead(const u8 *begin, const u8 *end)
         {
-          return std::count_if(begin, end, Is_Not_Normal<Style_Tag>())
+          return Count_Not_Normal<Style_Tag>()(begin, end)
             * Overhead<Style_Tag>()();
         }
       template <typename Style_Tag>
@@ -195,19 +335,52 @@ namespace xfsx {
                    return std::make_pair(begin, o_begin);
                  }
 
+      // i.e. when each byte needs to be escaped
+      template <typename Style_Tag>
+        constexpr size_t max_decoded_size(size_t n)
+        {
+          return n * Overhead<Style_Tag>()() + n;
+        }
+
       template <typename Style_Tag>
         char *decode(const u8 *begin, const u8 *end, char *o)
         {
           const u8 *i = begin;
           auto io = std::make_pair(i, o);
           do {
-            io = copy_while(io.first, end, io.second, Is_Normal<Style_Tag>());
+            io = Copy_Normal<Style_Tag>()(io.first, end, io.second);
             io = translate_while(io.first, end, io.second,
                 Escape<Style_Tag>(), Is_Not_Normal<Style_Tag>());
           } while (io.first < end);
           return io.second;
         }
 
+      // i.e. the first '&' in [begin, end) or end
+      inline const char *find_amp(const char *begin, const char *end)
+      {
+#ifdef __AVX2__
+        for (; end - begin >= 32; begin += 32) {
+          __m256i x = _mm256_loadu_si256(
+              reinterpret_cast<const __m256i*>(begin));
+          uint32_t m = _mm256_movemask_epi8(
+              _mm256_cmpeq_epi8(x, _mm256_set1_epi8('&')));
+          if (m)
+            return begin + __builtin_ctz(m);
+        }
+#endif // __AVX2__
+#ifdef __SSE2__
+        for (; end - begin >= 16; begin += 16) {
+          __m128i x = _mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(begin));
+          unsigned m = _mm_movemask_epi8(
+              _mm_cmpeq_epi8(x, _mm_set1_epi8('&')));
+          if (m)
+            return begin + __builtin_ctz(m);
+        }
+#endif // __SSE2__
+        return std::find(begin, end, '&');
+      }
+
       namespace Next_Quoted {
         namespace Tag {
           struct Regex{};
@@ -247,20 +420,21 @@ namespace xfsx {
         // Using the search() algorithm is twice as fast
         // in comparison to boost regex.
 
+        // Only the '&' has to be located since a reference is always
+        // introduced by it, i.e. the clean runs in between are skipped
+        // a vector at a time.
         template <> struct Base<Style::XML, Tag::Search> {
           const char *operator()(const char *begin, const char *end)
           {
             auto p = begin;
-            while (p < end) {
-              const char start[] = "&#x";
-              p = std::search(p, end, start, start + sizeof(start) - 1);
+            for (;;) {
+              p = find_amp(p, end);
               if (end-p < 6)
                 return end;
-              if (p[5] == ';')
+              if (p[1] == '#' && p[2] == 'x' && p[5] == ';')
                 return p;
-              p += 3;
+              ++p;
             }
-            return end;
           }
         };
         template <> struct Base<Style::C, Tag::Search> {
@@ -20,14 +20,14 @@
 }}} */
 #include "integer.hh"
 
-#if XFSX_HAVE_FROM_CHARS
-    #include <charconv>
-#else
-    #include <boost/spirit/include/qi_parse.hpp>
-    #include <boost/spirit/include/qi_auto.hpp>
-    #include <boost/spirit/include/qi_numeric.hpp>
+#include <string.h>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
 #endif
 
+#include <limits>
+
 // Alternatives are:
 //
 // 1) boost lexical cast
@@ -60,44 +60,281 @@
 //
 //  only available since C++17, also allows for efficient implementations
 //
-//  Conclusion: use from_chars() where available, qi-parse otherwise.
+//  5) SWAR
+//
+//  i.e. validate and convert 8 digits at a time in a 64 bit register,
+//  no library support needed, faster than 4) for longer values
+//
+//  Conclusion: use SWAR on little-endian targets, a digit loop otherwise.
+//  As with from_chars(), the leading digits are converted and a value that
+//  doesn't start with a digit or overflows yields 0.
 
 namespace xfsx {
 
   namespace integer {
 
-    uint32_t range_to_uint32(const std::pair<const char*, const char*> &p)
+    static const char dec_pairs[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    // i.e. the digits end at e
+    static char *format_dec_rev(uint64_t v, char *e)
+    {
+      while (v >= 100) {
+        auto i = (v % 100) * 2;
+        v /= 100;
+        e -= 2;
+        memcpy(e, dec_pairs + i, 2);
+      }
+      if (v >= 10) {
+        e -= 2;
+        memcpy(e, dec_pairs + v * 2, 2);
+      } else {
+        *--e = char('0' + v);
+      }
+      return e;
+    }
+
+#ifdef __SSE2__
+    // Returns the digits of v < 10^8 in 8 16 bit lanes, most
+    // significant first, i.e. divisions by constants are replaced
+    // with multiplications,
+    // cf. https://github.com/miloyip/itoa-benchmark (sse2.cpp)
+    static __m128i dec8_sse2(uint32_t v)
+    {
+      // abcd, efgh = abcdefgh divmod 10000
+      const __m128i abcdefgh = _mm_cvtsi32_si128(int(v));
+      const __m128i abcd = _mm_srli_epi64(_mm_mul_epu32(abcdefgh,
+            _mm_set1_epi32(int(0xd1b71759))), 45);
+      const __m128i efgh = _mm_sub_epi32(abcdefgh,
+          _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+      // [abcd, efgh, 0, ...] * 4
+      const __m128i v1 = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+      // [abcd * 4 (x4), efgh * 4 (x4)]
+      const __m128i v2a = _mm_unpacklo_epi16(v1, v1);
+      const __m128i v2 = _mm_unpacklo_epi32(v2a, v2a);
+      // divided by 10^3, 10^2, 10^1, 10^0, i.e.
+      // [a, ab, abc, abcd, e, ef, efg, efgh]
+      const __m128i v3 = _mm_mulhi_epu16(v2,
+          _mm_setr_epi16(8389, 5243, 13108, short(32768),
+                         8389, 5243, 13108, short(32768)));
+      const __m128i v4 = _mm_mulhi_epu16(v3,
+          _mm_setr_epi16(1 << 7, 1 << 11, 1 << 13, short(1 << 15),
+                         1 << 7, 1 << 11, 1 << 13, short(1 << 15)));
+      // [0, a0, ab0, abc0, 0, e0, ef0, efg0]
+      const __m128i v5 = _mm_slli_epi64(
+          _mm_mullo_epi16(v4, _mm_set1_epi16(10)), 16);
+      return _mm_sub_epi16(v4, v5);
+    }
+    // i.e. for v >= 10^15
+    static char *format_dec16_sse2(uint64_t v, char *o)
+    {
+      const uint64_t e16 = 10000000000000000lu;
+      if (v >= e16) {
+        char b[4];
+        char *p = format_dec_rev(v / e16, b + sizeof b);
+        size_t n = b + sizeof b - p;
+        memcpy(o, p, n);
+        o += n;
+        v %= e16;
+      }
+      const __m128i a = dec8_sse2(uint32_t(v / 100000000));
+      const __m128i b = dec8_sse2(uint32_t(v % 100000000));
+      const __m128i x = _mm_add_epi8(_mm_packus_epi16(a, b),
+          _mm_set1_epi8('0'));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(o), x);
+      return o + 16;
+    }
+#endif // __SSE2__
+
+    char *format_dec(uint64_t v, char *o)
     {
-      uint32_t t = 0;
-#if XFSX_HAVE_FROM_CHARS
-      std::from_chars(p.first, p.second, t);
-#else
-      boost::spirit::qi::parse(p.first, p.second, t);
+#ifdef __SSE2__
+      if (v >= 1000000000000000lu)
+        return format_dec16_sse2(v, o);
+#endif
+      // i.e. branch-free via count-leading-zeros
+      size_t n = dec_digits(v);
+      format_dec_rev(v, o + n);
+      return o + n;
+    }
+    char *format_dec(uint32_t v, char *o)
+    {
+      return format_dec(uint64_t(v), o);
+    }
+    char *format_dec(int64_t v, char *o)
+    {
+      if (v < 0) {
+        *o++ = '-';
+        return format_dec(uint64_t(0) - uint64_t(v), o);
+      }
+      return format_dec(uint64_t(v), o);
+    }
+    char *format_dec(int32_t v, char *o)
+    {
+      return format_dec(int64_t(v), o);
+    }
+#if __APPLE__ && __MACH__
+    char *format_dec(size_t v, char *o)
+    {
+      return format_dec(uint64_t(v), o);
+    }
+    char *format_dec(long v, char *o)
+    {
+      return format_dec(int64_t(v), o);
+    }
 #endif
 
-      return t;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // i.e. the number of leading digits in the 8 bytes loaded into x,
+    // where a byte is a digit iff its high nibble is 3 and adding 6
+    // doesn't change that - a carry out of a byte only affects bytes
+    // after the first non-digit
+    static unsigned leading_digits8(uint64_t x)
+    {
+      uint64_t t = ((x & 0xf0f0f0f0f0f0f0f0llu)
+          | (((x + 0x0606060606060606llu) & 0xf0f0f0f0f0f0f0f0llu) >> 4))
+        ^ 0x3333333333333333llu;
+      return t ? unsigned(__builtin_ctzll(t)) / 8u : 8u;
+    }
+    // i.e. combines adjacent digits into pairs, quads and octets
+    static uint64_t dec8(uint64_t x)
+    {
+      x -= 0x3030303030303030llu;
+      x = (x * 10 + (x >> 8)) & 0x00ff00ff00ff00ffllu;
+      x = (x * 100 + (x >> 16)) & 0x0000ffff0000ffffllu;
+      x = (x * 10000 + (x >> 32)) & 0x00000000ffffffffllu;
+      return x;
+    }
+#endif
+
+    static const uint64_t pow10_8[] = { 1u, 10u, 100u, 1000u, 10000u,
+      100000u, 1000000u, 10000000u, 100000000u };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    static uint64_t load8(const char *p)
+    {
+      uint64_t x;
+      memcpy(&x, p, 8);
+      return x;
+    }
+    // i.e. the last n < 8 digits of x (at the end of the register)
+    // with the bytes before them replaced by '0'
+    static uint64_t tail8(uint64_t x, unsigned n)
+    {
+      return (x & (~uint64_t(0) << (8 * (8 - n))))
+        | (0x3030303030303030llu >> (8 * n));
+    }
+
+    // where end - i >= 8, i.e. the digit run is measured first, then
+    // converted in 8 digit chunks and the remainder is loaded such
+    // that it ends with the run (overlapping the previous chunk)
+    static bool parse_dec_swar(const char *i, const char *end, uint64_t &r)
+    {
+      const char *e = i;
+      for (;;) {
+        if (end - e < 8) {
+          // i.e. the remaining bytes are shifted to the start of
+          // the register, the zero bytes after them aren't digits
+          if (e != end)
+            e += leading_digits8(load8(end - 8) >> (8 * (8 - (end - e))));
+          break;
+        }
+        unsigned k = leading_digits8(load8(e));
+        e += k;
+        if (k < 8)
+          break;
+      }
+      uint64_t v = 0;
+      size_t n = e - i;
+      if (n < 8) {
+        if (n)
+          v = dec8(tail8(load8(i) << (8 * (8 - n)), unsigned(n)));
+        r = v;
+        return true;
+      }
+      while (n > 20 && *i == '0') {
+        ++i;
+        --n;
+      }
+      if (n > 20)
+        return false;
+      for (; e - i >= 8; i += 8)
+        v = v * pow10_8[8] + dec8(load8(i));
+      unsigned m = unsigned(e - i);
+      // i.e. only 20 digit values may overflow
+      if (m && (__builtin_mul_overflow(v, pow10_8[m], &v)
+            || __builtin_add_overflow(v, dec8(tail8(load8(e - 8), m)), &v)))
+        return false;
+      r = v;
+      return true;
+    }
+#endif
+
+    // Converts the leading digits of [i, end), i.e. returns false on
+    // overflow.
+    static bool parse_dec(const char *i, const char *end, uint64_t &r)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      if (end - i >= 8)
+        return parse_dec_swar(i, end, r);
+#endif
+      uint64_t v = 0;
+      if (end - i < 20) {
+        // i.e. at most 19 digits don't overflow
+        for (; i != end && unsigned(*i - '0') < 10u; ++i)
+          v = v * 10 + unsigned(*i - '0');
+      } else {
+        for (; i != end && unsigned(*i - '0') < 10u; ++i) {
+          if (__builtin_mul_overflow(v, 10u, &v)
+              || __builtin_add_overflow(v, unsigned(*i - '0'), &v))
+            return false;
+        }
+      }
+      r = v;
+      return true;
+    }
+
+    uint32_t range_to_uint32(const std::pair<const char*, const char*> &p)
+    {
+      uint64_t t = 0;
+      if (!parse_dec(p.first, p.second, t)
+          || t > std::numeric_limits<uint32_t>::max())
+        return 0;
+      return uint32_t(t);
     }
 
     uint64_t range_to_uint64(const std::pair<const char*, const char*> &p)
     {
       uint64_t t = 0;
-#if XFSX_HAVE_FROM_CHARS
-      std::from_chars(p.first, p.second, t);
-#else
-      boost::spirit::qi::parse(p.first, p.second, t);
-#endif
+      if (!parse_dec(p.first, p.second, t))
+        return 0;
       return t;
     }
 
     int64_t range_to_int64(const std::pair<const char*, const char*> &p)
     {
-      int64_t t = 0;
-#if XFSX_HAVE_FROM_CHARS
-      std::from_chars(p.first, p.second, t);
-#else
-      boost::spirit::qi::parse(p.first, p.second, t);
-#endif
-      return t;
+      const char *i = p.first;
+      bool neg = i != p.second && *i == '-';
+      uint64_t t = 0;
+      if (!parse_dec(i + neg, p.second, t))
+        return 0;
+      if (neg) {
+        if (t > uint64_t(std::numeric_limits<int64_t>::max()) + 1u)
+          return 0;
+        return int64_t(0u - t);
+      }
+      if (t > uint64_t(std::numeric_limits<int64_t>::max()))
+        return 0;
+      return int64_t(t);
     }
 
 
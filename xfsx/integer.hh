@@ -21,6 +21,7 @@
 #ifndef XFSX_INTEGER_HH
 #define XFSX_INTEGER_HH
 
+#include <stddef.h>
 #include <stdint.h>
 #include <utility>
 
@@ -35,6 +36,21 @@ namespace xfsx {
 	uint32_t dec_digits(size_t n);
 #endif
 
+    // maximum number of characters written by format_dec()
+    const size_t max_dec_size = 20;
+    // Writes the decimal representation of v to o (without a
+    // terminating zero) and returns the end of it. The digits are
+    // written two at a time from a lookup table, values with 16 or
+    // more digits are converted with SSE2 (if available).
+    char *format_dec(uint64_t v, char *o);
+    char *format_dec(uint32_t v, char *o);
+    char *format_dec(int64_t v, char *o);
+    char *format_dec(int32_t v, char *o);
+#if __APPLE__ && __MACH__
+    char *format_dec(size_t v, char *o);
+    char *format_dec(long v, char *o);
+#endif
+
     uint32_t range_to_uint32(const std::pair<const char*, const char*> &p);
     uint64_t range_to_uint64(const std::pair<const char*, const char*> &p);
     int64_t range_to_int64(const std::pair<const char*, const char*> &p);
@@ -0,0 +1,195 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "pretty_printer.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#if !(defined(__MINGW32__) || defined(__MINGW64__))
+    #include <dlfcn.h>
+#endif
+
+using namespace std;
+
+namespace xfsx {
+
+    namespace pp {
+
+        Printer::~Printer() =default;
+        bool Printer::print(int64_t, byte::writer::Base &) const
+        {
+            return false;
+        }
+        bool Printer::print(const char *, const char *,
+                byte::writer::Base &) const
+        {
+            return false;
+        }
+
+        static bool all_digits(const char *begin, const char *end)
+        {
+            return std::all_of(begin, end,
+                    [](char c) { return c >= '0' && c <= '9'; });
+        }
+
+        bool Timestamp::print(const char *begin, const char *end,
+                byte::writer::Base &o) const
+        {
+            if (end - begin != 14 || !all_digits(begin, end))
+                return false;
+            auto p = begin;
+            o << make_pair(p, p + 4) << '-' << make_pair(p + 4, p + 6)
+              << '-' << make_pair(p + 6, p + 8) << ' '
+              << make_pair(p + 8, p + 10) << ':' << make_pair(p + 10, p + 12)
+              << ':' << make_pair(p + 12, p + 14);
+            return true;
+        }
+
+        bool Utc_Offset::print(const char *begin, const char *end,
+                byte::writer::Base &o) const
+        {
+            if (end - begin != 5 || (*begin != '+' && *begin != '-')
+                    || !all_digits(begin + 1, end))
+                return false;
+            o << make_pair(begin, begin + 3) << ':'
+              << make_pair(begin + 3, end);
+            return true;
+        }
+
+        bool Duration::print(int64_t v, byte::writer::Base &o) const
+        {
+            if (v < 0)
+                return false;
+            int64_t h = v / 3600;
+            int64_t m = v % 3600 / 60;
+            int64_t s = v % 60;
+            if (h)
+                o << h << 'h';
+            if (h || m)
+                o << m << 'm';
+            o << s << 's';
+            return true;
+        }
+
+        bool Tadig::print(const char *begin, const char *end,
+                byte::writer::Base &o) const
+        {
+            if (end - begin != 5)
+                return false;
+            o << "country=\"" << make_pair(begin, begin + 3)
+              << "\", operator=\"" << make_pair(begin + 3, end) << '"';
+            return true;
+        }
+
+        bool Cause_For_Termination::print(int64_t v,
+                byte::writer::Base &o) const
+        {
+            const char *s = nullptr;
+            switch (v) {
+                case  0: s = "normal release"; break;
+                case  1: s = "partial record"; break;
+                case  3: s = "partial record call re-establishment"; break;
+                case  4: s = "unsuccessful call attempt"; break;
+                case  5: s = "abnormal release"; break;
+                case  6: s = "CAMEL initiated call release"; break;
+                case 16: s = "volume limit"; break;
+                case 17: s = "time limit"; break;
+                case 18: s = "SGSN change"; break;
+                case 19: s = "maximum number of changes in charging conditions";
+                         break;
+                case 20: s = "management intervention"; break;
+            }
+            if (!s)
+                return false;
+            o << s;
+            return true;
+        }
+
+        bool Tbcd::print(const char *begin, const char *end,
+                byte::writer::Base &o) const
+        {
+            static const char digits[] = "0123456789*#abc";
+            size_t n = size_t(end - begin) * 2;
+            char *x = o.w.begin_write(n);
+            char *p = x;
+            for (auto i = begin; i != end; ++i) {
+                uint8_t b = uint8_t(*i);
+                uint8_t lo = b & 0xfu;
+                uint8_t hi = b >> 4;
+                if (lo == 0xfu)
+                    break;
+                *p++ = digits[lo];
+                if (hi == 0xfu)
+                    break;
+                *p++ = digits[hi];
+            }
+            o.w.commit_write(p - x);
+            return p != x;
+        }
+
+
+        void Registry::push(Klasse klasse, Tag_Int tag,
+                std::shared_ptr<const Printer> p)
+        {
+            map_[key(klasse, tag)] = std::move(p);
+        }
+        bool Registry::push(const Name_Translator &translator,
+                const char *name, std::shared_ptr<const Printer> p)
+        {
+            std::tuple<Shape, Klasse, Tag_Int> r;
+            try {
+                r = translator.translate(make_pair(name,
+                            name + char_traits<char>::length(name)));
+            } catch (const std::out_of_range &) {
+                return false;
+            }
+            push(get<1>(r), get<2>(r), std::move(p));
+            return true;
+        }
+        bool Registry::empty() const
+        {
+            return map_.empty();
+        }
+
+        void Registry::load(const std::string &filename,
+                const Name_Translator &translator)
+        {
+#if (defined(__MINGW32__) || defined(__MINGW64__))
+            (void)translator;
+            throw runtime_error("pretty printer plugins aren't supported on "
+                    "this platform: " + filename);
+#else
+            void *h = dlopen(filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!h)
+                throw runtime_error(string("dlopen: ") + dlerror());
+            std::shared_ptr<void> handle(h, [](void *h) { dlclose(h); });
+            using Register_Fn = void (*)(Registry &, const Name_Translator &);
+            auto fn = reinterpret_cast<Register_Fn>(
+                    dlsym(h, "xfsx_pp_register"));
+            if (!fn)
+                throw runtime_error("plugin " + filename
+                        + " doesn't export xfsx_pp_register");
+            plugins_.push_back(std::move(handle));
+            fn(*this, translator);
+#endif
+        }
+
+        void register_tap(Registry &r, const Name_Translator &translator)
+        {
+            if (translator.empty())
+                return;
+            auto timestamp = make_shared<Timestamp>();
+            auto utc_offset = make_shared<Utc_Offset>();
+            r.push(translator, "LocalTimeStamp", timestamp);
+            r.push(translator, "UtcTimeOffset", utc_offset);
+            r.push(translator, "TotalCallEventDuration",
+                    make_shared<Duration>());
+            r.push(translator, "CauseForTermination",
+                    make_shared<Cause_For_Termination>());
+        }
+
+    } // pp
+
+} // xfsx
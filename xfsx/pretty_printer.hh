@@ -0,0 +1,121 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_PRETTY_PRINTER_HH
+#define XFSX_PRETTY_PRINTER_HH
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+#include "xfsx.hh"
+#include "byte.hh"
+
+namespace xfsx {
+
+    namespace pp {
+
+        // Formats the content of the pp attribute of a primitive tag.
+        //
+        // Printers are shared between threads (cf. write-xml --threads),
+        // thus, they must not modify any state in print().
+        class Printer {
+            public:
+                virtual ~Printer();
+                // return false if there is nothing to print for v
+                virtual bool print(int64_t v, byte::writer::Base &o) const;
+                // BCD values are passed decoded (without filler),
+                // other strings as is
+                virtual bool print(const char *begin, const char *end,
+                        byte::writer::Base &o) const;
+        };
+
+        // e.g. 20050405090547 -> 2005-04-05 09:05:47
+        class Timestamp : public Printer {
+            public:
+                bool print(const char *begin, const char *end,
+                        byte::writer::Base &o) const override;
+        };
+        // e.g. +0200 -> +02:00
+        class Utc_Offset : public Printer {
+            public:
+                bool print(const char *begin, const char *end,
+                        byte::writer::Base &o) const override;
+        };
+        // e.g. 153 -> 2m33s
+        class Duration : public Printer {
+            public:
+                bool print(int64_t v, byte::writer::Base &o) const override;
+        };
+        // TADIG code, e.g. DEUD1 -> country="DEU", operator="D1"
+        //
+        // Not part of the built-in TAP printers since it doesn't
+        // look up the country name like the Lua module does.
+        class Tadig : public Printer {
+            public:
+                bool print(const char *begin, const char *end,
+                        byte::writer::Base &o) const override;
+        };
+        // TD.57 CauseForTermination, e.g. 4 -> unsuccessful call attempt
+        class Cause_For_Termination : public Printer {
+            public:
+                bool print(int64_t v, byte::writer::Base &o) const override;
+        };
+        // Telephony BCD, i.e. the low nibble is the first digit
+        // and 0xf is the filler, e.g. 0x21 0xf3 -> 123
+        class Tbcd : public Printer {
+            public:
+                bool print(const char *begin, const char *end,
+                        byte::writer::Base &o) const override;
+        };
+
+        class Registry {
+            public:
+                void push(Klasse klasse, Tag_Int tag,
+                        std::shared_ptr<const Printer> p);
+                // returns false if the grammar doesn't know that name
+                bool push(const Name_Translator &translator, const char *name,
+                        std::shared_ptr<const Printer> p);
+                // returns nullptr if no printer is registered for that tag
+                const Printer *find(Klasse klasse, Tag_Int tag) const
+                {
+                    if (map_.empty())
+                        return nullptr;
+                    auto i = map_.find(key(klasse, tag));
+                    return i == map_.end() ? nullptr : i->second.get();
+                }
+                bool empty() const;
+
+                // Loads a shared object that exports:
+                //
+                //     extern "C" void xfsx_pp_register(
+                //         xfsx::pp::Registry &r,
+                //         const xfsx::Name_Translator &translator);
+                //
+                // Its printers replace already registered ones.
+                void load(const std::string &filename,
+                        const Name_Translator &translator);
+            private:
+                static uint64_t key(Klasse klasse, Tag_Int tag)
+                {
+                    return (uint64_t(klasse) << 32) | tag;
+                }
+                // declared first such that the plugins are unloaded
+                // after their printers are destroyed
+                std::vector<std::shared_ptr<void>> plugins_;
+                std::unordered_map<uint64_t,
+                    std::shared_ptr<const Printer>> map_;
+        };
+
+        // built-in printers for TAP/RAP tags - Lua callbacks
+        // are only called for tags without a printer
+        void register_tap(Registry &r, const Name_Translator &translator);
+
+    } // pp
+
+} // xfsx
+
+#endif // XFSX_PRETTY_PRINTER_HH
@@ -7,15 +7,26 @@
 #include <tuple>
 
 #include "xfsx.hh"
+#include "sync_group.hh"
 
 #include <ixxx/posix.hh>
 
+#include <algorithm>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <system_error>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#if !(defined(__MINGW32__) || defined(__MINGW64__))
+    #include <sys/mman.h>
+    #include <sys/uio.h>
+    #include <limits.h>
+#endif
+#include <unistd.h>
 
 using namespace std;
 
@@ -58,25 +69,27 @@ namespace xfsx {
             assert(off_ <= v_.size());
         }
     template <typename Char>
-        void Scratchpad<Char>::forget_prelude(size_t k)
+        size_t Scratchpad<Char>::forget_prelude(size_t k)
         {
             if (!k)
-                return;
+                return 0;
             // Optimally, either k == off_ (i.e. when reading) or
             // or k is just a little bit smaller than off_
             // e.g. k is at a 128k boundary and off_ a few bytes above
             // (i.e. when writing)
             assert(k <= off_);
-            memmove(v_.data(), v_.data() + k, v_.size() - k);
-            v_.resize(v_.size() - k);
+            size_t n = v_.size() - k;
+            memmove(v_.data(), v_.data() + k, n);
+            v_.resize(n);
             off_ -= k;
+            return n;
         }
 
     template <typename Char>
-        void Scratchpad<Char>::remove_head(size_t k)
+        size_t Scratchpad<Char>::remove_head(size_t k)
         {
             increment_head(k);
-            forget_prelude(off_);
+            return forget_prelude(off_);
         }
     template <typename Char>
         void Scratchpad<Char>::add_tail(size_t k)
@@ -105,12 +118,30 @@ namespace xfsx {
 
     template <typename Char>
         size_t Scratchpad<Char>::size() const { return v_.size() - off_; }
+    template <typename Char>
+        size_t Scratchpad<Char>::capacity() const { return v_.capacity(); }
 
 
     template class Scratchpad<u8>;
     template class Scratchpad<char>;
 
 
+    IO_Stats &IO_Stats::operator+=(const IO_Stats &o)
+    {
+        read_calls  += o.read_calls;
+        write_calls += o.write_calls;
+        sync_calls  += o.sync_calls;
+        read_bytes  += o.read_bytes;
+        write_bytes += o.write_bytes;
+        moved_bytes += o.moved_bytes;
+        grow_calls  += o.grow_calls;
+        read_time   += o.read_time;
+        write_time  += o.write_time;
+        sync_time   += o.sync_time;
+        return *this;
+    }
+
+
     template <typename Char>
         Source_File<Char>::Source_File() =default;
     template <typename Char>
@@ -155,12 +186,17 @@ namespace xfsx {
         {
             return eof_;
         }
+    template <typename Char>
+        const IO_Stats &Source_File<Char>::stats() const
+        {
+            return stats_;
+        }
     template <typename Char>
         std::pair<const Char*, const Char*>
         Source_File<Char>::read_more(
                 size_t forget_cnt, size_t want_cnt)
         {
-            pad_.remove_head(forget_cnt);
+            stats_.moved_bytes += pad_.remove_head(forget_cnt);
             // reduce the number of memmove calls - doesn't make a difference
             //pad_.increment_head(forget_cnt);
             //if ((pad_.begin() - pad_.prelude()) / inc_ > 3)
@@ -168,10 +204,14 @@ namespace xfsx {
 
             size_t k = (want_cnt + inc_ - 1) / inc_;
             size_t l = k * inc_;
+            size_t cap = pad_.capacity();
             pad_.add_tail(l);
+            stats_.grow_calls += pad_.capacity() != cap;
             size_t m = 0;
+            auto start = std::chrono::steady_clock::now();
             for (size_t i = 0; i < k; ++i) {
                 size_t n = ixxx::util::read_all(fd_, pad_.end()-l+m, inc_);
+                ++stats_.read_calls;
                 m += n;
                 if (n < inc_) {
                     pad_.remove_tail(l - m);
@@ -179,6 +219,8 @@ namespace xfsx {
                     break;
                 }
             }
+            stats_.read_time += std::chrono::steady_clock::now() - start;
+            stats_.read_bytes += m;
             return make_pair(pad_.begin(), pad_.end());
         }
 
@@ -204,6 +246,11 @@ namespace xfsx {
         :
             fd_(std::move(fd))
     {
+        // i.e. the caller might have positioned the descriptor already,
+        // e.g. when resuming a conversion; fails for pipes
+        auto off = ::lseek(fd_, 0, SEEK_CUR);
+        if (off != -1)
+            off_ = off;
     }
     template <typename Char>
         Sink_File<Char>::~Sink_File()
@@ -234,6 +281,11 @@ namespace xfsx {
         {
             sync_ = b;
         }
+    template <typename Char>
+        void Sink_File<Char>::set_sync_group(Sync_Group *g)
+        {
+            group_ = g;
+        }
     template <typename Char>
         std::pair<Char*, Char*>
         Sink_File<Char>::prepare_write(size_t forget_cnt, size_t want_cnt)
@@ -241,11 +293,37 @@ namespace xfsx {
             pad_.increment_head(forget_cnt);
 
             size_t k = (want_cnt + inc_ - 1)/inc_*inc_;
+            size_t cap = pad_.capacity();
             pad_.add_tail(k);
+            stats_.grow_calls += pad_.capacity() != cap;
 
             return make_pair(pad_.begin(), pad_.end());
         }
 
+    template <typename Char>
+        void Sink_File<Char>::write_block(const Char *begin, size_t n)
+        {
+            auto start = std::chrono::steady_clock::now();
+            ixxx::util::write_all(fd_, begin, n);
+            stats_.write_time += std::chrono::steady_clock::now() - start;
+            ++stats_.write_calls;
+            stats_.write_bytes += n;
+            start_writeback(n);
+        }
+    template <typename Char>
+        void Sink_File<Char>::start_writeback(size_t n)
+        {
+#if defined(__linux__)
+            // Initiate the writeback of the just written range without
+            // waiting for it such that the final sync has less to do.
+            // Errors are ignored since it's just a hint, e.g. it fails
+            // for pipes - the final sync reports any real errors.
+            if (sync_)
+                ::sync_file_range(fd_, off_, n, SYNC_FILE_RANGE_WRITE);
+#endif
+            off_ += n;
+        }
+
     template <typename Char>
         std::pair<Char*, Char*>
         Sink_File<Char>::write_some(size_t forget_cnt)
@@ -260,10 +338,10 @@ namespace xfsx {
             //    return;
             //cerr << (n-k*inc_) << '\n';
             for (size_t i = 0; i < k; ++i) {
-                ixxx::util::write_all(fd_, begin, inc_);
+                write_block(begin, inc_);
                 begin += inc_;
             }
-            pad_.forget_prelude(k*inc_);
+            stats_.moved_bytes += pad_.forget_prelude(k*inc_);
 
             return make_pair(pad_.begin(), pad_.end());
         }
@@ -290,7 +368,7 @@ namespace xfsx {
             for (size_t i = 0; i < l; ++i) {
                 // write-through all following inc_ sized blocks
                 // to avoid superfluous buffering
-                ixxx::util::write_all(fd_, begin, inc_);
+                write_block(begin, inc_);
                 begin += inc_;
             }
             n = end - begin;
@@ -302,6 +380,66 @@ namespace xfsx {
             return make_pair(pad_.begin(), pad_.end());
         }
 
+    template <typename Char>
+        std::pair<Char*, Char*>
+        Sink_File<Char>::gather_write(size_t forget_cnt,
+                const std::pair<const Char*, const Char*> *segs, size_t n)
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < n; ++i)
+                total += segs[i].second - segs[i].first;
+            pad_.increment_head(forget_cnt);
+            if ((pad_.begin() - pad_.prelude()) + total < inc_) {
+                std::pair<Char*, Char*> r(pad_.begin(), pad_.end());
+                for (size_t i = 0; i < n; ++i)
+                    r = write(0, segs[i].first, segs[i].second);
+                return r;
+            }
+#if (defined(__MINGW32__) || defined(__MINGW64__))
+            flush();
+            for (size_t i = 0; i < n; ++i)
+                if (segs[i].first != segs[i].second)
+                    write_block(segs[i].first, segs[i].second - segs[i].first);
+#else
+            std::vector<struct iovec> v;
+            v.reserve(n + 1);
+            if (pad_.begin() != pad_.prelude())
+                v.push_back({ const_cast<Char*>(pad_.prelude()),
+                        size_t(pad_.begin() - pad_.prelude()) });
+            for (size_t i = 0; i < n; ++i)
+                if (segs[i].first != segs[i].second)
+                    v.push_back({ const_cast<Char*>(segs[i].first),
+                            size_t(segs[i].second - segs[i].first) });
+            struct iovec *p = v.data();
+            struct iovec *e = p + v.size();
+            while (p != e) {
+                int k = std::min<ptrdiff_t>(e - p, IOV_MAX);
+                auto start = std::chrono::steady_clock::now();
+                ssize_t r = ::writev(fd_, p, k);
+                if (r == -1) {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::system_error(errno, std::generic_category(),
+                            "writev");
+                }
+                stats_.write_time += std::chrono::steady_clock::now() - start;
+                ++stats_.write_calls;
+                stats_.write_bytes += r;
+                start_writeback(r);
+                size_t m = r;
+                for (; p != e && m >= p->iov_len; ++p)
+                    m -= p->iov_len;
+                if (m) {
+                    // partial write
+                    p->iov_base = static_cast<char*>(p->iov_base) + m;
+                    p->iov_len -= m;
+                }
+            }
+            pad_.clear();
+#endif
+            return make_pair(pad_.begin(), pad_.end());
+        }
+
     template <typename Char>
         void Sink_File<Char>::flush()
         {
@@ -310,30 +448,52 @@ namespace xfsx {
             size_t n = end-begin;
             size_t k = n / inc_;
             for (size_t i = 0; i < k; ++i) {
-                ixxx::util::write_all(fd_, begin, inc_);
+                write_block(begin, inc_);
                 begin += inc_;
             }
             if (begin != end) {
-                ixxx::util::write_all(fd_, begin, end-begin);
+                write_block(begin, end-begin);
             }
             pad_.clear();
         }
     template <typename Char>
         void Sink_File<Char>::sync()
         {
-            if (sync_)
+            if (!sync_)
+                return;
+            auto start = std::chrono::steady_clock::now();
+            if (group_) {
+                int fd = ::dup(fd_);
+                if (fd == -1)
+                    throw std::system_error(errno, std::generic_category(),
+                            "dup");
+                group_->add(ixxx::util::FD(fd));
+            } else {
                 ixxx::posix::fsync(fd_);
+            }
+            stats_.sync_time += std::chrono::steady_clock::now() - start;
+            ++stats_.sync_calls;
         }
     template <typename Char>
         size_t Sink_File<Char>::inc() const
         {
             return inc_;
         }
+    template <typename Char>
+        const IO_Stats &Sink_File<Char>::stats() const
+        {
+            return stats_;
+        }
 
     template class Sink_File<u8>;
     template class Sink_File<char>;
 
     template <typename Char> Reader<Char>::~Reader() =default;
+    template <typename Char>
+        const IO_Stats *Reader<Char>::stats() const
+        {
+            return nullptr;
+        }
 
     template class Reader<u8>;
     template class Reader<char>;
@@ -364,6 +524,82 @@ namespace xfsx {
     template class Memory_Reader<u8>;
     template class Memory_Reader<char>;
 
+
+    template <typename Char>
+        Segmented_Reader<Char>::Segmented_Reader() =default;
+    template <typename Char>
+        Segmented_Reader<Char>::Segmented_Reader(
+                std::vector<std::pair<const Char*, const Char*>> segs)
+    {
+        segs_.reserve(segs.size());
+        offs_.reserve(segs.size());
+        for (auto &x : segs)
+            push_back(x.first, x.second);
+    }
+    template <typename Char>
+        void Segmented_Reader<Char>::push_back(const Char *begin, const Char *end)
+        {
+            segs_.emplace_back(begin, end);
+            offs_.push_back(total_);
+            total_ += end - begin;
+        }
+    template <typename Char>
+        std::pair<const Char*, const Char*>
+        Segmented_Reader<Char>::read_more(size_t forget_cnt, size_t want_cnt)
+        {
+            pos_ += forget_cnt;
+            assert(pos_ <= end_);
+            size_t want = end_ - pos_ + want_cnt;
+
+            while (idx_ < segs_.size()
+                    && pos_ >= offs_[idx_] + size_t(segs_[idx_].second
+                        - segs_[idx_].first))
+                ++idx_;
+            if (idx_ == segs_.size()) {
+                end_ = pos_;
+                return make_pair(nullptr, nullptr);
+            }
+
+            const Char *b = segs_[idx_].first + (pos_ - offs_[idx_]);
+            const Char *e = segs_[idx_].second;
+            if (size_t(e - b) >= want || offs_[idx_] + (e - segs_[idx_].first)
+                    == total_) {
+                end_ = pos_ + (e - b);
+                return make_pair(b, e);
+            }
+
+            // the window straddles a segment boundary
+            size_t n = std::min(want, total_ - pos_);
+            buffer_.resize(n);
+            auto o = std::copy(b, e, buffer_.data());
+            for (size_t i = idx_ + 1; o != buffer_.data() + n; ++i) {
+                size_t k = std::min(size_t(segs_[i].second - segs_[i].first),
+                        size_t(buffer_.data() + n - o));
+                o = std::copy(segs_[i].first, segs_[i].first + k, o);
+            }
+            copied_ += n;
+            end_ = pos_ + n;
+            return make_pair(buffer_.data(), buffer_.data() + n);
+        }
+    template <typename Char>
+        bool Segmented_Reader<Char>::eof() const
+        {
+            return end_ == total_;
+        }
+    template <typename Char>
+        size_t Segmented_Reader<Char>::first_used() const
+        {
+            return idx_;
+        }
+    template <typename Char>
+        size_t Segmented_Reader<Char>::copied() const
+        {
+            return copied_;
+        }
+
+    template class Segmented_Reader<u8>;
+    template class Segmented_Reader<char>;
+
     template <typename Char>
         Mapped_Reader<Char>::Mapped_Reader(const char *filename)
         :
@@ -384,6 +620,76 @@ namespace xfsx {
     template class Mapped_Reader<u8>;
     template class Mapped_Reader<char>;
 
+#if !(defined(__MINGW32__) || defined(__MINGW64__))
+    template <typename Char>
+        Windowed_Mapped_Reader<Char>::Windowed_Mapped_Reader(
+                const std::string &filename, size_t window)
+        :
+            fd_(filename, O_RDONLY)
+    {
+        struct stat st;
+        if (::fstat(fd_, &st) == -1)
+            throw std::system_error(errno, std::generic_category(),
+                    "fstat " + filename);
+        size_ = st.st_size;
+        size_t page = ::sysconf(_SC_PAGESIZE);
+        window_ = std::max(page, (window + page - 1) / page * page);
+    }
+    template <typename Char>
+        Windowed_Mapped_Reader<Char>::~Windowed_Mapped_Reader()
+        {
+            unmap();
+        }
+    template <typename Char>
+        void Windowed_Mapped_Reader<Char>::unmap()
+        {
+            if (map_) {
+                ::munmap(const_cast<Char*>(map_), map_len_);
+                map_ = nullptr;
+            }
+        }
+    template <typename Char>
+        std::pair<const Char*, const Char*>
+        Windowed_Mapped_Reader<Char>::read_more(size_t forget_cnt,
+                size_t want_cnt)
+        {
+            pos_ += forget_cnt;
+            assert(pos_ <= end_);
+            size_t want_end = std::min(size_, end_ + want_cnt);
+            if (pos_ == size_) {
+                unmap();
+                end_ = pos_;
+                return make_pair(nullptr, nullptr);
+            }
+            if (!map_ || want_end > map_off_ + map_len_) {
+                // i.e. the old window is released first such that
+                // at most one window is mapped at any time
+                unmap();
+                size_t page = ::sysconf(_SC_PAGESIZE);
+                map_off_ = pos_ / page * page;
+                map_len_ = std::min(size_ - map_off_,
+                        std::max(window_, want_end - map_off_));
+                void *p = ::mmap(nullptr, map_len_, PROT_READ, MAP_SHARED,
+                        fd_, map_off_);
+                if (p == MAP_FAILED)
+                    throw std::system_error(errno, std::generic_category(),
+                            "mmap");
+                // just a hint, thus errors are ignored
+                ::posix_madvise(p, map_len_, POSIX_MADV_SEQUENTIAL);
+                map_ = static_cast<const Char*>(p);
+            }
+            end_ = map_off_ + map_len_;
+            return make_pair(map_ + (pos_ - map_off_), map_ + map_len_);
+        }
+    template <typename Char>
+        bool Windowed_Mapped_Reader<Char>::eof() const
+        {
+            return end_ == size_;
+        }
+    template class Windowed_Mapped_Reader<u8>;
+    template class Windowed_Mapped_Reader<char>;
+#endif
+
     template <typename Char>
         File_Reader<Char>::File_Reader(File_Reader &&) =default;
     template <typename Char>
@@ -420,6 +726,16 @@ namespace xfsx {
         {
             return source_.eof();
         }
+    template <typename Char>
+        const IO_Stats *File_Reader<Char>::stats() const
+        {
+            return &source_.stats();
+        }
+    template <typename Char>
+        Source_File<Char> &File_Reader<Char>::source()
+        {
+            return source_;
+        }
 
     template class File_Reader<u8>;
     template class File_Reader<char>;
@@ -495,6 +811,11 @@ namespace xfsx {
             global_pos_ += k;
             p_.first    += k;
         }
+    template <typename Char>
+        void Simple_Reader<Char>::skip(size_t k)
+        {
+            skip(k, [](const Char*, const Char*) {});
+        }
     template <typename Char>
         void Simple_Reader<Char>::check_available(size_t k)
         {
@@ -525,6 +846,11 @@ namespace xfsx {
             else
                 return eof_;
         }
+    template <typename Char>
+        scratchpad::Reader<Char> *Simple_Reader<Char>::backend()
+        {
+            return backend_.get();
+        }
 
     template class Simple_Reader<u8>;
     template class Simple_Reader<char>;
@@ -537,6 +863,10 @@ namespace xfsx {
         void Writer<Char>::clear()
         {
         }
+    template <typename Char>
+        void Writer<Char>::set_sync_group(Sync_Group *)
+        {
+        }
     // default implementation, cf. File_Writer for an overwrite
     template <typename Char>
         std::pair<Char*, Char*> Writer<Char>::write(size_t forget_cnt,
@@ -547,11 +877,30 @@ namespace xfsx {
         std::copy(begin, end, p.first);
         return write_some(n);
     }
+    // default implementation, cf. File_Writer for an overwrite
+    template <typename Char>
+        std::pair<Char*, Char*> Writer<Char>::gather_write(size_t forget_cnt,
+            const std::pair<const Char*, const Char*> *segs, size_t n)
+    {
+        std::pair<Char*, Char*> r(nullptr, nullptr);
+        if (!n)
+            return write_some(forget_cnt);
+        for (size_t i = 0; i < n; ++i) {
+            r = write(forget_cnt, segs[i].first, segs[i].second);
+            forget_cnt = 0;
+        }
+        return r;
+    }
     template <typename Char>
         size_t Writer<Char>::inc() const
         {
             return 128 * 1024;
         }
+    template <typename Char>
+        const IO_Stats *Writer<Char>::stats() const
+        {
+            return nullptr;
+        }
 
 
     template class Writer<u8>;
@@ -602,6 +951,25 @@ namespace xfsx {
         this->begin_ = reinterpret_cast<Char*>(m_.begin());
         this->end_   = reinterpret_cast<Char*>(m_.end());
     }
+    // i.e. running out of space fails here and not with a SIGBUS
+    // while writing into the mapping
+    static void preallocate(const std::string &filename, size_t size)
+    {
+#if !(defined(__MINGW32__) || defined(__MINGW64__) \
+        || (defined(__APPLE__) && defined(__MACH__)))
+        if (!size)
+            return;
+        ixxx::util::FD fd(filename, O_RDWR);
+        int r = posix_fallocate(fd, 0, size);
+        // e.g. a file system that doesn't support it
+        if (r && r != EOPNOTSUPP && r != EINVAL)
+            throw std::system_error(r, std::generic_category(),
+                    "posix_fallocate " + filename);
+#else
+        (void)filename;
+        (void)size;
+#endif
+    }
     template <typename Char>
         Mapped_Writer<Char>::Mapped_Writer(const std::string &filename, size_t size)
         :
@@ -609,6 +977,7 @@ namespace xfsx {
         {
             this->begin_ = reinterpret_cast<Char*>(m_.begin());
             this->end_   = reinterpret_cast<Char*>(m_.end());
+            preallocate(filename, size);
         }
     template <typename Char>
         void Mapped_Writer<Char>::sync()
@@ -641,6 +1010,40 @@ namespace xfsx {
             pad_.increment_head(forget_cnt);
             return make_pair(pad_.begin(), pad_.end());
         }
+    template <typename Char>
+        void Scratchpad_Writer<Char>::reserve(size_t k)
+        {
+            size_t n = pad_.end() - pad_.begin();
+            if (n < k)
+                pad_.add_tail((k - n + inc_ - 1)/inc_*inc_);
+        }
+    template <typename Char>
+        std::pair<Char*, Char*>
+        Scratchpad_Writer<Char>::write(size_t forget_cnt,
+                const Char *begin, const Char *end)
+        {
+            pad_.increment_head(forget_cnt);
+            reserve(end - begin);
+            std::copy(begin, end, pad_.begin());
+            pad_.increment_head(end - begin);
+            return make_pair(pad_.begin(), pad_.end());
+        }
+    template <typename Char>
+        std::pair<Char*, Char*>
+        Scratchpad_Writer<Char>::gather_write(size_t forget_cnt,
+                const std::pair<const Char*, const Char*> *segs, size_t n)
+        {
+            pad_.increment_head(forget_cnt);
+            size_t k = 0;
+            for (size_t i = 0; i < n; ++i)
+                k += segs[i].second - segs[i].first;
+            reserve(k);
+            Char *o = pad_.begin();
+            for (size_t i = 0; i < n; ++i)
+                o = std::copy(segs[i].first, segs[i].second, o);
+            pad_.increment_head(k);
+            return make_pair(pad_.begin(), pad_.end());
+        }
     template <typename Char>
         void Scratchpad_Writer<Char>::flush()
         {
@@ -709,6 +1112,13 @@ namespace xfsx {
         {
             return sink_.write(forget_cnt, begin, end);
         }
+    template <typename Char>
+        std::pair<Char*, Char*>
+        File_Writer<Char>::gather_write(size_t forget_cnt,
+                const std::pair<const Char*, const Char*> *segs, size_t n)
+        {
+            return sink_.gather_write(forget_cnt, segs, n);
+        }
     template <typename Char>
         size_t File_Writer<Char>::inc() const
         {
@@ -731,6 +1141,16 @@ namespace xfsx {
         {
             sink_.set_sync(b);
         }
+    template <typename Char>
+        void File_Writer<Char>::set_sync_group(Sync_Group *g)
+        {
+            sink_.set_sync_group(g);
+        }
+    template <typename Char>
+        const IO_Stats *File_Writer<Char>::stats() const
+        {
+            return &sink_.stats();
+        }
     template <typename Char>
         Sink_File<Char> & File_Writer<Char>::sink()
         {
@@ -840,6 +1260,17 @@ namespace xfsx {
                 local_pos_ = 0;
             }
         }
+    template <typename Char>
+        void Simple_Writer<Char>::gather_write(
+                const std::pair<const Char*, const Char*> *segs, size_t n)
+        {
+            size_t k = 0;
+            for (size_t i = 0; i < n; ++i)
+                k += segs[i].second - segs[i].first;
+            std::tie(begin_, end_) = backend_->gather_write(local_pos_, segs, n);
+            local_pos_   = 0;
+            global_pos_ += k;
+        }
     template <typename Char>
         Char *Simple_Writer<Char>::begin_write(size_t k)
         {
@@ -908,6 +1339,13 @@ namespace xfsx {
                 backend_->set_sync(b);
             }
         }
+    template <typename Char>
+        void Simple_Writer<Char>::set_sync_group(Sync_Group *g)
+        {
+            if (backend_) {
+                backend_->set_sync_group(g);
+            }
+        }
 
     template class Simple_Writer<char>;
     template class Simple_Writer<u8>;
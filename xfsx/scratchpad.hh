@@ -8,6 +8,10 @@
 
 #include <ixxx/util.hh>
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <utility>
 
 namespace xfsx {
 
@@ -58,9 +62,10 @@ namespace xfsx {
                 // set prelude to begin position (i.e. prelude is empty),
                 // memmove [begin..end) over the old prelude
                 // and resize internal buffer to a smaller size
-                void forget_prelude(size_t k);
+                // returns the number of moved bytes
+                size_t forget_prelude(size_t k);
                 // increment_head + forget_prelude
-                void remove_head(size_t k);
+                size_t remove_head(size_t k);
 
                 // increment end position and resize internal buffer
                 // i.e. add k bytes to the [begin..end) range
@@ -71,6 +76,7 @@ namespace xfsx {
                 Char *data();
                 const Char *data() const;
                 size_t size() const;
+                size_t capacity() const;
 
                 const Char *prelude() const;
 
@@ -87,6 +93,27 @@ namespace xfsx {
                 size_t off_ {0}; // offset into v_
         };
 
+    class Sync_Group;
+
+    // Counters of the file backends, i.e. they allow to tell whether a
+    // conversion is I/O-bound or parse-bound and to tune the block size.
+    struct IO_Stats {
+        size_t read_calls    {0};
+        size_t write_calls   {0};
+        size_t sync_calls    {0};
+        size_t read_bytes    {0};
+        size_t write_bytes   {0};
+        // bytes memmove'd when the window is compacted
+        size_t moved_bytes   {0};
+        // how often the scratchpad buffer had to be reallocated
+        size_t grow_calls    {0};
+        std::chrono::nanoseconds read_time  {0};
+        std::chrono::nanoseconds write_time {0};
+        std::chrono::nanoseconds sync_time  {0};
+
+        IO_Stats &operator+=(const IO_Stats &o);
+    };
+
     template <typename Char>
         class Source_File {
             public:
@@ -104,11 +131,13 @@ namespace xfsx {
                 void set_increment(size_t inc);
                 const Scratchpad<Char> &pad() const;
                 bool eof() const;
+                const IO_Stats &stats() const;
             private:
                 size_t inc_ {128 * 1024};
                 Scratchpad<Char> pad_;
                 ixxx::util::FD fd_;
                 bool eof_{false};
+                IO_Stats stats_;
         };
 
 
@@ -127,6 +156,8 @@ namespace xfsx {
                 virtual std::pair<const Char*, const Char*>
                     read_more(size_t forget_cnt, size_t want_cnt) = 0;
                 virtual bool eof() const = 0;
+                // returns nullptr if the backend doesn't do any I/O
+                virtual const IO_Stats *stats() const;
         };
     template <typename Char>
         class Memory_Reader : public Reader<Char> {
@@ -150,6 +181,74 @@ namespace xfsx {
             private:
                 ixxx::util::MMap m_;
         };
+#if !(defined(__MINGW32__) || defined(__MINGW64__))
+    // Maps the file in page aligned windows of (at least) window bytes
+    // instead of as a whole, i.e. the address space used is bounded by
+    // the window size plus the largest range that has to be available
+    // at once. The window is remapped when the reader requests bytes
+    // beyond it, starting at the first byte that wasn't forgotten, yet.
+    template <typename Char>
+        class Windowed_Mapped_Reader : public Reader<Char> {
+            public:
+                Windowed_Mapped_Reader(const std::string &filename,
+                        size_t window = 64 * 1024 * 1024);
+                ~Windowed_Mapped_Reader();
+                Windowed_Mapped_Reader(const Windowed_Mapped_Reader &) =delete;
+                Windowed_Mapped_Reader &operator=(
+                        const Windowed_Mapped_Reader &) =delete;
+
+                std::pair<const Char*, const Char*>
+                    read_more(size_t forget_cnt, size_t want_cnt) override;
+                bool eof() const override;
+            private:
+                void unmap();
+
+                ixxx::util::FD fd_;
+                size_t size_ {0};
+                size_t window_ {0};
+                const Char *map_ {nullptr};
+                // file offset and length of the current mapping
+                size_t map_off_ {0};
+                size_t map_len_ {0};
+                // file offsets of the current window
+                size_t pos_ {0};
+                size_t end_ {0};
+        };
+#endif
+    // Reads from a chain of caller-owned segments, i.e. without
+    // concatenating them first. A window that fits into a segment
+    // points directly into it. Only when the requested bytes straddle
+    // a segment boundary, they are copied into an internal buffer.
+    // The segments must stay valid while they are referenced, i.e.
+    // the segments before first_used() can be released.
+    template <typename Char>
+        class Segmented_Reader : public Reader<Char> {
+            public:
+                Segmented_Reader();
+                Segmented_Reader(
+                        std::vector<std::pair<const Char*, const Char*>> segs);
+                std::pair<const Char*, const Char*>
+                    read_more(size_t forget_cnt, size_t want_cnt) override;
+                bool eof() const override;
+
+                // append another segment, e.g. when the next message
+                // arrived - also resets eof
+                void push_back(const Char *begin, const Char *end);
+                size_t first_used() const;
+                // number of bytes copied because of straddling windows
+                size_t copied() const;
+            private:
+                std::vector<std::pair<const Char*, const Char*>> segs_;
+                // logical offset of the first byte of each segment
+                std::vector<size_t> offs_;
+                size_t total_ {0};
+                size_t idx_ {0};
+                // logical offsets of the current window
+                size_t pos_ {0};
+                size_t end_ {0};
+                Raw_Vector<Char> buffer_;
+                size_t copied_ {0};
+        };
     template <typename Char>
         class File_Reader : public Reader<Char> {
             public:
@@ -165,6 +264,9 @@ namespace xfsx {
                 std::pair<const Char*, const Char*>
                     read_more(size_t forget_cnt, size_t want_cnt) override;
                 bool eof() const override;
+                const IO_Stats *stats() const override;
+
+                Source_File<Char> &source();
             private:
                 Source_File<Char> source_;
         };
@@ -188,6 +290,12 @@ namespace xfsx {
                 // i.e. window.begin is incremented
                 // and those bytes are possible freed with the next next() call
                 void     forget(size_t k);
+                // i.e. next(), check_available() and forget() in steps,
+                // such that a windowed backend doesn't have to make
+                // all k bytes available at once
+                void     skip(size_t k);
+                // as skip(), where f(begin, end) is called for each step
+                template <typename F> void skip(size_t k, F f);
                 size_t   pos() const;
                 void set_pos(size_t pos);
                 const std::pair<const Char*, const Char*> &window() const
@@ -196,6 +304,8 @@ namespace xfsx {
                 }
                 bool eof() const;
 
+                scratchpad::Reader<Char> *backend();
+
             private:
                 std::pair<const Char*, const Char*> p_{nullptr, nullptr};
                 size_t    global_pos_ {0};
@@ -209,6 +319,19 @@ namespace xfsx {
                 bool eof_ {false};
         };
 
+    template <typename Char> template <typename F>
+        void Simple_Reader<Char>::skip(size_t k, F f)
+        {
+            while (k) {
+                size_t n = std::min(k, size_t(1024 * 1024));
+                next(n);
+                check_available(n);
+                f(p_.first, p_.first + n);
+                forget(n);
+                k -= n;
+            }
+        }
+
     template <typename Char>
         Simple_Reader<Char> mk_simple_reader(const Char *begin, const Char *end)
         {
@@ -220,11 +343,23 @@ namespace xfsx {
             return Simple_Reader<Char>(std::unique_ptr<scratchpad::Reader<Char>>(
                         new scratchpad::File_Reader<Char>(filename)));
         }
+    template <typename Char>
+        Simple_Reader<Char> mk_simple_reader(
+                std::vector<std::pair<const Char*, const Char*>> segs)
+        {
+            return Simple_Reader<Char>(std::unique_ptr<scratchpad::Reader<Char>>(
+                        new scratchpad::Segmented_Reader<Char>(std::move(segs))));
+        }
     template <typename Char>
         Simple_Reader<Char> mk_simple_reader_mapped(const std::string &filename)
         {
+#if defined(__MINGW32__) || defined(__MINGW64__)
             return Simple_Reader<Char>(std::unique_ptr<scratchpad::Reader<Char>>(
                         new scratchpad::Mapped_Reader<Char>(filename)));
+#else
+            return Simple_Reader<Char>(std::unique_ptr<scratchpad::Reader<Char>>(
+                        new scratchpad::Windowed_Mapped_Reader<Char>(filename)));
+#endif
         }
     template <typename Char>
         Simple_Reader<Char> mk_simple_reader(ixxx::util::FD &&fd)
@@ -251,17 +386,36 @@ namespace xfsx {
                 std::pair<Char*, Char*> write_some(size_t forget_cnt);
                 std::pair<Char*, Char*> write(size_t forget_cnt,
                         const Char *begin, const Char *end);
+                // pending bytes and all segments are written with
+                // writev() calls, unless they are small enough
+                // to be buffered
+                std::pair<Char*, Char*> gather_write(size_t forget_cnt,
+                        const std::pair<const Char*, const Char*> *segs,
+                        size_t n);
 
                 void flush();
+                // with a sync group, the final sync is done
+                // in its background thread
                 void sync();
                 void set_increment(size_t inc);
+                // also starts the writeback of each written block,
+                // where supported
                 void set_sync(bool b);
+                void set_sync_group(Sync_Group *g);
                 size_t inc() const;
+                const IO_Stats &stats() const;
             private:
+                void write_block(const Char *begin, size_t n);
+                void start_writeback(size_t n);
+
                 size_t inc_ {128 * 1024};
                 Scratchpad<Char> pad_;
                 ixxx::util::FD fd_;
                 bool sync_{false};
+                Sync_Group *group_{nullptr};
+                // file offset of the next write
+                size_t off_{0};
+                IO_Stats stats_;
         };
 
     template <typename Char>
@@ -288,17 +442,28 @@ namespace xfsx {
                 // some buffering
                 virtual std::pair<Char*, Char*> write(size_t forget_cnt,
                         const Char *begin, const Char *end);
+                // write n segments in a row, i.e. the backend may
+                // gather them into one system call instead of copying
+                // them into its buffer
+                virtual std::pair<Char*, Char*> gather_write(size_t forget_cnt,
+                        const std::pair<const Char*, const Char*> *segs,
+                        size_t n);
 
                 // completely flush the buffer
                 virtual void flush() = 0;
 
                 virtual void set_sync(bool b) = 0;
                 virtual void sync() = 0;
+                // only useful for file writer
+                virtual void set_sync_group(Sync_Group *g);
 
                 // only useful for scratchpad writer
                 virtual void clear();
 
                 virtual size_t inc() const;
+
+                // returns nullptr if the backend doesn't do any I/O
+                virtual const IO_Stats *stats() const;
         };
 
     // e.g. for writing into a memory mapped file
@@ -322,6 +487,7 @@ namespace xfsx {
         class Mapped_Writer : public Memory_Writer<Char> {
             public:
                 Mapped_Writer(ixxx::util::MMap &&m);
+                // creates the file with size preallocated bytes
                 Mapped_Writer(const std::string &filename, size_t size);
 
                 void sync() override;
@@ -338,6 +504,13 @@ namespace xfsx {
                 std::pair<Char*, Char*> prepare_write(size_t forget_cnt,
                         size_t want_cnt) override;
                 std::pair<Char*, Char*> write_some(size_t forget_cnt) override;
+                // only grow the pad if the remaining room is too small,
+                // e.g. for a gather write of many small segments
+                std::pair<Char*, Char*> write(size_t forget_cnt,
+                        const Char *begin, const Char *end) override;
+                std::pair<Char*, Char*> gather_write(size_t forget_cnt,
+                        const std::pair<const Char*, const Char*> *segs,
+                        size_t n) override;
                 void flush() override;
                 void sync() override;
                 void set_sync(bool b) override;
@@ -349,6 +522,8 @@ namespace xfsx {
             private:
                 Scratchpad<Char> pad_;
                 size_t inc_ {128 * 1024};
+
+                void reserve(size_t k);
         };
 
     template <typename Char>
@@ -366,10 +541,15 @@ namespace xfsx {
                         size_t want_cnt) override;
                 std::pair<Char*, Char*> write_some(size_t forget_cnt) override;
                 std::pair<Char*, Char*> write(size_t forget_cnt, const Char *begin, const Char *end) override;
+                std::pair<Char*, Char*> gather_write(size_t forget_cnt,
+                        const std::pair<const Char*, const Char*> *segs,
+                        size_t n) override;
                 void flush() override;
                 void sync() override;
                 void set_sync(bool b) override;
+                void set_sync_group(Sync_Group *g) override;
                 size_t inc() const override;
+                const IO_Stats *stats() const override;
 
                 Sink_File<Char> &sink();
             private:
@@ -392,6 +572,10 @@ namespace xfsx {
                 ~Simple_Writer();
 
                 void write(const Char *begin, const Char *end);
+                // write n segments in a row - without copying them
+                // first, if the backend supports it
+                void gather_write(const std::pair<const Char*, const Char*> *segs,
+                        size_t n);
                 // write string literals, i.e. assuming 0 termination
                 template <size_t N>
                     void write(const Char (&s)[N])
@@ -412,6 +596,7 @@ namespace xfsx {
                 void flush();
                 void sync();
                 void set_sync(bool b);
+                void set_sync_group(Sync_Group *g);
 
                 void clear();
 
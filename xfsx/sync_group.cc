@@ -0,0 +1,108 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "sync_group.hh"
+
+#include <ixxx/posix.hh>
+
+#include <system_error>
+#include <utility>
+
+#include <errno.h>
+#include <unistd.h>
+
+namespace xfsx {
+
+    namespace scratchpad {
+
+    static void data_sync(int fd)
+    {
+#if defined(__linux__)
+        if (::fdatasync(fd) == -1)
+            throw std::system_error(errno, std::generic_category(),
+                    "fdatasync");
+#else
+        ixxx::posix::fsync(fd);
+#endif
+    }
+
+    Sync_Group::Sync_Group()
+        :
+            thread_(&Sync_Group::run, this)
+    {
+    }
+    Sync_Group::~Sync_Group()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_cv_.notify_one();
+        // the worker syncs what is still pending before it returns
+        thread_.join();
+    }
+
+    void Sync_Group::add(ixxx::util::FD &&fd)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(std::move(fd));
+            ++added_;
+        }
+        work_cv_.notify_one();
+    }
+
+    void Sync_Group::wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]{ return synced_ == added_; });
+        if (error_) {
+            auto e = error_;
+            error_ = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    size_t Sync_Group::batches() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return batches_;
+    }
+
+    void Sync_Group::run()
+    {
+        std::vector<ixxx::util::FD> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [this]{ return stop_ || !pending_.empty(); });
+                if (pending_.empty())
+                    return;
+                batch.swap(pending_);
+            }
+            std::exception_ptr error;
+            for (auto &fd : batch) {
+                try {
+                    data_sync(fd);
+                } catch (...) {
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+            size_t n = batch.size();
+            // closes the descriptors
+            batch.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                synced_ += n;
+                ++batches_;
+                if (error && !error_)
+                    error_ = error;
+            }
+            done_cv_.notify_all();
+        }
+    }
+
+    } // namespace scratchpad
+
+} // namespace xfsx
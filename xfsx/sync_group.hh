@@ -0,0 +1,62 @@
+// 2018, Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef XFSX_SYNC_GROUP_HH
+#define XFSX_SYNC_GROUP_HH
+
+#include <ixxx/util.hh>
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+
+namespace xfsx {
+
+    namespace scratchpad {
+
+    // Group commit for many outputs, e.g. when converting thousands
+    // of small files.
+    //
+    // Instead of blocking on a fsync() per output, the final fdatasync()
+    // calls are done by a background thread. Files added while a batch
+    // is synced are collected into the next batch. Completion should only
+    // be reported after wait() returned, i.e. after the whole group
+    // is durable.
+    class Sync_Group {
+        public:
+            Sync_Group();
+            ~Sync_Group();
+            Sync_Group(const Sync_Group &) =delete;
+            Sync_Group &operator=(const Sync_Group &) =delete;
+
+            // takes ownership, the descriptor is closed when it's synced
+            void add(ixxx::util::FD &&fd);
+            // blocks until all added files are durable,
+            // rethrows the first sync error
+            void wait();
+
+            size_t batches() const;
+        private:
+            void run();
+
+            mutable std::mutex mutex_;
+            std::condition_variable work_cv_;
+            std::condition_variable done_cv_;
+            std::vector<ixxx::util::FD> pending_;
+            size_t added_   {0};
+            size_t synced_  {0};
+            size_t batches_ {0};
+            bool stop_      {false};
+            std::exception_ptr error_;
+            // started last, i.e. after everything else is initialized
+            std::thread thread_;
+    };
+
+    } // namespace scratchpad
+
+} // namespace xfsx
+
+#endif // XFSX_SYNC_GROUP_HH
@@ -27,6 +27,9 @@
 #include <grammar/asn1/mini_parser.hh>
 #include <grammar/tap/tap.hh>
 
+#include <stdexcept>
+#include <string.h>
+
 
 using namespace std;
 
@@ -193,6 +196,32 @@ namespace xfsx {
         return empty_path_;
     }
 
+    static bool translates_to(const xfsx::Name_Translator &translator,
+        const char *name, xfsx::Tag_Int tag)
+    {
+      try {
+        auto t = translator.translate(make_pair(name, name + strlen(name)));
+        return std::get<1>(t) == xfsx::Klasse::APPLICATION
+          && std::get<2>(t) == tag;
+      } catch (const std::out_of_range &) {
+        return false;
+      }
+    }
+    const std::vector<xfsx::Tag_Int> &kth_cdr_path(
+        const xfsx::Name_Translator &translator)
+    {
+      if (translates_to(translator, "TransferBatch",
+            grammar::tap::TRANSFER_BATCH))
+        return kth_cdr_path();
+      else if (translates_to(translator, "ReturnBatch",
+            grammar::rap::RETURN_BATCH))
+        return kth_rcdr_path();
+      else if (translates_to(translator, "Nrtrde", grammar::nrt::NRTRDE))
+        return kth_ncdr_path();
+      else
+        return empty_path_;
+    }
+
     static const xfsx::Tag_Translator mini_tap_translator_ {
         xfsx::Klasse::APPLICATION,
         {
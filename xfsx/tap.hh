@@ -32,6 +32,7 @@ namespace xfsx {
   class Tag_Dereferencer;
   class Tag_Typifier;
   class Tag_Translator;
+  class Name_Translator;
   using Tag_Int = uint32_t;
 
   class BER_Writer_Arguments;
@@ -55,6 +56,9 @@ namespace xfsx {
     const std::vector<xfsx::Tag_Int> &kth_cdr_path();
     const std::vector<xfsx::Tag_Int> &kth_cdr_path(
         const xfsx::Tag_Translator &translator);
+    // e.g. when encoding XML, where the path is identified by the names
+    const std::vector<xfsx::Tag_Int> &kth_cdr_path(
+        const xfsx::Name_Translator &translator);
 
     const xfsx::Tag_Translator &mini_tap_translator();
   }
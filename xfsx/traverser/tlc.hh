@@ -24,6 +24,9 @@
 #define XFSX_TRAVERSER_TLC_HH
 
 #include <xfsx/xfsx.hh>
+#include <xfsx/scratchpad.hh>
+
+#include <stdexcept>
 
 namespace xfsx {
   namespace traverser {
@@ -89,6 +92,87 @@ namespace xfsx {
       }
     };
 
+    // Like Vertical_TLC_Proxy, but reads the tags through a Simple_Reader,
+    // e.g. a windowed mapping of a large file. Skipped children
+    // don't have to be available at once. The content of the current
+    // tag is only valid until the next advance() or skip_children().
+    class Vertical_TLC_Reader_Proxy {
+      private:
+        scratchpad::Simple_Reader<u8> &r_;
+        // i.e. the size of the current tag, forgotten on the next read
+        size_t k_ {0};
+        bool eot_ {false};
+
+        void read(Vertical_TLC &t)
+        {
+          r_.forget(k_);
+          k_ = 0;
+          if (!r_.next(20)) {
+            eot_ = true;
+            return;
+          }
+          Unit u;
+          u.load(r_.window().first, r_.window().second);
+          size_t k = u.tl_size;
+          if (u.shape == Shape::PRIMITIVE
+              && __builtin_add_overflow(k, u.length, &k))
+            throw std::range_error("length overflows 64 bit");
+          r_.next(k);
+          r_.check_available(k);
+          t.read(r_.window().first, r_.window().first + k);
+          k_ = k;
+        }
+      public:
+      Vertical_TLC_Reader_Proxy(scratchpad::Simple_Reader<u8> &r,
+          Vertical_TLC &t)
+        : r_(r) { advance(t); }
+
+      Tag_Int tag(const Vertical_TLC &t) const { return t.tag; }
+      Klasse klasse(const Vertical_TLC &t) const { return t.klasse; }
+      uint32_t height(const Vertical_TLC &t) const { return t.height; }
+      void string(const Vertical_TLC &t, std::string &s) const
+      {
+        std::pair<const char *, const char*> p;
+        t.copy_content(p);
+        s.clear();
+        s.insert(s.end(), p.first, p.second);
+      }
+      uint64_t uint64(const Vertical_TLC &t) const
+      {
+        uint64_t r;
+        t.copy_content(r);
+        return r;
+      }
+      uint32_t uint32(const Vertical_TLC &t) const
+      {
+        uint32_t r;
+        t.copy_content(r);
+        return r;
+      }
+      void advance(Vertical_TLC &t)
+      {
+        if (!eot_)
+          read(t);
+      }
+      void skip_children(Vertical_TLC &t)
+      {
+        auto height = t.height;
+        while (!eot_) {
+          size_t n = t.skip();
+          r_.forget(k_);
+          k_ = 0;
+          r_.skip(n);
+          read(t);
+          if (t.height <= height)
+            break;
+        }
+      }
+      bool eot(const Vertical_TLC &) const
+      {
+        return eot_;
+      }
+    };
+
   }
 }
 
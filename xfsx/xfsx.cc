@@ -747,12 +747,16 @@ namespace xfsx {
   {
     assert(begin < end);
     (void)end;
+    return begin + skip();
+  }
+  size_t Vertical_TLC::skip()
+  {
     if (shape == Shape::CONSTRUCTED && length) {
       stack_[depth_].length = length;
       conditional_pop();
-      return begin + length;
+      return length;
     } else {
-      return begin;
+      return 0;
     }
   }
 
@@ -1057,6 +1061,12 @@ namespace xfsx {
   }
   template<> u8 *encode(const XML_Content &t, u8 *begin, size_t size)
   {
+    // i.e. size is the encoded size, thus, it only equals the
+    // content size if there is no character reference to decode
+    if (size == t.size()) {
+      memcpy(begin, t.begin(), size);
+      return begin + size;
+    }
     auto r = hex::encode<hex::Style::XML>(t.begin(), t.end(), begin);
     if (r !=  begin + size)
       throw overflow_error("XML_Content too long");
@@ -1205,6 +1215,7 @@ namespace xfsx {
 
   Tag_Translator::Tag_Translator()
     :
+      dense_(4u),
       k_trans_(4u)
   {
   }
@@ -1218,28 +1229,49 @@ namespace xfsx {
   void Tag_Translator::push(Klasse klasse,
       std::unordered_map<uint32_t, std::string> &&m)
   {
+    auto i = klasse_to_index(klasse);
+    auto &d = dense_.at(i);
+    auto &k = k_trans_.at(i);
+    count_ -= k.size() + std::count_if(d.begin(), d.end(),
+        [](const std::string &x) { return !x.empty(); });
+    d.clear();
+    k.clear();
     count_ += m.size();
-    k_trans_.at(klasse_to_index(klasse)) = std::move(m);
+    for (auto &x : m) {
+      if (x.first < dense_tag_limit) {
+        if (d.size() <= x.first)
+          d.resize(x.first + 1);
+        d[x.first] = std::move(x.second);
+      } else {
+        k.emplace(x.first, std::move(x.second));
+      }
+    }
   }
   const std::string &Tag_Translator::translate(
       Klasse klasse, Tag_Int tag) const
   {
-    try {
-      return k_trans_.at(klasse_to_index(klasse)).at(tag);
-    } catch (const std::out_of_range &e) {
+    auto r = find(klasse, tag);
+    if (!r)
       throw range_error("Incomplete ASN.1 file - can't translate tag: "
           + std::to_string(tag));
-    }
+    return *r;
   }
   const std::string *Tag_Translator::find(
       Klasse klasse, Tag_Int tag) const
   {
-      auto &m = k_trans_.at(klasse_to_index(klasse));
-      auto i = m.find(tag);
-      if (i == m.end())
+      auto i = klasse_to_index(klasse);
+      if (tag < dense_tag_limit) {
+          auto &d = dense_[i];
+          if (tag < d.size() && !d[tag].empty())
+              return &d[tag];
+          return nullptr;
+      }
+      auto &m = k_trans_[i];
+      auto j = m.find(tag);
+      if (j == m.end())
           return nullptr;
       else
-          return &i->second;
+          return &j->second;
   }
   bool Tag_Translator::empty() const
   {
@@ -1248,6 +1280,7 @@ namespace xfsx {
 
   Tag_Dereferencer::Tag_Dereferencer()
     :
+      dense_(4u),
       v_(4u)
   {
   }
@@ -1255,13 +1288,32 @@ namespace xfsx {
       std::unordered_set<uint32_t> &&tags,
           Klasse dest_klasse, Tag_Int dest_tag)
   {
+    // i.e. the first pushed set that contains a tag wins
+    auto &d = dense_.at(klasse_to_index(klasse));
+    for (auto tag : tags) {
+      if (tag >= dense_tag_limit)
+        continue;
+      if (d.size() <= tag)
+        d.resize(tag + 1);
+      if (!d[tag].set) {
+        d[tag].tag = dest_tag;
+        d[tag].klasse = dest_klasse;
+        d[tag].set = true;
+      }
+    }
     v_.at(klasse_to_index(klasse)).emplace_back(
         std::move(tags), make_pair(dest_klasse, dest_tag) );
   }
   std::pair<Klasse, Tag_Int> Tag_Dereferencer::dereference(
       Klasse klasse, Tag_Int tag) const
   {
-    auto &d = v_.at(klasse_to_index(klasse));
+    if (tag < dense_tag_limit) {
+      auto &d = dense_[klasse_to_index(klasse)];
+      if (tag < d.size() && d[tag].set)
+        return make_pair(d[tag].klasse, d[tag].tag);
+      return make_pair(klasse, tag);
+    }
+    auto &d = v_[klasse_to_index(klasse)];
     for (auto &e : d) {
       if (e.first.count(tag))
         return e.second;
@@ -1270,53 +1322,157 @@ namespace xfsx {
   }
   Tag_Typifier::Tag_Typifier()
     :
+      dense_(4u),
       v_(4u)
   {
   }
   void Tag_Typifier::push(Klasse klasse, Tag_Int tag, Type type)
   {
-    v_.at(klasse_to_index(klasse))[tag] = type;
+    auto i = klasse_to_index(klasse);
+    if (tag < dense_tag_limit) {
+      auto &d = dense_.at(i);
+      if (d.size() <= tag)
+        d.resize(tag + 1, uint8_t(Type::OCTET_STRING));
+      d[tag] = uint8_t(type);
+    } else {
+      v_.at(i)[tag] = type;
+    }
   }
   Type Tag_Typifier::typify(Klasse klasse, Tag_Int tag) const
   {
-    auto &m = v_.at(klasse_to_index(klasse));
-    auto i = m.find(tag);
-    if (i == m.end())
+    auto i = klasse_to_index(klasse);
+    if (tag < dense_tag_limit) {
+      auto &d = dense_[i];
+      return tag < d.size() ? Type(d[tag]) : Type::OCTET_STRING;
+    }
+    auto &m = v_[i];
+    auto j = m.find(tag);
+    if (j == m.end())
       return Type::OCTET_STRING;
     else
-      return i->second;
+      return j->second;
   }
   Type Tag_Typifier::typify(const std::pair<Klasse, Tag_Int> &p) const
   {
     return typify(p.first, p.second);
   }
 
+  namespace {
+
+    // FNV-1a, i.e. each name is hashed only once per lookup
+    uint64_t name_hash(const char *begin, const char *end)
+    {
+      uint64_t h = 0xcbf29ce484222325llu;
+      for (const char *i = begin; i != end; ++i) {
+        h ^= uint8_t(*i);
+        h *= 0x100000001b3llu;
+      }
+      return h;
+    }
+
+    // i.e. the splitmix64 finalizer, derives the slot hash
+    // from the name hash and the displacement of its bucket
+    size_t name_slot(uint64_t h, uint32_t d, size_t n)
+    {
+      uint64_t x = h + (uint64_t(d) + 1) * 0x9e3779b97f4a7c15llu;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9llu;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebllu;
+      x ^= x >> 31;
+      return x % n;
+    }
+
+  }
+
   Name_Translator::Name_Translator() =default;
 
   Name_Translator::Name_Translator(
     std::unordered_map<std::string, std::tuple<bool, uint32_t, uint32_t> > &&m)
-    :
-      name_map_prime_(std::move(m))
-  {
-    name_map_.max_load_factor(0.75);
-    for (auto &e : name_map_prime_) {
-      name_map_.emplace(make_pair(e.first.data(),
-            e.first.data() + e.first.size()),
-          make_tuple(
-            std::get<0>(e.second) ? Shape::PRIMITIVE : Shape::CONSTRUCTED,
-            index_to_klasse(std::get<1>(e.second)),
-            std::get<2>(e.second)));
+  {
+    size_t n = m.size();
+    if (!n)
+      return;
+    std::vector<Entry> es;
+    std::vector<uint64_t> hs;
+    es.reserve(n);
+    hs.reserve(n);
+    for (auto &e : m) {
+      Entry x;
+      x.off = names_.size();
+      x.size = e.first.size();
+      x.shape = std::get<0>(e.second) ? Shape::PRIMITIVE : Shape::CONSTRUCTED;
+      x.klasse = index_to_klasse(std::get<1>(e.second));
+      x.tag = std::get<2>(e.second);
+      names_ += e.first;
+      es.push_back(x);
+      hs.push_back(name_hash(e.first.data(), e.first.data() + e.first.size()));
+    }
+
+    {
+      // i.e. otherwise the displacement search wouldn't terminate
+      auto v = hs;
+      std::sort(v.begin(), v.end());
+      if (std::adjacent_find(v.begin(), v.end()) != v.end())
+        throw std::runtime_error("Can't construct name hash table");
+    }
+    // i.e. about 4 names per bucket, the largest buckets are placed first
+    size_t r = (n + 3) / 4;
+    std::vector<std::vector<uint32_t> > buckets(r);
+    for (size_t i = 0; i < n; ++i)
+      buckets[hs[i] % r].push_back(i);
+    std::vector<uint32_t> order(r);
+    for (size_t i = 0; i < r; ++i)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a,
+          uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    displacements_.resize(r);
+    entries_.resize(n);
+    std::vector<bool> taken(n);
+    std::vector<size_t> slots;
+    for (auto b : order) {
+      auto &bucket = buckets[b];
+      if (bucket.empty())
+        break;
+      for (uint32_t d = 0; ; ++d) {
+        slots.clear();
+        bool ok = true;
+        for (auto i : bucket) {
+          size_t k = name_slot(hs[i], d, n);
+          if (taken[k] || std::find(slots.begin(), slots.end(), k)
+              != slots.end()) {
+            ok = false;
+            break;
+          }
+          slots.push_back(k);
+        }
+        if (ok) {
+          displacements_[b] = d;
+          for (size_t j = 0; j < bucket.size(); ++j) {
+            taken[slots[j]] = true;
+            entries_[slots[j]] = es[bucket[j]];
+          }
+          break;
+        }
+      }
     }
   }
   std::tuple<xfsx::Shape, xfsx::Klasse, xfsx::Tag_Int>
     Name_Translator::translate(
       const std::pair<const char*, const char*> &s) const
   {
-    return name_map_.at(s);
+    if (!entries_.empty()) {
+      uint64_t h = name_hash(s.first, s.second);
+      uint32_t d = displacements_[h % displacements_.size()];
+      auto &e = entries_[name_slot(h, d, entries_.size())];
+      size_t n = s.second - s.first;
+      if (e.size == n && !memcmp(names_.data() + e.off, s.first, n))
+        return make_tuple(e.shape, e.klasse, e.tag);
+    }
+    throw std::out_of_range("Unknown element name");
   }
   bool Name_Translator::empty() const
   {
-    return name_map_.empty();
+    return entries_.empty();
   }
 
 
@@ -32,6 +32,8 @@
 #include <memory>
 #include <stdexcept>
 #include <type_traits>
+#include <string>
+#include <tuple>
 #include "types.hh"
 #include "value.hh"
 #include "s_pair.hh"
@@ -115,8 +117,15 @@ namespace xfsx {
     INT_64,
     BCD
   };
+  // The translators are compiled into flat tables when they are pushed,
+  // i.e. tags below dense_tag_limit are looked up by index and only
+  // larger tags (rare in practice) go through a hash table.
+  const Tag_Int dense_tag_limit = 4096;
+
   class Tag_Translator {
     private:
+      // i.e. an empty name marks a gap
+      std::vector<std::vector<std::string> > dense_;
       std::vector<std::unordered_map<uint32_t, std::string> > k_trans_;
       size_t count_{0};
     public:
@@ -127,9 +136,27 @@ namespace xfsx {
       const std::string &translate(Klasse klasse, Tag_Int tag) const;
       const std::string *find(Klasse klasse, Tag_Int tag) const;
       bool empty() const;
+      // calls f(klasse, tag, name) for each translation
+      template <typename F> void for_each(F f) const
+      {
+        for (size_t i = 0; i < dense_.size(); ++i) {
+          auto &d = dense_[i];
+          for (size_t j = 0; j < d.size(); ++j)
+            if (!d[j].empty())
+              f(index_to_klasse(i), Tag_Int(j), d[j]);
+          for (auto &x : k_trans_[i])
+            f(index_to_klasse(i), x.first, x.second);
+        }
+      }
   };
   class Tag_Dereferencer {
     private:
+      struct Ref {
+        Tag_Int tag {0};
+        Klasse klasse {Klasse::UNIVERSAL};
+        bool set {false};
+      };
+      std::vector<std::vector<Ref> > dense_;
       std::vector<
         std::deque<
           std::pair<
@@ -143,6 +170,8 @@ namespace xfsx {
   };
   class Tag_Typifier {
     private:
+      // i.e. Type values, where OCTET_STRING marks a gap
+      std::vector<std::vector<uint8_t> > dense_;
       std::vector<std::unordered_map<Tag_Int, Type> > v_;
     public:
       Tag_Typifier();
@@ -153,20 +182,26 @@ namespace xfsx {
 
   class Name_Translator {
     private:
-      std::unordered_map<std::string, std::tuple<bool, uint32_t, uint32_t> >
-        name_map_prime_;
-
-      std::unordered_map<
-        std::pair<const char*, const char*>,
-        std::tuple<xfsx::Shape, xfsx::Klasse, xfsx::Tag_Int>,
-        s_pair::Hash,
-        s_pair::Equal >
-          name_map_;
+      struct Entry {
+        uint32_t off {0};
+        uint32_t size {0};
+        xfsx::Tag_Int tag {0};
+        xfsx::Shape shape {xfsx::Shape::PRIMITIVE};
+        xfsx::Klasse klasse {xfsx::Klasse::UNIVERSAL};
+      };
+      // A minimal perfect hash (hash and displace) over all names, i.e.
+      // a name is hashed once, its bucket yields the displacement
+      // that selects its slot in entries_. The names are concatenated
+      // in names_ such that a lookup only has to compare one candidate.
+      std::string names_;
+      std::vector<Entry> entries_;
+      std::vector<uint32_t> displacements_;
     public:
       Name_Translator();
       Name_Translator(
         std::unordered_map<std::string,
         std::tuple<bool, uint32_t, uint32_t> > &&m);
+      // throws std::out_of_range for unknown names
       std::tuple<xfsx::Shape, xfsx::Klasse, xfsx::Tag_Int> translate(
           const std::pair<const char*, const char*> &s) const;
       bool empty() const;
@@ -394,6 +429,9 @@ namespace xfsx {
       const u8 *read(const u8 *begin, const u8 *end);
       const u8 *skip(const u8 *begin,
           const u8 *end);
+      // i.e. skip() without the input, returns the number of bytes
+      // to skip
+      size_t skip();
       const u8 *skip_children(const u8 *begin, const u8 *end);
 
       uint32_t depth_ {0};
@@ -25,6 +25,13 @@
 #include <cctype>
 #include <cassert>
 
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+    #include <immintrin.h>
+#endif
+
 #include "s_pair.hh"
 #include "scratchpad.hh"
 
@@ -36,50 +43,116 @@ namespace xfsx {
 
         static char empty_s[0];
 
+        // Stores the offsets of all '<' and '>' in [begin, end).
+        static uint32_t *find_marks(const char *begin, const char *end,
+                uint32_t *o)
+        {
+            const char *b = begin;
+#ifdef __AVX2__
+            {
+                const __m256i lt = _mm256_set1_epi8('<');
+                const __m256i gt = _mm256_set1_epi8('>');
+                for (; end - b >= 32; b += 32) {
+                    __m256i x = _mm256_loadu_si256(
+                            reinterpret_cast<const __m256i*>(b));
+                    uint32_t m = uint32_t(_mm256_movemask_epi8(
+                                _mm256_or_si256(_mm256_cmpeq_epi8(x, lt),
+                                    _mm256_cmpeq_epi8(x, gt))));
+                    uint32_t k = b - begin;
+                    for (; m; m &= m - 1)
+                        *o++ = k + __builtin_ctz(m);
+                }
+            }
+#endif // __AVX2__
+#ifdef __SSE2__
+            {
+                const __m128i lt = _mm_set1_epi8('<');
+                const __m128i gt = _mm_set1_epi8('>');
+                for (; end - b >= 16; b += 16) {
+                    __m128i x = _mm_loadu_si128(
+                            reinterpret_cast<const __m128i*>(b));
+                    unsigned m = unsigned(_mm_movemask_epi8(
+                                _mm_or_si128(_mm_cmpeq_epi8(x, lt),
+                                    _mm_cmpeq_epi8(x, gt))));
+                    uint32_t k = b - begin;
+                    for (; m; m &= m - 1)
+                        *o++ = k + __builtin_ctz(m);
+                }
+            }
+#endif // __SSE2__
+            for (; b != end; ++b)
+                if (*b == '<' || *b == '>')
+                    *o++ = b - begin;
+            return o;
+        }
+
         Reader::Reader(scratchpad::Simple_Reader<char> &src)
             :
                 src_(src),
-                p_(src_.window())
+                p_(src_.window()),
+                marks_(scan_inc_)
+        {
+        }
+        bool Reader::next_mark(size_t &off)
         {
+            while (mark_pos_ == mark_end_) {
+                size_t n = p_.second - p_.first;
+                if (scanned_ == n)
+                    return false;
+                size_t m = std::min(n - scanned_, scan_inc_);
+                chunk_ = scanned_;
+                mark_end_ = find_marks(p_.first + chunk_,
+                        p_.first + chunk_ + m, marks_.data()) - marks_.data();
+                mark_pos_ = 0;
+                scanned_ += m;
+            }
+            off = chunk_ + marks_[mark_pos_++];
+            return true;
+        }
+        // i.e. only called when all marks are consumed
+        size_t Reader::read_more()
+        {
+            size_t k = pinned_ ? std::min(low_, pin_) : low_;
+            src_.forget(k);
+            // i.e. always read more, even if a large rest is left
+            src_.next(size_t(p_.second - p_.first) + inc_);
+            k_.first -= k;
+            k_.second -= k;
+            scanned_ -= k;
+            low_ -= k;
+            if (pinned_)
+                pin_ -= k;
+            return k;
         }
         bool Reader::next()
         {
-            const char *x;
+            size_t x;
             for (;;) {
-                x = std::find(p_.first + k_.second, p_.second, '<');
-                if (x == p_.second) {
-                    if (src_.eof())
-                        return false;
-                    src_.forget(low_);
-                    src_.next(inc_);
-                    k_.first -= low_;
-                    k_.second -= low_;
-                    low_ = 0;
+                if (next_mark(x)) {
+                    if (p_.first[x] == '<')
+                        break;
                     continue;
                 }
-                break;
+                if (src_.eof())
+                    return false;
+                read_more();
             }
-            k_.first = x - p_.first + 1; // excluding the <
+            k_.first = x + 1; // excluding the <
             auto old_k_second = k_.second;
             k_.second = k_.first + 1;
-            const char *y;
+            size_t y;
             for (;;) {
-                y = std::find(p_.first + k_.second, p_.second, '>');
-                if (y == p_.second) {
-                    if (src_.eof())
-                        throw range_error("file ends within a tag");
-                    src_.forget(low_);
-                    src_.next(inc_);
-                    k_.first -= low_;
-                    k_.second -= low_;
-                    old_k_second -= low_;
-                    low_ = 0;
+                if (next_mark(y)) {
+                    if (p_.first[y] == '>' && y >= k_.second)
+                        break;
                     continue;
                 }
-                break;
+                if (src_.eof())
+                    throw range_error("file ends within a tag");
+                old_k_second -= read_more();
             }
             low_ = old_k_second;
-            k_.second = y - p_.first + 1; // including the >
+            k_.second = y + 1; // including the >
             assert(k_.first < k_.second);
             return true;
         }
@@ -88,6 +161,20 @@ namespace xfsx {
             assert(k_.first < k_.second);
             return make_pair(p_.first + k_.first, p_.first + k_.second - 1);
         }
+        void Reader::pin()
+        {
+            pin_ = k_.second;
+            pinned_ = true;
+        }
+        void Reader::unpin()
+        {
+            pinned_ = false;
+        }
+        std::pair<const char*, const char*> Reader::pinned() const
+        {
+            assert(pinned_ && pin_ < k_.first);
+            return make_pair(p_.first + pin_, p_.first + k_.first - 1);
+        }
         std::pair<const char*, const char*> Reader::value() const
         {
             //assert(k_.first);
@@ -24,6 +24,8 @@
 #include <utility>
 #include <string>
 #include <memory>
+#include <vector>
+#include <stdint.h>
 
 namespace xfsx {
     namespace scratchpad {
@@ -39,6 +41,10 @@ namespace xfsx {
     // http://www.w3.org/TR/REC-xml/#NT-AttValue
     //
     // Comments must not be placed between primitve open/close tags
+    //
+    // The window is scanned in chunks for all '<' and '>' (with
+    // SSE2/AVX2, when available), i.e. next() then just consumes
+    // those positions.
     class Reader {
         public:
             Reader(scratchpad::Simple_Reader<char> &src);
@@ -46,12 +52,37 @@ namespace xfsx {
             bool next();
             std::pair<const char*, const char*> tag() const;
             std::pair<const char*, const char*> value() const;
+
+            // Keeps the input after the current tag in the window,
+            // until unpin(), i.e. the window grows as necessary.
+            void pin();
+            void unpin();
+            // the input between the tag that was current when pin()
+            // was called and the current tag
+            std::pair<const char*, const char*> pinned() const;
         private:
             scratchpad::Simple_Reader<char> &src_;
             const std::pair<const char *, const char *> &p_;
             size_t inc_ {128 * 1024};
             std::pair<size_t, size_t> k_ {0, 0};
             size_t low_{0};
+
+            size_t scan_inc_ {16 * 1024};
+            // offsets of the '<' and '>' in [chunk_, scanned_),
+            // relative to chunk_
+            std::vector<uint32_t> marks_;
+            size_t mark_pos_ {0};
+            size_t mark_end_ {0};
+            size_t chunk_ {0};
+            size_t scanned_ {0};
+
+            bool pinned_ {false};
+            size_t pin_ {0};
+
+            // i.e. false if the window is exhausted
+            bool next_mark(size_t &off);
+            // returns how many bytes were forgotten
+            size_t read_more();
     };
 
     class Attribute_Traverser {
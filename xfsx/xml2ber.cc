@@ -24,6 +24,8 @@
 #include "xfsx.hh"
 
 #include <algorithm>
+#include <future>
+#include <vector>
 
 
 #include <assert.h>
@@ -36,6 +38,7 @@
 #include <xfsx/ber_writer_arguments.hh>
 #include <xfsx/tlc_writer.hh>
 #include <xfsx/integer.hh>
+#include <xfsx/gather_writer.hh>
 
 using namespace xfsx;
 
@@ -51,20 +54,24 @@ namespace xfsx {
 
 class Xml2Ber {
     public:
+        // split: i.e. args.split_path/threads are honored
         Xml2Ber(scratchpad::Simple_Reader<char> &in,
                 scratchpad::Simple_Writer<u8> &out,
-                const BER_Writer_Arguments &args
+                const BER_Writer_Arguments &args,
+                bool split = true
                 );
 
         void process();
     private:
         void process_tag();
+        bool splits_here() const;
+        void process_split();
         // if constructed and indefinite: write TL part
         // otherwise: write nothing
         void write_start();
         // if primitive: write to the top buffer
-        // if constructed definite: write TL part and copy top+1 buffer
-        // if constructed indefinite: copy top+1 buffer
+        // if constructed definite: write TL part and pop the gather level
+        // if constructed indefinite: write EOC
         void write_end(bool is_empty);
 
         xml::Reader r_;
@@ -77,27 +84,26 @@ class Xml2Ber {
         std::deque<TLV> tlv_stack_;
         size_t tlv_stack_top_{0};
 
-        // writers are reused to avoid unnecessary object reconstructions
-        // (thus no std::stack nor down-resize calls)
-        // first writer directly writes to a file
-        // for each definitive constructed a scratchpad writer is pushed
-        std::deque<scratchpad::Simple_Writer<u8>*> writer_stack_;
-        std::deque<scratchpad::Simple_Writer<u8>> writers_;
-        size_t writer_stack_top_{0};
+        // for each definite constructed tag a level is pushed,
+        // the content is gathered when the outermost one is popped
+        Gather_Writer w_;
 
         std::array<u8, 2> eoc_{{0, 0}};
+
+        bool split_ {false};
 };
 
 Xml2Ber::Xml2Ber(scratchpad::Simple_Reader<char> &in,
         scratchpad::Simple_Writer<u8> &out,
-        const BER_Writer_Arguments &args
+        const BER_Writer_Arguments &args,
+        bool split
         )
     :
         r_(in),
-        args_(args)
+        args_(args),
+        w_(out),
+        split_(split && args_.threads > 1 && !args_.split_path.empty())
 {
-    writer_stack_.push_back(&out);
-    ++writer_stack_top_;
 }
 void Xml2Ber::process()
 {
@@ -108,26 +114,14 @@ void Xml2Ber::process()
     while (r_.next()) {
         process_tag();
     }
-    if (writer_stack_top_ != 1)
+    if (w_.depth())
         throw runtime_error("unexpected writer stack - unbalanced tags?");
     if (tlv_stack_top_)
         throw runtime_error("unexpected tlv stack - unbalanced tags?");
 
-#ifndef NDEBUG
-    //assert(writer_stack_.size() > 1);
-    if (writer_stack_.size() > 1) {
-        writer_stack_[1]->flush();
-        auto be = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
-                    writer_stack_[1]->backend());
-        auto b = be->pad().prelude();
-        auto e = be->pad().begin();
-        assert(e-b == 0);
-    }
-#endif // NDEBUG
-
-    // writer_stack_[0] is already written out in last write_end() call
+    // everything is already written out in last write_end() call
     // we just need to flush
-    writer_stack_[0]->flush();
+    w_.flush();
 }
 // return: full-initialized
 bool read_tag(const std::pair<const char*, const char*> &name,
@@ -228,32 +222,104 @@ void Xml2Ber::process_tag()
         write_start();
         if (xml::is_start_end_tag(t))
             write_end(true);
+        else if (split_ && splits_here())
+            process_split();
     } else if (xml::is_end_tag(t)) {
         write_end(false);
     }
 }
+bool Xml2Ber::splits_here() const
+{
+    auto &p = args_.split_path;
+    if (tlv_stack_top_ != p.size())
+        return false;
+    auto &tlv = tlv_stack_[tlv_stack_top_-1];
+    if (tlv.shape != Shape::CONSTRUCTED || tlv.is_indefinite)
+        return false;
+    for (size_t i = 0; i < p.size(); ++i) {
+        if (tlv_stack_[i].klasse != Klasse::APPLICATION
+                || tlv_stack_[i].tag != p[i])
+            return false;
+    }
+    return true;
+}
+// Encode the children of the current element in args_.threads chunks
+// of about the same size, each with its own Xml2Ber. The chunks are
+// then appended to the level of the current element, i.e. its
+// length is computed as usual when its end tag is processed.
+void Xml2Ber::process_split()
+{
+    // i.e. locate the children, keeping them in the window
+    r_.pin();
+    vector<size_t> children;
+    size_t depth = 0;
+    for (;;) {
+        if (!r_.next())
+            throw runtime_error("unexpected end of input - unbalanced tags?");
+        auto t = r_.tag();
+        if (xml::is_comment(t) || xml::is_decl(t))
+            continue;
+        if (xml::is_end_tag(t)) {
+            if (!depth)
+                break;
+            --depth;
+        } else {
+            if (!depth)
+                children.push_back(t.first - 1 - r_.pinned().first);
+            if (!xml::is_start_end_tag(t))
+                ++depth;
+        }
+    }
+    auto c = r_.pinned();
+    size_t size = c.second - c.first;
+    size_t n = std::min(size_t(args_.threads), children.size());
+    vector<size_t> bounds;
+    bounds.reserve(n + 1);
+    bounds.push_back(0);
+    for (size_t k = 1; k < n; ++k) {
+        auto i = std::lower_bound(children.begin(), children.end(),
+                size * k / n);
+        if (i != children.end() && *i > bounds.back())
+            bounds.push_back(*i);
+    }
+    bounds.push_back(size);
+    n = bounds.size() - 1;
+
+    vector<scratchpad::Simple_Writer<u8>> ws;
+    ws.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        ws.push_back(scratchpad::mk_simple_writer<u8>());
+    auto work = [this, &ws, &bounds, &c](size_t i) {
+        auto r = scratchpad::mk_simple_reader(c.first + bounds[i],
+                c.first + bounds[i+1]);
+        Xml2Ber x2b(r, ws[i], args_, false);
+        x2b.process();
+    };
+    vector<future<void>> fs;
+    fs.reserve(n);
+    for (size_t i = 1; i < n; ++i)
+        fs.push_back(std::async(std::launch::async, work, i));
+    work(0);
+    for (size_t i = 0; i < n; ++i) {
+        if (i)
+            fs[i-1].get();
+        auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
+                ws[i].backend())->pad();
+        w_.top().write(pad.prelude(), pad.prelude() + ws[i].pos());
+        ws[i].clear();
+    }
+    r_.unpin();
+    // i.e. the end tag of the current element
+    process_tag();
+}
 void Xml2Ber::write_start()
 {
     TLV &tlv = tlv_stack_[tlv_stack_top_-1];
     if (tlv.shape == Shape::CONSTRUCTED) {
         if (tlv.is_indefinite) {
-            write_tag(*writer_stack_[writer_stack_top_-1], tlv);
+            write_tag(w_.top(), tlv);
         } else {
-
-            if (writer_stack_top_ >= writer_stack_.size()) {
-                writers_.emplace_back(
-                        std::unique_ptr<scratchpad::Writer<u8>>(
-                            new scratchpad::Scratchpad_Writer<u8>()
-                            )
-                        );
-                writer_stack_.push_back(&writers_.back());
-            } else {
-                auto b  = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
-                        writer_stack_[writer_stack_top_]->backend());
-                (void)b;
-                assert(b->pad().begin() - b->pad().prelude() == 0);
-            }
-            ++writer_stack_top_;
+            w_.push();
         }
     }
 }
@@ -294,13 +360,13 @@ void Xml2Ber::write_end(bool is_empty)
 
     if (tlv.shape == Shape::CONSTRUCTED) {
         if (tlv.is_indefinite) {
-            writer_stack_[writer_stack_top_-1]->write(eoc_.begin(), eoc_.end());
+            w_.top().write(eoc_.begin(), eoc_.end());
         } else {
 
-            --writer_stack_top_;
+            assert(w_.depth());
             assert(tlv_stack_top_);
 
-            size_t n = writer_stack_[writer_stack_top_]->pos();
+            size_t n = w_.length();
 
             auto old_tl_size = tlv.tl_size;
             tlv.init_length(n);
@@ -311,17 +377,8 @@ void Xml2Ber::write_end(bool is_empty)
 
             assert(tlv.tl_size);
 
-            write_tag(*writer_stack_[writer_stack_top_-1], tlv);
-
-            writer_stack_[writer_stack_top_]->flush();
-            auto &pad = dynamic_cast<scratchpad::Scratchpad_Writer<u8>*>(
-                    writer_stack_[writer_stack_top_]->backend())->pad();
-            auto b = pad.prelude();
-            auto e = pad.begin();
-            // the Simple_Writer with File_Writer backend now supports
-            // write-through with large buffers
-            writer_stack_[writer_stack_top_-1]->write(b, e);
-            writer_stack_[writer_stack_top_]->clear();
+            write_tag(w_.begin_pop(), tlv);
+            w_.end_pop();
         }
     } else { // Shape::PRIMITIVE
         if (is_empty)
@@ -330,7 +387,7 @@ void Xml2Ber::write_end(bool is_empty)
             auto v = r_.value();
             add_content(v, tlv, attributes_, args_);
         }
-        write_tag(*writer_stack_[writer_stack_top_-1], tlv);
+        write_tag(w_.top(), tlv);
     }
 
     assert(tlv_stack_top_);
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <xfsx/xfsx.hh>
+#include <xfsx/pretty_printer.hh>
 
 namespace xfsx {
 
@@ -48,8 +49,27 @@ namespace xfsx {
       std::vector<Tag_Int> search_path;
       bool     search_everywhere {false};
       std::vector<std::pair<size_t, size_t> > search_ranges;
+      // only write the subtrees identified by these paths and the
+      // start/end tags of their ancestors, where a path that is paired
+      // with true matches anywhere (cf. path::parse()) - i.e.
+      // everything else is skipped without formatting it
+      std::vector<std::pair<std::vector<Tag_Int>, bool> > select_paths;
       uint32_t skip_zero        {0};
       uint32_t block_size       {0};
+      // format the children of the (definite) constructed tag
+      // identified by split_path with that many threads,
+      // e.g. the CDRs of a TAP CallEventDetailList
+      unsigned threads          {0};
+      std::vector<Tag_Int> split_path;
+      // save the conversion state to that file whenever another
+      // checkpoint_interval input bytes are processed, cf.
+      // xml::Checkpoint
+      std::string checkpoint_filename;
+      size_t   checkpoint_interval {64 * 1024 * 1024};
+      // saved with each checkpoint and a checkpoint is only resumed
+      // with the same key, i.e. it should identify the input and
+      // the options that change the output
+      std::string checkpoint_key;
     };
 
     extern Writer_Arguments default_writer_arguments;
@@ -65,6 +85,8 @@ namespace xfsx {
       Name_Translator  name_translator;
 
       bool pretty_print {false};
+      // native printers, Lua is only called for the other tags
+      pp::Registry printers;
       std::string pp_filename;
     };
     extern Pretty_Writer_Arguments default_pretty_args;